@@ -86,6 +86,8 @@ REM -std:c++17
 
 if "%debug%"=="1" set compile_flags= %debug_flags% %common_flags%
 if "%release%"=="1" set compile_flags= %release_flags% %common_flags%
+if "%profile%"=="1" set compile_flags= %compile_flags% -DMINI_PROFILE=1 && echo [profiling enabled]
+if "%shaders%"=="1" set compile_flags= %compile_flags% -DMINI_SHADER_COMPILER=1 && echo [runtime shader compiler enabled]
 
 set glfw_link= ..\extra\glfw\build\glfw.lib
 set imgui_link= ..\extra\imgui\build\imgui.lib
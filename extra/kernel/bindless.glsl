@@ -0,0 +1,14 @@
+// mirrors Bindless_Type in mini/gpu/bindless.hpp, every kernel sees the whole heap in set 0.
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(set = 0, binding = 0) uniform texture2D global_sampled_images[];
+layout(set = 0, binding = 2) uniform sampler global_samplers[];
+layout(set = 0, binding = 3) buffer Global_Buffer { uint data[]; } global_buffers[];
+
+// storage images need a format qualifier, so each kernel declares its own view of binding 1.
+#define BINDLESS_STORAGE_IMAGES(format, name) layout(format, set = 0, binding = 1) uniform image2D name[]
+
+// the format kernels write, the render target's unless built as a variant with -DIMAGE_FORMAT=...
+#ifndef IMAGE_FORMAT
+#define IMAGE_FORMAT rgba16f
+#endif
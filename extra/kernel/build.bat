@@ -4,9 +4,11 @@ cd /D "%~dp0"
 
 set COMPILER= %VULKAN_SDK%\Bin\glslangValidator.exe
 
-:: In the future we should look into each file.
+:: every kernel, plus a variant per storage format for the kernel benchmark (name.format.comp.spv).
 if not exist build mkdir build
 pushd build
-%COMPILER% -V ..\gradient.comp -o gradient.comp.spv
-%COMPILER% -V ..\sky.comp -o sky.comp.spv
+for %%k in (..\*.comp) do (
+    %COMPILER% -V %%k -o %%~nk.comp.spv
+    for %%f in (rgba8 rgba32f) do %COMPILER% -V -DIMAGE_FORMAT=%%f %%k -o %%~nk.%%f.comp.spv
+)
 popd
@@ -0,0 +1,687 @@
+#include "kernel_bench.hpp"
+#include "gpu/common.hpp"
+#include "gpu/pipeline_registry.hpp"
+#include "gpu/sync.hpp"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct Kernel_Bench_Format {
+  const char* name;   // the glsl format qualifier.
+  const char* suffix; // of the kernel variant, the default build writes rgba16f.
+  VkFormat format;
+  u32 texel_size;
+};
+
+static constexpr Kernel_Bench_Format KERNEL_BENCH_FORMATS[] = {
+  { "rgba8", ".rgba8", VK_FORMAT_R8G8B8A8_UNORM, 4 },
+  { "rgba16f", "", VK_FORMAT_R16G16B16A16_SFLOAT, 8 },
+  { "rgba32f", ".rgba32f", VK_FORMAT_R32G32B32A32_SFLOAT, 16 },
+};
+
+struct Kernel_Bench_Options {
+  // the registry holds every kernel, format and workgroup combination, these keep them below its limit.
+  static constexpr u32 MAX_KERNELS      = 4;
+  static constexpr u32 MAX_SIZES        = 8;
+  static constexpr u32 MAX_FORMATS      = ARRAY_SIZE(KERNEL_BENCH_FORMATS);
+  static constexpr u32 MAX_WORKGROUPS   = 8;
+  static constexpr u32 MAX_ITERATIONS   = 4096;
+  static constexpr u32 KERNEL_NAME_SIZE = 64;
+
+  char kernels[MAX_KERNELS][KERNEL_NAME_SIZE];
+  u32 kernel_count;
+  VkExtent2D resolutions[MAX_SIZES];
+  u32 resolution_count;
+  VkExtent2D workgroups[MAX_WORKGROUPS];
+  u32 workgroup_count;
+  u32 formats[MAX_FORMATS]; // into KERNEL_BENCH_FORMATS.
+  u32 format_count;
+  u32 iterations;
+  u32 warmup;
+  const char* json_path;
+};
+
+static_assert(
+    Kernel_Bench_Options::MAX_KERNELS * Kernel_Bench_Options::MAX_FORMATS * Kernel_Bench_Options::MAX_WORKGROUPS <=
+        Pipeline_Registry::MAX_PIPELINES,
+    "every combination needs its own pipeline");
+
+// mirrors the push constant block of the kernels.
+struct Kernel_Bench_Push_Constants {
+  f32 data[16];
+  u32 target_index;
+  u32 width;
+  u32 height;
+  u32 pad;
+};
+
+static_assert(sizeof(Kernel_Bench_Push_Constants) <= Bindless_Heap::PUSH_CONSTANT_SIZE, "push constants are too big");
+
+struct Kernel_Bench_Result {
+  const char* kernel;
+  const char* format;
+  VkExtent2D resolution;
+  VkExtent2D workgroup;
+  f64 median_ms;
+  f64 min_ms;
+  f64 mean_ms;
+  f64 mpix_per_s;
+  f64 gb_per_s; // of what the kernel writes, reads aren't counted.
+};
+
+// calls `fn` with every comma separated item of `list`, returns false as soon as it does.
+template <typename Fn>
+static bool for_each_item(const char* list, Fn fn) {
+  while (*list) {
+    const char* end = strchr(list, ',');
+    const u64 size  = end ? (u64)(end - list) : strlen(list);
+    char item[64];
+    if (size == 0 || size >= sizeof(item)) return false;
+    memcpy(item, list, size);
+    item[size] = '\0';
+    if (!fn(item)) return false;
+    list += end ? size + 1 : size;
+  }
+  return true;
+}
+
+static bool parse_extent(const char* text, VkExtent2D& extent) {
+  s32 width = 0, height = 0;
+  if (sscanf(text, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) return false;
+  extent = { (u32)width, (u32)height };
+  return true;
+}
+
+static bool parse_kernel_bench_options(int argc, char** argv, Kernel_Bench_Options& options) {
+  using Options           = Kernel_Bench_Options;
+  const char* kernels     = "gradient,sky";
+  const char* resolutions = "1280x720,1920x1080,3840x2160";
+  const char* workgroups  = "8x8,16x8,16x16,32x8,32x32";
+  const char* formats     = "rgba8,rgba16f,rgba32f";
+  options.iterations      = 64;
+  options.warmup          = 8;
+
+  // argv[1] is --bench-kernels.
+  for (int i = 2; i < argc; ++i) {
+    const char* arg   = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!value) {
+      log_error("[bench] %s needs a value", arg);
+      return false;
+    }
+    if (!strcmp(arg, "--kernels")) kernels = value;
+    else if (!strcmp(arg, "--resolutions")) resolutions = value;
+    else if (!strcmp(arg, "--workgroups")) workgroups = value;
+    else if (!strcmp(arg, "--formats")) formats = value;
+    else if (!strcmp(arg, "--iterations")) options.iterations = (u32)strtoul(value, nullptr, 10);
+    else if (!strcmp(arg, "--warmup")) options.warmup = (u32)strtoul(value, nullptr, 10);
+    else if (!strcmp(arg, "--json")) options.json_path = value;
+    else {
+      log_error("[bench] unknown option %s", arg);
+      return false;
+    }
+    ++i;
+  }
+
+  bool valid = for_each_item(kernels, [&](const char* item) {
+    const u64 size = strlen(item);
+    if (options.kernel_count == Options::MAX_KERNELS || size >= Options::KERNEL_NAME_SIZE) return false;
+    memcpy(options.kernels[options.kernel_count++], item, size + 1);
+    return true;
+  });
+  if (!valid || options.kernel_count == 0) {
+    log_error("[bench] --kernels takes up to %u names, got %s", Options::MAX_KERNELS, kernels);
+    return false;
+  }
+
+  valid = for_each_item(resolutions, [&](const char* item) {
+    if (options.resolution_count == Options::MAX_SIZES) return false;
+    return parse_extent(item, options.resolutions[options.resolution_count++]);
+  });
+  if (!valid || options.resolution_count == 0) {
+    log_error("[bench] --resolutions takes up to %u WIDTHxHEIGHT, got %s", Options::MAX_SIZES, resolutions);
+    return false;
+  }
+
+  valid = for_each_item(workgroups, [&](const char* item) {
+    if (options.workgroup_count == Options::MAX_WORKGROUPS) return false;
+    return parse_extent(item, options.workgroups[options.workgroup_count++]);
+  });
+  if (!valid || options.workgroup_count == 0) {
+    log_error("[bench] --workgroups takes up to %u XxY, got %s", Options::MAX_WORKGROUPS, workgroups);
+    return false;
+  }
+
+  valid = for_each_item(formats, [&](const char* item) {
+    for (u32 i = 0; i < ARRAY_SIZE(KERNEL_BENCH_FORMATS); ++i) {
+      if (strcmp(item, KERNEL_BENCH_FORMATS[i].name)) continue;
+      if (options.format_count == Options::MAX_FORMATS) return false;
+      options.formats[options.format_count++] = i;
+      return true;
+    }
+    return false;
+  });
+  if (!valid || options.format_count == 0) {
+    log_error("[bench] --formats takes rgba8, rgba16f or rgba32f, got %s", formats);
+    return false;
+  }
+
+  if (options.iterations == 0 || options.iterations > Options::MAX_ITERATIONS) {
+    log_error("[bench] --iterations has to be between 1 and %u", Options::MAX_ITERATIONS);
+    return false;
+  }
+  return true;
+}
+
+static Image create_bench_image(const Device& device, VkExtent2D extent, VkFormat format) {
+  Image image  = {};
+  image.extent = { extent.width, extent.height, 1 };
+  image.format = format;
+
+  VkImageCreateInfo image_info = {};
+  image_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType         = VK_IMAGE_TYPE_2D;
+  image_info.format            = format;
+  image_info.extent            = image.extent;
+  image_info.mipLevels         = 1;
+  image_info.arrayLayers       = 1;
+  image_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage             = VK_IMAGE_USAGE_STORAGE_BIT;
+  image_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo allocation_info = {};
+  allocation_info.usage                   = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  VK_CHECK(vmaCreateImage(device.allocator, &image_info, &allocation_info, &image.image, &image.allocation, nullptr));
+
+  VkImageViewCreateInfo view_info           = {};
+  view_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image                           = image.image;
+  view_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format                          = format;
+  view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel   = 0;
+  view_info.subresourceRange.levelCount     = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount     = 1;
+  VK_CHECK(vkCreateImageView(device.logical, &view_info, device.allocator_callbacks, &image.view));
+  return image;
+}
+
+static void destroy_bench_image(const Device& device, Image& image) {
+  vkDestroyImageView(device.logical, image.view, device.allocator_callbacks);
+  vmaDestroyImage(device.allocator, image.image, image.allocation);
+  image = {};
+}
+
+static void compute_barrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout) {
+  VkImageMemoryBarrier2 barrier       = {};
+  barrier.sType                       = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.srcStageMask                = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  barrier.srcAccessMask               = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+  barrier.dstStageMask                = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  barrier.dstAccessMask               = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+  barrier.oldLayout                   = old_layout;
+  barrier.newLayout                   = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex         = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image                       = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+
+  VkDependencyInfo dependency_info        = {};
+  dependency_info.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency_info.imageMemoryBarrierCount = 1;
+  dependency_info.pImageMemoryBarriers    = &barrier;
+  vkCmdPipelineBarrier2(cmd, &dependency_info);
+}
+
+static void write_results_json(
+    const char* path,
+    const char* device_name,
+    const Kernel_Bench_Options& options,
+    const Kernel_Bench_Result* results,
+    u32 count) {
+  FILE* file = nullptr;
+  fopen_s(&file, path, "wb");
+  if (!file) {
+    log_error("[bench] unable to open %s", path);
+    return;
+  }
+  defer { fclose(file); };
+
+  fprintf(file, "{\n  \"device\": \"%s\",\n", device_name);
+  fprintf(file, "  \"iterations\": %u,\n  \"warmup\": %u,\n  \"results\": [\n", options.iterations, options.warmup);
+  for (u32 i = 0; i < count; ++i) {
+    const Kernel_Bench_Result& result = results[i];
+    fprintf(
+        file,
+        "    { \"kernel\": \"%s\", \"format\": \"%s\", \"width\": %u, \"height\": %u, \"workgroup_x\": %u, "
+        "\"workgroup_y\": %u, \"median_ms\": %.6f, \"min_ms\": %.6f, \"mean_ms\": %.6f, \"mpix_per_s\": %.3f, "
+        "\"gb_per_s\": %.3f }%s\n",
+        result.kernel,
+        result.format,
+        result.resolution.width,
+        result.resolution.height,
+        result.workgroup.width,
+        result.workgroup.height,
+        result.median_ms,
+        result.min_ms,
+        result.mean_ms,
+        result.mpix_per_s,
+        result.gb_per_s,
+        i + 1 < count ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+  log_info("[bench] wrote %u results to %s", count, path);
+}
+
+// dispatches a kernel `warmup` + `iterations` times with timestamps around the timed ones, the benchmark and the
+// tuner share it.
+struct Kernel_Timer {
+  VkCommandPool command_pool;
+  VkCommandBuffer cmd;
+  VkQueryPool query_pool;
+  Timeline_Semaphore timeline;
+
+  u32 iterations;
+  u32 warmup;
+  f64 ns_per_tick;
+  u64 valid_mask;
+  u64* timestamps; // a begin and end per timed dispatch.
+  f64* samples;    // ms of the last run, sorted.
+};
+
+struct Kernel_Timing {
+  f64 median_ms;
+  f64 min_ms;
+  f64 mean_ms;
+};
+
+// returns false when the graphics queue can't write timestamps.
+static bool create_kernel_timer(
+    Temp_Linear_Allocator arena,
+    const Device& device,
+    Kernel_Timer& timer,
+    u32 iterations,
+    u32 warmup) {
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device.physical, &properties);
+
+  u32 queue_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device.physical, &queue_count, nullptr);
+  auto queues = arena.push_array_no_init<VkQueueFamilyProperties>(queue_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(device.physical, &queue_count, queues);
+  const u32 valid_bits = queues[device.queue_family].timestampValidBits;
+  if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f) {
+    log_error("[bench] %s can't write timestamps on queue family %u", properties.deviceName, device.queue_family);
+    return false;
+  }
+
+  timer             = {};
+  timer.iterations  = iterations;
+  timer.warmup      = warmup;
+  timer.ns_per_tick = properties.limits.timestampPeriod;
+  timer.valid_mask  = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+  timer.timestamps  = arena.push_array_no_init<u64>(iterations * 2);
+  timer.samples     = arena.push_array_no_init<f64>(iterations);
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex        = device.queue_family;
+  VK_CHECK(vkCreateCommandPool(device.logical, &pool_info, device.allocator_callbacks, &timer.command_pool));
+
+  VkCommandBufferAllocateInfo allocate_info = {};
+  allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool                 = timer.command_pool;
+  allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount          = 1;
+  VK_CHECK(vkAllocateCommandBuffers(device.logical, &allocate_info, &timer.cmd));
+
+  VkQueryPoolCreateInfo query_pool_info = {};
+  query_pool_info.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_info.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+  query_pool_info.queryCount            = iterations * 2;
+  VK_CHECK(vkCreateQueryPool(device.logical, &query_pool_info, device.allocator_callbacks, &timer.query_pool));
+
+  create_timeline_semaphore(device, timer.timeline);
+  return true;
+}
+
+static void destroy_kernel_timer(const Device& device, Kernel_Timer& timer) {
+  destroy_timeline_semaphore(device, timer.timeline);
+  vkDestroyQueryPool(device.logical, timer.query_pool, device.allocator_callbacks);
+  vkDestroyCommandPool(device.logical, timer.command_pool, device.allocator_callbacks);
+  timer = {};
+}
+
+// blocks until the gpu is done, `image` is left in general.
+static Kernel_Timing kernel_timer_run(
+    const Device& device,
+    Kernel_Timer& timer,
+    const Bindless_Heap& bindless,
+    VkPipeline pipeline,
+    Workgroup_Size local_size,
+    const Image& image,
+    const Kernel_Bench_Push_Constants& push_constants) {
+  const VkCommandBuffer cmd = timer.cmd;
+  const u32 groups_x        = workgroup_count(image.extent.width, local_size.x);
+  const u32 groups_y        = workgroup_count(image.extent.height, local_size.y);
+
+  VK_CHECK(vkResetCommandPool(device.logical, timer.command_pool, 0));
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+  vkCmdResetQueryPool(cmd, timer.query_pool, 0, timer.iterations * 2);
+  compute_barrier(cmd, image.image, VK_IMAGE_LAYOUT_UNDEFINED);
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+  bindless_bind(bindless, cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+  vkCmdPushConstants(cmd, bindless.pipeline_layout, VK_SHADER_STAGE_ALL, 0, sizeof(push_constants), &push_constants);
+
+  // every dispatch waits for the previous one, so the timestamps don't overlap.
+  for (u32 i = 0; i < timer.warmup + timer.iterations; ++i) {
+    const bool timed = i >= timer.warmup;
+    const u32 query  = (i - timer.warmup) * 2;
+    if (timed) vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timer.query_pool, query);
+    vkCmdDispatch(cmd, groups_x, groups_y, 1);
+    if (timed) vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timer.query_pool, query + 1);
+    compute_barrier(cmd, image.image, VK_IMAGE_LAYOUT_GENERAL);
+  }
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  const u64 value = timeline_next_value(timer.timeline);
+
+  VkSemaphoreSubmitInfo signal_info = {};
+  signal_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+  signal_info.semaphore             = timer.timeline.semaphore;
+  signal_info.value                 = value;
+  signal_info.stageMask             = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+  VkCommandBufferSubmitInfo command_buffer_info = {};
+  command_buffer_info.sType                     = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+  command_buffer_info.commandBuffer             = cmd;
+
+  VkSubmitInfo2 submit_info            = {};
+  submit_info.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submit_info.commandBufferInfoCount   = 1;
+  submit_info.pCommandBufferInfos      = &command_buffer_info;
+  submit_info.signalSemaphoreInfoCount = 1;
+  submit_info.pSignalSemaphoreInfos    = &signal_info;
+  VK_CHECK(vkQueueSubmit2(device.queue, 1, &submit_info, VK_NULL_HANDLE));
+  timeline_wait(device, timer.timeline, value);
+
+  VK_CHECK(vkGetQueryPoolResults(
+      device.logical,
+      timer.query_pool,
+      0,
+      timer.iterations * 2,
+      sizeof(u64) * timer.iterations * 2,
+      timer.timestamps,
+      sizeof(u64),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+  f64 total_ms = 0.0;
+  for (u32 i = 0; i < timer.iterations; ++i) {
+    const u64 begin  = timer.timestamps[i * 2] & timer.valid_mask;
+    const u64 end    = timer.timestamps[i * 2 + 1] & timer.valid_mask;
+    timer.samples[i] = (f64)((end - begin) & timer.valid_mask) * timer.ns_per_tick / 1e6;
+    total_ms += timer.samples[i];
+  }
+  std::sort(timer.samples, timer.samples + timer.iterations);
+
+  const f64* samples   = timer.samples;
+  const u32 mid        = timer.iterations / 2;
+  Kernel_Timing timing = {};
+  timing.median_ms     = timer.iterations % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) * 0.5;
+  timing.min_ms        = samples[0];
+  timing.mean_ms       = total_ms / timer.iterations;
+  return timing;
+}
+
+// data1 is the sky's color and the gradient's top, data2 the gradient's bottom, like the effects in main.
+static Kernel_Bench_Push_Constants kernel_bench_push_constants(u32 target_index, VkExtent2D extent) {
+  Kernel_Bench_Push_Constants push_constants = {};
+  const f32 data[8]                          = { 0.1f, 0.2f, 0.4f, 0.97f, 0.0f, 0.0f, 1.0f, 1.0f };
+  memcpy(push_constants.data, data, sizeof(data));
+  push_constants.target_index = target_index;
+  push_constants.width        = extent.width;
+  push_constants.height       = extent.height;
+  return push_constants;
+}
+
+int kernel_bench_main(int argc, char** argv) {
+  using Options   = Kernel_Bench_Options;
+  Options options = {};
+  if (!parse_kernel_bench_options(argc, argv, options)) return EXIT_FAILURE;
+
+  Linear_Allocator allocator = { mega_bytes(4) };
+  init_gpu_instance(allocator, true);
+  defer { cleanup_gpu_instance(); };
+
+  auto device = create_device(allocator, true);
+  if (device.logical == VK_NULL_HANDLE) return EXIT_FAILURE;
+  defer { destroy_device(device); };
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device.physical, &properties);
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+
+  Kernel_Timer timer;
+  if (!create_kernel_timer(allocator, device, timer, options.iterations, options.warmup)) return EXIT_FAILURE;
+  defer { destroy_kernel_timer(device, timer); };
+  log_info("[bench] %s, %.3f ns per tick", properties.deviceName, timer.ns_per_tick);
+
+  // only for the log, so the table can be read against what the engine would pick.
+  Workgroup_Tuning tuning;
+  create_workgroup_tuning(device, tuning);
+  defer { destroy_workgroup_tuning(tuning); };
+
+  auto bindless = allocator.push_no_init<Bindless_Heap>();
+  create_bindless_heap(allocator, device, *bindless, 1);
+  defer { destroy_bindless_heap(device, *bindless); };
+
+  // one pipeline per kernel, format and workgroup, those the device can't run stay invalid.
+  Pipeline_Registry registry;
+  create_pipeline_registry(registry, device);
+  defer { destroy_pipeline_registry(registry); };
+
+  Pipeline_Handle pipelines[Options::MAX_KERNELS][Options::MAX_FORMATS][Options::MAX_WORKGROUPS] = {};
+  bool format_supported[Options::MAX_FORMATS] = {};
+  for (u32 f = 0; f < options.format_count; ++f) {
+    const Kernel_Bench_Format& format    = KERNEL_BENCH_FORMATS[options.formats[f]];
+    VkFormatProperties format_properties = {};
+    vkGetPhysicalDeviceFormatProperties(device.physical, format.format, &format_properties);
+    format_supported[f] = (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+    if (!format_supported[f]) log_warn("[bench] skipping %s, no storage image support", format.name);
+  }
+  for (u32 w = 0; w < options.workgroup_count; ++w) {
+    const VkExtent2D size = options.workgroups[w];
+    if (size.width > limits.maxComputeWorkGroupSize[0] || size.height > limits.maxComputeWorkGroupSize[1] ||
+        size.width * size.height > limits.maxComputeWorkGroupInvocations) {
+      log_warn(
+          "[bench] skipping workgroup %ux%u, the device allows %ux%u and %u invocations",
+          size.width,
+          size.height,
+          limits.maxComputeWorkGroupSize[0],
+          limits.maxComputeWorkGroupSize[1],
+          limits.maxComputeWorkGroupInvocations);
+      continue;
+    }
+    for (u32 k = 0; k < options.kernel_count; ++k) {
+      for (u32 f = 0; f < options.format_count; ++f) {
+        if (!format_supported[f]) continue;
+        char shader_path[128];
+        snprintf(
+            shader_path,
+            sizeof(shader_path),
+            "kernel/%s%s.comp.spv",
+            options.kernels[k],
+            KERNEL_BENCH_FORMATS[options.formats[f]].suffix);
+
+        Compute_Pipeline_Desc desc = {};
+        desc.shader_path           = shader_path;
+        desc.layout                = bindless->pipeline_layout;
+        desc.local_size            = { size.width, size.height };
+        pipelines[k][f][w]         = pipeline_registry_add(registry, desc);
+      }
+    }
+  }
+  pipeline_registry_compile(registry);
+  pipeline_registry_wait_all(registry);
+
+  auto results = allocator.push_array_no_init<Kernel_Bench_Result>(
+      Options::MAX_KERNELS * Options::MAX_SIZES * Options::MAX_FORMATS * Options::MAX_WORKGROUPS);
+  u32 result_count = 0;
+
+  Kernel_Bench_Push_Constants push_constants = kernel_bench_push_constants((u32)-1, {});
+
+  printf(
+      "%-12s %-8s %-10s %-9s %10s %10s %10s %10s %8s\n",
+      "kernel",
+      "format",
+      "size",
+      "workgroup",
+      "median ms",
+      "min ms",
+      "mean ms",
+      "Mpix/s",
+      "GB/s");
+
+  // images only exist for one resolution and format at a time, the big float ones add up otherwise.
+  for (u32 r = 0; r < options.resolution_count; ++r) {
+    const VkExtent2D resolution = options.resolutions[r];
+    for (u32 f = 0; f < options.format_count; ++f) {
+      if (!format_supported[f]) continue;
+      const Kernel_Bench_Format& format = KERNEL_BENCH_FORMATS[options.formats[f]];
+
+      Image image = create_bench_image(device, resolution, format.format);
+      defer { destroy_bench_image(device, image); };
+      if (push_constants.target_index == (u32)-1)
+        push_constants.target_index = bindless_add_storage_image(device, *bindless, image.view);
+      else
+        bindless_update_storage_image(device, *bindless, push_constants.target_index, image.view);
+      push_constants.width  = resolution.width;
+      push_constants.height = resolution.height;
+
+      for (u32 k = 0; k < options.kernel_count; ++k) {
+        for (u32 w = 0; w < options.workgroup_count; ++w) {
+          const Pipeline_Handle pipeline = pipelines[k][f][w];
+          if (!pipeline_registry_is_ready(registry, pipeline)) continue;
+
+          const Kernel_Timing timing = kernel_timer_run(
+              device,
+              timer,
+              *bindless,
+              pipeline_registry_get(registry, pipeline),
+              pipeline_registry_local_size(registry, pipeline),
+              image,
+              push_constants);
+
+          const f64 median = timing.median_ms;
+          const f64 texels = (f64)resolution.width * resolution.height;
+
+          Kernel_Bench_Result& result = results[result_count++];
+          result.kernel               = options.kernels[k];
+          result.format               = format.name;
+          result.resolution           = resolution;
+          result.workgroup            = options.workgroups[w];
+          result.median_ms            = median;
+          result.min_ms               = timing.min_ms;
+          result.mean_ms              = timing.mean_ms;
+          result.mpix_per_s           = median > 0.0 ? texels / median / 1e3 : 0.0;
+          result.gb_per_s             = median > 0.0 ? texels * format.texel_size / median / 1e6 : 0.0;
+
+          char size_text[24], workgroup_text[24];
+          snprintf(size_text, sizeof(size_text), "%ux%u", resolution.width, resolution.height);
+          snprintf(workgroup_text, sizeof(workgroup_text), "%ux%u", result.workgroup.width, result.workgroup.height);
+          printf(
+              "%-12s %-8s %-10s %-9s %10.4f %10.4f %10.4f %10.1f %8.2f\n",
+              result.kernel,
+              result.format,
+              size_text,
+              workgroup_text,
+              result.median_ms,
+              result.min_ms,
+              result.mean_ms,
+              result.mpix_per_s,
+              result.gb_per_s);
+        }
+      }
+    }
+  }
+
+  if (options.json_path) write_results_json(options.json_path, properties.deviceName, options, results, result_count);
+  if (result_count == 0) log_error("[bench] nothing could be timed, are the kernels in kernel/?");
+  return result_count ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+bool kernel_bench_tune(
+    Temp_Linear_Allocator arena,
+    const Device& device,
+    Bindless_Heap& bindless,
+    Workgroup_Tuning& tuning,
+    Shader_Compiler* shaders,
+    const char* shader_path,
+    VkExtent2D extent,
+    VkFormat format) {
+  defer { arena.clear(); };
+  Kernel_Timer timer;
+  if (!create_kernel_timer(arena, device, timer, 32, 4)) return false;
+  defer { destroy_kernel_timer(device, timer); };
+
+  // a registry of its own, the candidates that lose shouldn't stay around in the engine's.
+  Pipeline_Registry registry;
+  create_pipeline_registry(registry, device, shaders);
+  defer { destroy_pipeline_registry(registry); };
+
+  Pipeline_Handle candidates[Workgroup_Tuning::MAX_CANDIDATES];
+  for (u32 i = 0; i < tuning.candidate_count; ++i) {
+    Compute_Pipeline_Desc desc = {};
+    desc.shader_path           = shader_path;
+    desc.layout                = bindless.pipeline_layout;
+    desc.local_size            = tuning.candidates[i];
+    candidates[i]              = pipeline_registry_add(registry, desc);
+  }
+  pipeline_registry_compile(registry);
+  pipeline_registry_wait_all(registry);
+
+  Image image = create_bench_image(device, extent, format);
+  defer { destroy_bench_image(device, image); };
+  const u32 target_index = bindless_add_storage_image(device, bindless, image.view);
+  defer { bindless_free(bindless, Bindless_Type::storage_image, target_index); };
+  const Kernel_Bench_Push_Constants push_constants = kernel_bench_push_constants(target_index, extent);
+
+  u32 best    = (u32)-1;
+  f64 best_ms = 0.0;
+  for (u32 i = 0; i < tuning.candidate_count; ++i) {
+    if (!pipeline_registry_is_ready(registry, candidates[i])) continue;
+    const Workgroup_Size size  = tuning.candidates[i];
+    const Kernel_Timing timing = kernel_timer_run(
+        device,
+        timer,
+        bindless,
+        pipeline_registry_get(registry, candidates[i]),
+        size,
+        image,
+        push_constants);
+    log_info("[workgroups] %s at %ux%u: %.4fms", shader_path, size.x, size.y, timing.median_ms);
+    if (best == (u32)-1 || timing.median_ms < best_ms) {
+      best    = i;
+      best_ms = timing.median_ms;
+    }
+  }
+  if (best == (u32)-1) {
+    log_error("[workgroups] %s didn't compile with any candidate", shader_path);
+    return false;
+  }
+  workgroup_set_tuned(tuning, shader_path, tuning.candidates[best], (f32)best_ms);
+  return true;
+}
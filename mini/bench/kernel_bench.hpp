@@ -0,0 +1,34 @@
+#pragma once
+#include "core/memory.hpp"
+#include "defs.hpp"
+#include "gpu/bindless.hpp"
+#include "gpu/device.hpp"
+#include "gpu/workgroup_tuning.hpp"
+
+/// Times compute kernels from `extra/kernel` over every combination of resolution, workgroup size and storage
+/// format, started with `--bench-kernels` as the first argument. Runs on a headless device so it works on ci and
+/// software drivers like lavapipe. Every kernel needs its workgroup size as specialization constants 0 and 1 and a
+/// variant per format, `extra/kernel/build.bat` builds them.
+///
+///   --kernels gradient,sky       kernel/<name>.comp.spv, kernel/<name>.<format>.comp.spv for other formats.
+///   --resolutions 1280x720,...   images the kernels write to.
+///   --workgroups 8x8,16x16,...   local sizes, the ones the device doesn't support are skipped.
+///   --formats rgba16f,rgba8,...  rgba8, rgba16f or rgba32f.
+///   --iterations 64              timed dispatches per combination, after `--warmup` untimed ones.
+///   --json path                  writes the results there as well.
+///
+/// Returns EXIT_FAILURE when nothing could be timed.
+int kernel_bench_main(int argc, char** argv);
+
+/// Times the kernel at `shader_path` with every candidate of `tuning`, writing a `format` image of `extent`, and
+/// keeps the fastest in `tuning`. Submits to the graphics queue and waits, meant for startup. `shaders` compiles the
+/// kernel when it is GLSL.
+bool kernel_bench_tune(
+    Temp_Linear_Allocator arena,
+    const Device& device,
+    Bindless_Heap& bindless,
+    Workgroup_Tuning& tuning,
+    Shader_Compiler* shaders,
+    const char* shader_path,
+    VkExtent2D extent,
+    VkFormat format);
@@ -51,3 +51,11 @@ u64 hash_djb2(const char* str) {
   return hash_value;
 }
 
+u64 hash_bytes(const void* data, u64 size, u64 seed) {
+  u64 hash_value = seed;
+  auto bytes     = (const u8*)data;
+  for (u64 i = 0; i < size; ++i) {
+    hash_value = (hash_value ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash_value;
+}
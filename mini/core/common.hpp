@@ -41,3 +41,6 @@ struct Time {
 u64 hash_sdbm(const char* str);
 u64 hash_djb2(const char* str);
 
+/// fnv-1a over raw bytes, pass the previous result as `seed` to hash several pieces together.
+u64 hash_bytes(const void* data, u64 size, u64 seed = 14695981039346656037ull);
+
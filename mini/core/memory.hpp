@@ -1,6 +1,8 @@
 #pragma once
 #include "defs.hpp"
 #include <cassert>
+#include <cstring>
+#include <type_traits>
 
 template <typename V, typename T = s32>
 struct Relative_Pointer {
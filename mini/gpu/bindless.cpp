@@ -0,0 +1,229 @@
+#include "bindless.hpp"
+#include "log.hpp"
+#include <cassert>
+
+constexpr u32 Bindless_Heap::MAX_DESCRIPTORS[];
+
+static const VkDescriptorType bindless_descriptor_types[(u32)Bindless_Type::count] = {
+  VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+  VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+  VK_DESCRIPTOR_TYPE_SAMPLER,
+  VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+};
+
+static const char* bindless_type_names[(u32)Bindless_Type::count] = {
+  "sampled images",
+  "storage images",
+  "samplers",
+  "storage buffers",
+};
+
+void create_bindless_heap(Linear_Allocator& arena, const Device& device, Bindless_Heap& heap, u32 frames_in_flight) {
+  VkPhysicalDeviceVulkan12Properties properties12 = {};
+  properties12.sType                              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext                       = &properties12;
+  vkGetPhysicalDeviceProperties2(device.physical, &properties);
+
+  // every binding is visible to every stage, so the per stage limits are the ones that bite.
+  const u32 device_limits[(u32)Bindless_Type::count] = {
+    properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+    properties12.maxPerStageDescriptorUpdateAfterBindStorageImages,
+    properties12.maxPerStageDescriptorUpdateAfterBindSamplers,
+    properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+  };
+
+  VkDescriptorSetLayoutBinding bindings[(u32)Bindless_Type::count] = {};
+  VkDescriptorBindingFlags binding_flags[(u32)Bindless_Type::count];
+  VkDescriptorPoolSize pool_sizes[(u32)Bindless_Type::count];
+  for (u32 i = 0; i < (u32)Bindless_Type::count; ++i) {
+    auto& slots       = heap.slots[i];
+    slots.capacity    = clamp(Bindless_Heap::MAX_DESCRIPTORS[i], 1u, device_limits[i]);
+    slots.next_unused = 0;
+    slots.free_count  = 0;
+    slots.free_list   = arena.push_array_no_init<u32>(slots.capacity);
+
+    bindings[i].binding         = i;
+    bindings[i].descriptorType  = bindless_descriptor_types[i];
+    bindings[i].descriptorCount = slots.capacity;
+    bindings[i].stageFlags      = VK_SHADER_STAGE_ALL;
+
+    // most slots are empty at any given time, and we write new ones while older frames are still in flight.
+    binding_flags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+        VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    pool_sizes[i].type            = bindless_descriptor_types[i];
+    pool_sizes[i].descriptorCount = slots.capacity;
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info = {};
+  binding_flags_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  binding_flags_info.bindingCount  = ARRAY_SIZE(binding_flags);
+  binding_flags_info.pBindingFlags = binding_flags;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.pNext                           = &binding_flags_info;
+  layout_info.flags                           = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layout_info.bindingCount                    = ARRAY_SIZE(bindings);
+  layout_info.pBindings                       = bindings;
+  VK_CHECK(vkCreateDescriptorSetLayout(device.logical, &layout_info, device.allocator_callbacks, &heap.set_layout));
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.flags                      = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  pool_info.maxSets                    = 1;
+  pool_info.poolSizeCount              = ARRAY_SIZE(pool_sizes);
+  pool_info.pPoolSizes                 = pool_sizes;
+  VK_CHECK(vkCreateDescriptorPool(device.logical, &pool_info, device.allocator_callbacks, &heap.pool));
+
+  VkDescriptorSetAllocateInfo set_info = {};
+  set_info.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  set_info.descriptorPool              = heap.pool;
+  set_info.descriptorSetCount          = 1;
+  set_info.pSetLayouts                 = &heap.set_layout;
+  VK_CHECK(vkAllocateDescriptorSets(device.logical, &set_info, &heap.set));
+
+  VkPushConstantRange push_constant_range = {};
+  push_constant_range.stageFlags          = VK_SHADER_STAGE_ALL;
+  push_constant_range.offset              = 0;
+  push_constant_range.size                = Bindless_Heap::PUSH_CONSTANT_SIZE;
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+  pipeline_layout_info.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipeline_layout_info.setLayoutCount             = 1;
+  pipeline_layout_info.pSetLayouts                = &heap.set_layout;
+  pipeline_layout_info.pushConstantRangeCount     = 1;
+  pipeline_layout_info.pPushConstantRanges        = &push_constant_range;
+  VK_CHECK(vkCreatePipelineLayout(
+      device.logical,
+      &pipeline_layout_info,
+      device.allocator_callbacks,
+      &heap.pipeline_layout));
+
+  heap.retired_count    = 0;
+  heap.frames_in_flight = frames_in_flight;
+  heap.frame            = 0;
+
+  log_info(
+      "[bindless] %u sampled images, %u storage images, %u samplers, %u storage buffers",
+      heap.slots[(u32)Bindless_Type::sampled_image].capacity,
+      heap.slots[(u32)Bindless_Type::storage_image].capacity,
+      heap.slots[(u32)Bindless_Type::sampler].capacity,
+      heap.slots[(u32)Bindless_Type::storage_buffer].capacity);
+}
+
+void destroy_bindless_heap(const Device& device, Bindless_Heap& heap) {
+  vkDestroyPipelineLayout(device.logical, heap.pipeline_layout, device.allocator_callbacks);
+  vkDestroyDescriptorPool(device.logical, heap.pool, device.allocator_callbacks);
+  vkDestroyDescriptorSetLayout(device.logical, heap.set_layout, device.allocator_callbacks);
+}
+
+void bindless_begin_frame(Bindless_Heap& heap) {
+  heap.frame++;
+
+  // the frame `frames_in_flight` ago was just waited on, anything freed then or before is idle.
+  u32 kept = 0;
+  for (u32 i = 0; i < heap.retired_count; ++i) {
+    const auto& retired = heap.retired[i];
+    if (retired.frame + heap.frames_in_flight <= heap.frame) {
+      auto& slots                         = heap.slots[(u32)retired.type];
+      slots.free_list[slots.free_count++] = retired.index;
+    } else {
+      heap.retired[kept++] = retired;
+    }
+  }
+  heap.retired_count = kept;
+}
+
+static u32 bindless_allocate(Bindless_Heap& heap, Bindless_Type type) {
+  auto& slots = heap.slots[(u32)type];
+  if (slots.free_count > 0) return slots.free_list[--slots.free_count];
+  if (slots.next_unused < slots.capacity) return slots.next_unused++;
+
+  log_error("[bindless] out of %s (%u)", bindless_type_names[(u32)type], slots.capacity);
+  assert(false);
+  return 0;
+}
+
+static void bindless_write(
+    const Device& device,
+    const Bindless_Heap& heap,
+    Bindless_Type type,
+    u32 index,
+    const VkDescriptorImageInfo* image_info,
+    const VkDescriptorBufferInfo* buffer_info) {
+  VkWriteDescriptorSet write = {};
+  write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet               = heap.set;
+  write.dstBinding           = (u32)type;
+  write.dstArrayElement      = index;
+  write.descriptorCount      = 1;
+  write.descriptorType       = bindless_descriptor_types[(u32)type];
+  write.pImageInfo           = image_info;
+  write.pBufferInfo          = buffer_info;
+  vkUpdateDescriptorSets(device.logical, 1, &write, 0, nullptr);
+}
+
+u32 bindless_add_sampled_image(const Device& device, Bindless_Heap& heap, VkImageView view, VkImageLayout layout) {
+  VkDescriptorImageInfo image_info = {};
+  image_info.imageView             = view;
+  image_info.imageLayout           = layout;
+
+  u32 index = bindless_allocate(heap, Bindless_Type::sampled_image);
+  bindless_write(device, heap, Bindless_Type::sampled_image, index, &image_info, nullptr);
+  return index;
+}
+
+u32 bindless_add_storage_image(const Device& device, Bindless_Heap& heap, VkImageView view) {
+  u32 index = bindless_allocate(heap, Bindless_Type::storage_image);
+  bindless_update_storage_image(device, heap, index, view);
+  return index;
+}
+
+void bindless_update_storage_image(const Device& device, Bindless_Heap& heap, u32 index, VkImageView view) {
+  VkDescriptorImageInfo image_info = {};
+  image_info.imageView             = view;
+  image_info.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+  bindless_write(device, heap, Bindless_Type::storage_image, index, &image_info, nullptr);
+}
+
+u32 bindless_add_sampler(const Device& device, Bindless_Heap& heap, VkSampler sampler) {
+  VkDescriptorImageInfo image_info = {};
+  image_info.sampler               = sampler;
+
+  u32 index = bindless_allocate(heap, Bindless_Type::sampler);
+  bindless_write(device, heap, Bindless_Type::sampler, index, &image_info, nullptr);
+  return index;
+}
+
+u32 bindless_add_storage_buffer(
+    const Device& device,
+    Bindless_Heap& heap,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkDeviceSize range) {
+  VkDescriptorBufferInfo buffer_info = {};
+  buffer_info.buffer                 = buffer;
+  buffer_info.offset                 = offset;
+  buffer_info.range                  = range;
+
+  u32 index = bindless_allocate(heap, Bindless_Type::storage_buffer);
+  bindless_write(device, heap, Bindless_Type::storage_buffer, index, nullptr, &buffer_info);
+  return index;
+}
+
+void bindless_free(Bindless_Heap& heap, Bindless_Type type, u32 index) {
+  assert(index < heap.slots[(u32)type].capacity);
+  assert(heap.retired_count < Bindless_Heap::MAX_RETIRED);
+  auto& retired = heap.retired[heap.retired_count++];
+  retired.frame = heap.frame;
+  retired.type  = type;
+  retired.index = index;
+}
+
+void bindless_bind(const Bindless_Heap& heap, VkCommandBuffer cmd, VkPipelineBindPoint bind_point) {
+  vkCmdBindDescriptorSets(cmd, bind_point, heap.pipeline_layout, 0, 1, &heap.set, 0, nullptr);
+}
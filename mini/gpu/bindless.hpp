@@ -0,0 +1,63 @@
+#pragma once
+#include "common.hpp"
+#include "device.hpp"
+
+/// Binding slots in the global set, kernels include `extra/kernel/bindless.glsl` which mirrors this.
+enum struct Bindless_Type : u32 { sampled_image, storage_image, sampler, storage_buffer, count };
+
+/// One update-after-bind descriptor set holding every resource, shaders get plain u32 indices through push
+/// constants. It is bound once per command buffer together with the shared pipeline layout.
+struct Bindless_Heap {
+  static constexpr u32 MAX_DESCRIPTORS[(u32)Bindless_Type::count] = { 4096, 1024, 64, 1024 };
+  static constexpr u32 MAX_RETIRED                                = 1024;
+  static constexpr u32 PUSH_CONSTANT_SIZE                         = 128; // the minimum every device guarantees.
+
+  VkDescriptorSetLayout set_layout;
+  VkDescriptorPool pool;
+  VkDescriptorSet set;
+  VkPipelineLayout pipeline_layout;
+
+  // per type free list, `next_unused` hands out slots that were never used before the list gets touched.
+  struct Slots {
+    u32 capacity;
+    u32 next_unused;
+    u32 free_count;
+    u32* free_list;
+  } slots[(u32)Bindless_Type::count];
+
+  // indices freed while the gpu may still be reading them, they go back to the free lists `frames_in_flight`
+  // frames later.
+  struct Retired {
+    u64 frame;
+    Bindless_Type type;
+    u32 index;
+  } retired[MAX_RETIRED];
+  u32 retired_count;
+  u32 frames_in_flight;
+  u64 frame;
+};
+
+void create_bindless_heap(Linear_Allocator& arena, const Device& device, Bindless_Heap& heap, u32 frames_in_flight);
+void destroy_bindless_heap(const Device& device, Bindless_Heap& heap);
+
+/// Call once per submitted frame after waiting for the gpu to finish the frame `frames_in_flight` ago, recycles what
+/// the gpu is done with.
+void bindless_begin_frame(Bindless_Heap& heap);
+
+u32 bindless_add_sampled_image(const Device& device, Bindless_Heap& heap, VkImageView view, VkImageLayout layout);
+u32 bindless_add_storage_image(const Device& device, Bindless_Heap& heap, VkImageView view);
+u32 bindless_add_sampler(const Device& device, Bindless_Heap& heap, VkSampler sampler);
+u32 bindless_add_storage_buffer(
+    const Device& device,
+    Bindless_Heap& heap,
+    VkBuffer buffer,
+    VkDeviceSize offset = 0,
+    VkDeviceSize range  = VK_WHOLE_SIZE);
+
+/// Points an existing slot at a new resource, for things that get recreated like render targets after a resize.
+void bindless_update_storage_image(const Device& device, Bindless_Heap& heap, u32 index, VkImageView view);
+
+/// The slot stays untouched until the frames that could still read it are done.
+void bindless_free(Bindless_Heap& heap, Bindless_Type type, u32 index);
+
+void bindless_bind(const Bindless_Heap& heap, VkCommandBuffer cmd, VkPipelineBindPoint bind_point);
@@ -3,6 +3,7 @@
 #include "core/memory.hpp"
 #include "defs.hpp"
 #include "log.hpp"
+#include "pipeline_cache.hpp"
 #include <GLFW/glfw3.h>
 #include <cstring>
 
@@ -21,25 +22,8 @@
 #define VK_DEBUG 0
 #endif // DEBUG
 
-#if defined(_WIN32) || defined(WIN32)
-#define GPU_PLATFORM_SURFACE "VK_KHR_win32_surface"
-#else
-#error "Other platforms not supported currently"
-#endif
-
-static constexpr auto VK_API_VERSION                  = VK_API_VERSION_1_3;
-static constexpr const char* VK_VALIDATION_LAYER      = "VK_LAYER_KHRONOS_validation";
-static constexpr const char* VK_REQUIRED_EXTENSIONS[] = {
-  "VK_KHR_surface",
-  GPU_PLATFORM_SURFACE,
-#if VK_DEBUG
-#if VERBOSE_DEBUG
-  VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
-#else
-  VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
-#endif
-#endif
-};
+static constexpr auto VK_API_VERSION             = VK_API_VERSION_1_3;
+static constexpr const char* VK_VALIDATION_LAYER = "VK_LAYER_KHRONOS_validation";
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_callback(
     VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -100,7 +84,8 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL vk_debug_report(
   return VK_FALSE;
 }
 
-static bool is_instance_extensions_available(
+// for instance and device extension lists alike.
+static bool is_extensions_available(
     const VkExtensionProperties* properties,
     u32 properties_count,
     const char* extension) {
@@ -134,7 +119,7 @@ static VkDebugUtilsMessengerEXT debug_messenger = VK_NULL_HANDLE;
 #endif
 static bool vk_debug_layers_present = false;
 
-VkInstance init_gpu_instance(Temp_Linear_Allocator arena) {
+VkInstance init_gpu_instance(Temp_Linear_Allocator arena, bool headless) {
   VkApplicationInfo app_info  = {};
   app_info.sType              = VK_STRUCTURE_TYPE_APPLICATION_INFO;
   app_info.pNext              = nullptr;
@@ -159,6 +144,8 @@ VkInstance init_gpu_instance(Temp_Linear_Allocator arena) {
       break;
     }
   }
+  // ci boxes often come without the validation layer, run without it there.
+  if (!layers) layer_count = 0;
   arena.clear();
 #endif
 
@@ -177,29 +164,30 @@ VkInstance init_gpu_instance(Temp_Linear_Allocator arena) {
   auto properties = arena.push_array_no_init<VkExtensionProperties>(properties_count);
   VK_CHECK(vkEnumerateInstanceExtensionProperties(nullptr, &properties_count, properties));
 
-  u32 instance_extensions_count = ARRAY_SIZE(VK_REQUIRED_EXTENSIONS);
+  // the surface extensions come from glfw, a headless instance goes without them.
+  u32 surface_extension_count     = 0;
+  const char** surface_extensions = nullptr;
+  if (!headless) {
+    surface_extensions = glfwGetRequiredInstanceExtensions(&surface_extension_count);
+    assert(surface_extensions && "glfw has to be initialized with vulkan support first");
+  }
+
+  u32 instance_extensions_count = 0;
   // Enable required extensions
-  auto instance_extensions = arena.push_array_no_init<const char*>(instance_extensions_count + 4);
-  // first memcpy everything
-  memcpy(instance_extensions, VK_REQUIRED_EXTENSIONS, sizeof(const char*) * instance_extensions_count);
-
-  if (is_instance_extensions_available(
-          properties,
-          properties_count,
-          VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+  auto instance_extensions = arena.push_array_no_init<const char*>(surface_extension_count + 4);
+  for (u32 i = 0; i < surface_extension_count; ++i) {
+    instance_extensions[instance_extensions_count++] = surface_extensions[i];
+  }
+
+  if (is_extensions_available(properties, properties_count, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
     instance_extensions[instance_extensions_count++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
 #ifdef VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME
-  if (is_instance_extensions_available(properties, properties_count, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)) {
+  if (is_extensions_available(properties, properties_count, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME)) {
     instance_extensions[instance_extensions_count++] = VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME;
     create_info.flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
   }
 #endif
 
-  // Enabling validation layers
-  const char* validation_layers[] = { "VK_LAYER_KHRONOS_validation" };
-  create_info.enabledLayerCount   = 1;
-  create_info.ppEnabledLayerNames = validation_layers;
-
 #if VK_DEBUG
 #if VERBOSE_DEBUG
   instance_extensions[instance_extensions_count++] = VK_EXT_DEBUG_REPORT_EXTENSION_NAME;
@@ -275,11 +263,12 @@ void cleanup_gpu_instance() {
   // volkFinalize();
 }
 
-Device create_device(Temp_Linear_Allocator arena) {
+Device create_device(Temp_Linear_Allocator arena, bool headless) {
   /// TODO: add maybe properties to check? For rendering, for compute...
   Device device              = {};
   device.instance            = instance;
   device.allocator_callbacks = allocator_callbacks;
+  device.headless            = headless;
 
   VkDevice& logical_device          = device.logical;
   VkPhysicalDevice& physical_device = device.physical;
@@ -294,6 +283,11 @@ Device create_device(Temp_Linear_Allocator arena) {
 
   constexpr auto required_version = VK_API_VERSION_1_3;
 
+  // the first device that passed every check, taken when none of them is a discrete gpu (integrated or software only
+  // machines like lavapipe on ci).
+  VkPhysicalDevice fallback_device = VK_NULL_HANDLE;
+  u32 fallback_queue_family        = (u32)-1;
+
   auto scratch = arena.save();
   for (u32 i = 0; i < gpu_count; ++i) {
     // should save stack here. or create a temporary scratch arena. not sure...
@@ -335,6 +329,14 @@ Device create_device(Temp_Linear_Allocator arena) {
     if (features13.synchronization2 != VK_TRUE) continue;
     if (features12.descriptorIndexing != VK_TRUE) continue;
     if (features12.bufferDeviceAddress != VK_TRUE) continue;
+    if (features12.timelineSemaphore != VK_TRUE) continue;
+    // bindless heap.
+    if (features12.runtimeDescriptorArray != VK_TRUE) continue;
+    if (features12.descriptorBindingPartiallyBound != VK_TRUE) continue;
+    if (features12.descriptorBindingUpdateUnusedWhilePending != VK_TRUE) continue;
+    if (features12.descriptorBindingSampledImageUpdateAfterBind != VK_TRUE) continue;
+    if (features12.descriptorBindingStorageImageUpdateAfterBind != VK_TRUE) continue;
+    if (features12.descriptorBindingStorageBufferUpdateAfterBind != VK_TRUE) continue;
     if (features.features.geometryShader != VK_TRUE) continue;
 
     u32 extension_count = 0;
@@ -350,7 +352,7 @@ Device create_device(Temp_Linear_Allocator arena) {
     }
 
     // did not find
-    if (j == extension_count) continue;
+    if (!headless && j == extension_count) continue;
 
     // queue family index
     u32 probable_queue_fam = (u32)-1;
@@ -362,7 +364,7 @@ Device create_device(Temp_Linear_Allocator arena) {
       vkGetPhysicalDeviceQueueFamilyProperties(gpus[i], &count, queues);
       for (u32 j = 0; j < count; ++j) {
         if ((queues[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
-            vk_platform_get_physical_device_present_support(instance, gpus[i], j) == VK_TRUE) {
+            (headless || vk_platform_get_physical_device_present_support(instance, gpus[i], j) == VK_TRUE)) {
           probable_queue_fam = j;
           assert(queues[j].queueFlags & VK_QUEUE_TRANSFER_BIT);
           break;
@@ -374,6 +376,10 @@ Device create_device(Temp_Linear_Allocator arena) {
       }
     }
 
+    if (fallback_device == VK_NULL_HANDLE) {
+      fallback_device       = gpus[i];
+      fallback_queue_family = probable_queue_fam;
+    }
     if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
       physical_device = gpus[i];
       queue_family    = probable_queue_fam;
@@ -381,31 +387,62 @@ Device create_device(Temp_Linear_Allocator arena) {
     }
   }
 
-  // nothing was selected
+  // no discrete gpu was selected
   if (physical_device == VK_NULL_HANDLE) {
-    physical_device = gpus[0];
-    u32 count       = 0;
+    physical_device = fallback_device;
+    queue_family    = fallback_queue_family;
+  }
+  if (physical_device == VK_NULL_HANDLE) {
+    log_error(
+        "[device] none of the %u gpus supports vulkan 1.3 with timeline semaphores, descriptor indexing for the "
+        "bindless heap and the other required features%s",
+        gpu_count,
+        headless ? "" : ", or none can present");
+    arena.clear();
+    return device;
+  }
+
+  arena.clear();
+
+  // async compute: a compute only family runs next to graphics on most hardware, a second queue of the graphics
+  // family is the next best thing. without either everything goes through `queue`.
+  u32 compute_queue_index = 0;
+  {
+    u32 count = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
-    assert(count > 0);
     auto queues = arena.push_array_no_init<VkQueueFamilyProperties>(count);
     vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queues);
+
+    device.compute_queue_family = queue_family;
     for (u32 i = 0; i < count; ++i) {
-      if (queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT &&
-          vk_platform_get_physical_device_present_support(instance, physical_device, i) == VK_TRUE) {
-        queue_family = i;
-        assert(queues[i].queueFlags & VK_QUEUE_TRANSFER_BIT);
+      if ((queues[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queues[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+        device.compute_queue_family = i;
+        device.async_compute        = true;
         break;
       }
     }
-    assert(queue_family == (u32)-1);
-  }
+    if (!device.async_compute && queues[queue_family].queueCount > 1) {
+      compute_queue_index  = 1;
+      device.async_compute = true;
+    }
 
-  arena.clear();
+    // copy engines show up as families with nothing but transfer (and sparse binding).
+    device.transfer_queue_family = queue_family;
+    for (u32 i = 0; i < count; ++i) {
+      const VkQueueFlags flags = queues[i].queueFlags;
+      if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        device.transfer_queue_family = i;
+        device.dedicated_transfer    = true;
+        break;
+      }
+    }
+    arena.clear();
+  }
 
   // create a device
-  const char** device_extentions               = arena.push_array_no_init<const char*>(3);
-  u32 device_extensions_count                  = 0;
-  device_extentions[device_extensions_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+  const char** device_extentions = arena.push_array_no_init<const char*>(8);
+  u32 device_extensions_count    = 0;
+  if (!headless) device_extentions[device_extensions_count++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
 
   u32 extension_count = 0;
   vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr);
@@ -416,17 +453,59 @@ Device create_device(Temp_Linear_Allocator arena) {
   if (is_extensions_available(available_extensions, extension_count, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME))
     device_extensions[device_extensions_count++] = VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME;
 #endif
-  const float queue_priority         = 1.0f;
-  VkDeviceQueueCreateInfo queue_info = {};
-  queue_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queue_info.queueFamilyIndex        = queue_family;
-  queue_info.queueCount              = 1;
-  queue_info.pQueuePriorities        = &queue_priority;
+  if (is_extensions_available(available_extensions, extension_count, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+    device_extentions[device_extensions_count++] = VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME;
+    device.calibrated_timestamps                 = true;
+  }
+
+  // waiting for presents to reach the screen takes both extensions and their features.
+  VkPhysicalDevicePresentIdFeaturesKHR present_id_features     = {};
+  VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {};
+
+  present_id_features.sType   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  present_id_features.pNext   = &present_wait_features;
+  present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  if (!headless &&
+      is_extensions_available(available_extensions, extension_count, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+      is_extensions_available(available_extensions, extension_count, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    VkPhysicalDeviceFeatures2 features = {};
+    features.sType                     = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext                     = &present_id_features;
+    vkGetPhysicalDeviceFeatures2(physical_device, &features);
+    if (present_id_features.presentId && present_wait_features.presentWait) {
+      device_extentions[device_extensions_count++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+      device_extentions[device_extensions_count++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+      device.present_wait                          = true;
+    }
+  }
+
+  const float queue_priorities[2]                = { 1.0f, 1.0f };
+  VkDeviceQueueCreateInfo queue_infos[3]         = {};
+  u32 queue_info_count                           = 0;
+  queue_infos[queue_info_count].sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+  queue_infos[queue_info_count].queueFamilyIndex = queue_family;
+  queue_infos[queue_info_count].queueCount       = 1 + compute_queue_index;
+  queue_infos[queue_info_count].pQueuePriorities = queue_priorities;
+  queue_info_count++;
+  if (device.compute_queue_family != queue_family) {
+    queue_infos[queue_info_count].sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_infos[queue_info_count].queueFamilyIndex = device.compute_queue_family;
+    queue_infos[queue_info_count].queueCount       = 1;
+    queue_infos[queue_info_count].pQueuePriorities = queue_priorities;
+    queue_info_count++;
+  }
+  if (device.dedicated_transfer) {
+    queue_infos[queue_info_count].sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queue_infos[queue_info_count].queueFamilyIndex = device.transfer_queue_family;
+    queue_infos[queue_info_count].queueCount       = 1;
+    queue_infos[queue_info_count].pQueuePriorities = queue_priorities;
+    queue_info_count++;
+  }
 
   VkDeviceCreateInfo create_info      = {};
   create_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  create_info.queueCreateInfoCount    = 1;
-  create_info.pQueueCreateInfos       = &queue_info;
+  create_info.queueCreateInfoCount    = queue_info_count;
+  create_info.pQueueCreateInfos       = queue_infos;
   create_info.enabledExtensionCount   = device_extensions_count;
   create_info.ppEnabledExtensionNames = device_extentions;
 
@@ -434,7 +513,16 @@ Device create_device(Temp_Linear_Allocator arena) {
   features12.sType               = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
   features12.bufferDeviceAddress = VK_TRUE;
   features12.descriptorIndexing  = VK_TRUE;
-  features12.pNext               = nullptr;
+  features12.timelineSemaphore   = VK_TRUE; // frames in flight are tracked with one per queue.
+  features12.pNext               = device.present_wait ? &present_id_features : nullptr;
+
+  // bindless heap.
+  features12.runtimeDescriptorArray                        = VK_TRUE;
+  features12.descriptorBindingPartiallyBound               = VK_TRUE;
+  features12.descriptorBindingUpdateUnusedWhilePending     = VK_TRUE;
+  features12.descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE;
+  features12.descriptorBindingStorageImageUpdateAfterBind  = VK_TRUE;
+  features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
 
   // vulkan 1.3 features
   VkPhysicalDeviceVulkan13Features features13{};
@@ -447,6 +535,25 @@ Device create_device(Temp_Linear_Allocator arena) {
 
   VK_CHECK(vkCreateDevice(physical_device, &create_info, allocator_callbacks, &logical_device));
   vkGetDeviceQueue(logical_device, queue_family, 0, &queue);
+  vkGetDeviceQueue(logical_device, device.compute_queue_family, compute_queue_index, &device.compute_queue);
+  log_info(
+      "[device] graphics family %u, compute family %u queue %u%s",
+      queue_family,
+      device.compute_queue_family,
+      compute_queue_index,
+      device.async_compute ? "" : " (no async compute, shared with graphics)");
+  if (headless) {
+    log_info("[device] headless, no surface or swapchain support");
+  } else if (!device.present_wait) {
+    log_info("[device] no present wait, frame pacing falls back to the gpu timeline");
+  }
+  if (device.dedicated_transfer) {
+    vkGetDeviceQueue(logical_device, device.transfer_queue_family, 0, &device.transfer_queue);
+    log_info("[device] transfer family %u", device.transfer_queue_family);
+  } else {
+    device.transfer_queue = queue;
+    log_info("[device] no dedicated transfer family, uploads go through graphics");
+  }
 
   // initialize the memory allocator
   VmaAllocatorCreateInfo allocator_create_info = {};
@@ -456,12 +563,17 @@ Device create_device(Temp_Linear_Allocator arena) {
   allocator_create_info.flags                  = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
   VK_CHECK(vmaCreateAllocator(&allocator_create_info, &device.allocator));
 
+  load_pipeline_cache(arena, device);
+
   arena.clear();
   // volkLoadDevice(device);
   return device;
 }
 
 void destroy_device(Device device) {
+  if (device.logical == VK_NULL_HANDLE) return;
+  save_pipeline_cache(device);
+  vkDestroyPipelineCache(device.logical, device.pipeline_cache, allocator_callbacks);
   vmaDestroyAllocator(device.allocator);
   vkDestroyDevice(device.logical, allocator_callbacks);
 }
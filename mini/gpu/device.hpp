@@ -19,12 +19,35 @@ struct Device {
   VkQueue queue             = VK_NULL_HANDLE;
   VmaAllocator allocator;
   u32 queue_family = (u32)-1;
+
+  // for async compute, the same queue as `queue` when the device has no other one to spare.
+  VkQueue compute_queue    = VK_NULL_HANDLE;
+  u32 compute_queue_family = (u32)-1;
+  bool async_compute       = false; // `compute_queue` runs next to `queue`.
+
+  // uploads, a dma only family when there is one and `queue` otherwise.
+  VkQueue transfer_queue    = VK_NULL_HANDLE;
+  u32 transfer_queue_family = (u32)-1;
+  bool dedicated_transfer   = false;
+
+  // pass to every pipeline creation, saved to disk by `destroy_device`.
+  VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+
+  // created without surface and swapchain support, rendering goes to offscreen images only.
+  bool headless = false;
+
+  // optional extensions that were found and enabled.
+  bool calibrated_timestamps = false;
+  bool present_wait          = false; // VK_KHR_present_id and VK_KHR_present_wait, for frame pacing.
 };
 
-VkInstance init_gpu_instance(Temp_Linear_Allocator arena);
+/// `headless` leaves out the surface extensions, glfw doesn't have to be initialized then.
+VkInstance init_gpu_instance(Temp_Linear_Allocator arena, bool headless = false);
 void cleanup_gpu_instance();
 
-Device create_device(Temp_Linear_Allocator arena);
+/// Headless devices don't need present support or VK_KHR_swapchain, use them with `create_headless_surface`.
+/// Prefers a discrete gpu, takes the first capable one otherwise. `logical` is VK_NULL_HANDLE when no gpu is capable.
+Device create_device(Temp_Linear_Allocator arena, bool headless = false);
 void destroy_device(Device device);
 
 /// create surface for now.
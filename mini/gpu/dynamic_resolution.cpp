@@ -0,0 +1,66 @@
+#include "dynamic_resolution.hpp"
+#include "core/common.hpp"
+#include "imgui.h"
+#include <cmath>
+
+// timings are a few frames behind the scale they were measured at, small steps keep the controller from overshooting.
+static constexpr f32 DYNAMIC_RESOLUTION_GAIN      = 0.1f;
+static constexpr f32 DYNAMIC_RESOLUTION_SMOOTHING = 0.2f;
+// only scales up once there is this much headroom, it would flip between two sizes right at the budget otherwise.
+static constexpr f32 DYNAMIC_RESOLUTION_HEADROOM = 0.9f;
+// the first frames compile pipelines and fill caches, they say little about the steady state.
+static constexpr u32 DYNAMIC_RESOLUTION_WARMUP = 8;
+
+void create_dynamic_resolution(Dynamic_Resolution& resolution, f32 target_ms) {
+  resolution           = {};
+  resolution.enabled   = true;
+  resolution.target_ms = target_ms;
+  resolution.min_scale = 0.5f;
+  resolution.max_scale = 1.0f;
+  resolution.scale     = 1.0f;
+}
+
+void dynamic_resolution_update(Dynamic_Resolution& resolution, f64 gpu_ms) {
+  if (gpu_ms <= 0.0) return;
+  if (resolution.samples++ == 0) resolution.gpu_ms = (f32)gpu_ms;
+  resolution.gpu_ms += ((f32)gpu_ms - resolution.gpu_ms) * DYNAMIC_RESOLUTION_SMOOTHING;
+
+  if (!resolution.enabled) {
+    resolution.scale = resolution.max_scale;
+    return;
+  }
+  if (resolution.samples < DYNAMIC_RESOLUTION_WARMUP) return;
+
+  const f32 target  = resolution.target_ms;
+  const bool over   = resolution.gpu_ms > target;
+  const bool room   = resolution.gpu_ms < target * DYNAMIC_RESOLUTION_HEADROOM;
+  const f32 ideal   = resolution.scale * sqrtf(target / resolution.gpu_ms);
+  const f32 desired = clamp(ideal, resolution.min_scale, resolution.max_scale);
+  if (over || room) resolution.scale += (desired - resolution.scale) * DYNAMIC_RESOLUTION_GAIN;
+}
+
+VkExtent2D dynamic_resolution_extent(const Dynamic_Resolution& resolution, VkExtent2D max_extent) {
+  if (!resolution.enabled) return max_extent;
+  const f32 scale   = clamp(resolution.scale, resolution.min_scale, resolution.max_scale);
+  VkExtent2D extent = {};
+  extent.width      = clamp((u32)(max_extent.width * scale + 0.5f), 1u, max_extent.width);
+  extent.height     = clamp((u32)(max_extent.height * scale + 0.5f), 1u, max_extent.height);
+  return extent;
+}
+
+void dynamic_resolution_draw_imgui(Dynamic_Resolution& resolution, VkExtent2D max_extent, bool* open) {
+  if (!ImGui::Begin("resolution", open)) {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Checkbox("dynamic", &resolution.enabled);
+  ImGui::SliderFloat("gpu budget", &resolution.target_ms, 1.0f, 50.0f, "%.1f ms");
+  ImGui::SliderFloat("min scale", &resolution.min_scale, 0.25f, 1.0f, "%.2f");
+  resolution.min_scale = clamp(resolution.min_scale, 0.25f, resolution.max_scale);
+
+  const VkExtent2D extent = dynamic_resolution_extent(resolution, max_extent);
+  ImGui::Text("%ux%u of %ux%u", extent.width, extent.height, max_extent.width, max_extent.height);
+  ImGui::Text("gpu %.2f ms, scale %.2f", resolution.gpu_ms, resolution.scale);
+  ImGui::End();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "common.hpp"
+#include "defs.hpp"
+
+/// Scales the resolution the frame renders at so its gpu time stays within `target_ms`. The render target keeps the
+/// size of the surface, frames draw into its top left corner and the blit stretches that over the surface, so a new
+/// scale costs no allocation. The gpu time is assumed to follow the pixel count, the scale moves towards
+/// sqrt(target / measured) a bit every frame since the timings it sees are a few frames old.
+struct Dynamic_Resolution {
+  bool enabled;
+  f32 target_ms; // gpu time per frame to stay within.
+  f32 min_scale; // of each side, 0.5 renders a quarter of the pixels.
+  f32 max_scale;
+
+  f32 scale;
+  f32 gpu_ms; // smoothed, of the frames measured so far.
+  u32 samples;
+};
+
+void create_dynamic_resolution(Dynamic_Resolution& resolution, f32 target_ms);
+
+/// Call once per frame with the gpu time of the newest frame that was read back.
+void dynamic_resolution_update(Dynamic_Resolution& resolution, f64 gpu_ms);
+
+/// The part of `max_extent` to render at, full size when disabled.
+VkExtent2D dynamic_resolution_extent(const Dynamic_Resolution& resolution, VkExtent2D max_extent);
+
+void dynamic_resolution_draw_imgui(Dynamic_Resolution& resolution, VkExtent2D max_extent, bool* open);
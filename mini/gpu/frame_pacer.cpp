@@ -0,0 +1,149 @@
+#include "frame_pacer.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include "profile/profiler.hpp"
+#include <cassert>
+
+// a present that takes longer than this to show up won't (minimized, occluded, ...), the gpu being done with the
+// frame is all that can be known then.
+static constexpr u64 FRAME_PACER_PRESENT_TIMEOUT_NS = 100000000;
+
+void create_frame_pacer(const Device& device, Frame_Pacer& pacer) {
+  pacer                   = {};
+  pacer.max_queued_frames = 2;
+  pacer.use_present_wait  = device.present_wait;
+  if (device.present_wait) {
+    pacer.wait_for_present = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device.logical, "vkWaitForPresentKHR");
+    assert(pacer.wait_for_present);
+  }
+}
+
+static Frame_Pacer::Frame& frame_pacer_oldest(Frame_Pacer& pacer) {
+  assert(pacer.tracked_count > 0);
+  return pacer.tracked[pacer.tracked_head];
+}
+
+static void frame_pacer_retire_oldest(Frame_Pacer& pacer, u64 now) {
+  pacer.latency_ms    = (f32)os_ticks_to_ms(now - frame_pacer_oldest(pacer).begin_ticks);
+  pacer.tracked_head  = (pacer.tracked_head + 1) % Frame_Pacer::MAX_TRACKED;
+  pacer.tracked_count = pacer.tracked_count - 1;
+}
+
+// true once the frame is on screen, or done on the gpu when that's all that can be known. only polls unless `wait`.
+static bool frame_pacer_is_done(
+    const Device& device,
+    Frame_Pacer& pacer,
+    const Surface& surface,
+    Timeline_Semaphore& graphics,
+    Frame_Pacer::Frame& frame,
+    bool wait) {
+  if (frame.present_id) {
+    assert(pacer.wait_for_present);
+    const u64 timeout = wait ? FRAME_PACER_PRESENT_TIMEOUT_NS : 0;
+    VkResult result   = pacer.wait_for_present(device.logical, surface.swapchain, frame.present_id, timeout);
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) return true;
+    if (result == VK_TIMEOUT && !wait) return false;
+    // out of date or never showed up.
+    frame.present_id = 0;
+  }
+
+  if (!wait) return timeline_is_complete(device, graphics, frame.timeline_value);
+  timeline_wait(device, graphics, frame.timeline_value);
+  return true;
+}
+
+void frame_pacer_begin(const Device& device, Frame_Pacer& pacer, const Surface& surface, Timeline_Semaphore& graphics) {
+  PROFILE_FUNCTION();
+  assert(pacer.max_queued_frames < Frame_Pacer::MAX_TRACKED);
+  const u64 begin = os_now_ticks();
+
+  while (pacer.max_queued_frames && pacer.tracked_count >= pacer.max_queued_frames) {
+    frame_pacer_is_done(device, pacer, surface, graphics, frame_pacer_oldest(pacer), true);
+    frame_pacer_retire_oldest(pacer, os_now_ticks());
+  }
+
+  if (pacer.fps_limit > 0.0f) {
+    const u64 now = os_now_ticks();
+    if (pacer.deadline_ticks > now) os_wait_until(pacer.deadline_ticks);
+    // a late frame starts the interval over instead of rushing the next ones to catch up.
+    const u64 start      = pacer.deadline_ticks > now ? pacer.deadline_ticks : now;
+    pacer.deadline_ticks = start + os_ns_to_ticks(1000000000.0 / pacer.fps_limit);
+  }
+
+  // and whatever else got there in the meantime, for the latency.
+  const u64 now = os_now_ticks();
+  while (pacer.tracked_count) {
+    if (!frame_pacer_is_done(device, pacer, surface, graphics, frame_pacer_oldest(pacer), false)) break;
+    frame_pacer_retire_oldest(pacer, now);
+  }
+
+  pacer.begin_ticks = os_now_ticks();
+  pacer.wait_ms     = (f32)os_ticks_to_ms(pacer.begin_ticks - begin);
+}
+
+u64 frame_pacer_next_present_id(Frame_Pacer& pacer) {
+  if (!pacer.use_present_wait || !pacer.wait_for_present) return 0;
+  return ++pacer.present_id;
+}
+
+void frame_pacer_presented(Frame_Pacer& pacer, u64 present_id, u64 timeline_value) {
+  // only without a limit, the oldest frame's latency is lost.
+  if (pacer.tracked_count == Frame_Pacer::MAX_TRACKED) {
+    pacer.tracked_head  = (pacer.tracked_head + 1) % Frame_Pacer::MAX_TRACKED;
+    pacer.tracked_count = pacer.tracked_count - 1;
+  }
+
+  auto& frame          = pacer.tracked[(pacer.tracked_head + pacer.tracked_count) % Frame_Pacer::MAX_TRACKED];
+  frame.present_id     = present_id;
+  frame.timeline_value = timeline_value;
+  frame.begin_ticks    = pacer.begin_ticks;
+  pacer.tracked_count++;
+}
+
+void frame_pacer_swapchain_recreated(Frame_Pacer& pacer) {
+  for (u32 i = 0; i < pacer.tracked_count; ++i) {
+    pacer.tracked[(pacer.tracked_head + i) % Frame_Pacer::MAX_TRACKED].present_id = 0;
+  }
+  pacer.present_id = 0;
+}
+
+bool frame_pacer_draw_imgui(Frame_Pacer& pacer, Surface& surface, bool* open) {
+  if (!ImGui::Begin("frame pacing", open)) {
+    ImGui::End();
+    return false;
+  }
+
+  bool changed = false;
+  if (ImGui::BeginCombo("present mode", present_mode_name(surface.present_mode))) {
+    for (u32 i = 0; i < (u32)Present_Mode::count; ++i) {
+      const Present_Mode mode = (Present_Mode)i;
+      ImGui::BeginDisabled(!surface.present_mode_supported[i]);
+      if (ImGui::Selectable(present_mode_name(mode), surface.present_mode == mode) && surface.present_mode != mode) {
+        surface.present_mode = mode;
+        changed              = true;
+      }
+      ImGui::EndDisabled();
+    }
+    ImGui::EndCombo();
+  }
+
+  s32 max_queued_frames = (s32)pacer.max_queued_frames;
+  if (ImGui::SliderInt("max queued frames", &max_queued_frames, 0, Frame_Pacer::MAX_TRACKED - 1)) {
+    pacer.max_queued_frames = (u32)max_queued_frames;
+  }
+  ImGui::SliderFloat("fps limit", &pacer.fps_limit, 0.0f, 480.0f, pacer.fps_limit > 0.0f ? "%.0f" : "off");
+
+  ImGui::BeginDisabled(!pacer.wait_for_present);
+  ImGui::Checkbox("wait for presents", &pacer.use_present_wait);
+  ImGui::EndDisabled();
+  if (!pacer.wait_for_present) {
+    ImGui::SameLine();
+    ImGui::Text("(not supported, waits for the gpu)");
+  }
+
+  ImGui::Text("latency %.2f ms, held back %.2f ms", pacer.latency_ms, pacer.wait_ms);
+  ImGui::Text("%u frames on their way", pacer.tracked_count);
+  ImGui::End();
+  return changed;
+}
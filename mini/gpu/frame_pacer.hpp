@@ -0,0 +1,50 @@
+#pragma once
+#include "common.hpp"
+#include "device.hpp"
+#include "surface.hpp"
+#include "sync.hpp"
+
+/// Keeps the cpu from queueing frames far ahead of the display, the less is queued the sooner input shows up on
+/// screen. Before a frame samples its input the pacer waits until at most `max_queued_frames` earlier ones are still
+/// on their way: until they are on screen with VK_KHR_present_wait, until the gpu is done with them otherwise.
+/// `fps_limit` also paces the cpu on a fixed interval with a precise sleep, for when the display doesn't.
+struct Frame_Pacer {
+  static constexpr u32 MAX_TRACKED = 8; // presented frames that aren't known to be on screen yet.
+
+  u32 max_queued_frames; // 0 doesn't limit anything.
+  f32 fps_limit;         // 0 turns the cpu pacing off.
+  bool use_present_wait; // falls back to the gpu timeline when off or unsupported.
+
+  PFN_vkWaitForPresentKHR wait_for_present; // null without present wait.
+
+  struct Frame {
+    u64 present_id;     // 0 when presented without one.
+    u64 timeline_value; // of its graphics submission.
+    u64 begin_ticks;    // when it started sampling input.
+  } tracked[MAX_TRACKED]; // ring, oldest at `tracked_head`.
+  u32 tracked_head;
+  u32 tracked_count;
+
+  u64 present_id;     // last one handed out, they only have to grow within a swapchain.
+  u64 begin_ticks;    // of the frame being recorded.
+  u64 deadline_ticks; // earliest start of the next frame with `fps_limit`.
+
+  f32 wait_ms;    // spent in the last `frame_pacer_begin`.
+  f32 latency_ms; // of the newest frame that got there, polled once per frame so it's an upper bound.
+};
+
+void create_frame_pacer(const Device& device, Frame_Pacer& pacer);
+
+/// Call right before polling input, waits for the queued frames and the fps limit.
+void frame_pacer_begin(const Device& device, Frame_Pacer& pacer, const Surface& surface, Timeline_Semaphore& graphics);
+
+/// The id to present the frame with through VkPresentIdKHR, 0 when present ids aren't used.
+u64 frame_pacer_next_present_id(Frame_Pacer& pacer);
+/// Call after presenting, `timeline_value` is what the frame's graphics submission signals.
+void frame_pacer_presented(Frame_Pacer& pacer, u64 present_id, u64 timeline_value);
+
+/// Present ids belong to the swapchain, frames presented to the old one are only tracked on the gpu from now on.
+void frame_pacer_swapchain_recreated(Frame_Pacer& pacer);
+
+/// Returns true when the present mode was changed, the swapchain has to be recreated for it.
+bool frame_pacer_draw_imgui(Frame_Pacer& pacer, Surface& surface, bool* open);
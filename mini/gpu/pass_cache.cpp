@@ -0,0 +1,100 @@
+#include "pass_cache.hpp"
+#include "profile/profiler.hpp"
+#include <cassert>
+#include <cstring>
+
+void create_pass_cache(const Device& device, Pass_Cache& cache, Render_Pass_Fn prologue, void* prologue_data) {
+  memset(&cache, 0, sizeof(cache));
+  cache.device        = &device;
+  cache.prologue      = prologue;
+  cache.prologue_data = prologue_data;
+
+  const u32 families[(u32)Render_Queue::count] = { device.queue_family, device.compute_queue_family };
+  for (u32 i = 0; i < (u32)Render_Queue::count; ++i) {
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags                   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex        = families[i];
+    VK_CHECK(vkCreateCommandPool(device.logical, &pool_info, device.allocator_callbacks, &cache.pools[i]));
+  }
+}
+
+void destroy_pass_cache(Pass_Cache& cache) {
+  // the buffers go with their pools.
+  const Device& device = *cache.device;
+  for (VkCommandPool pool : cache.pools) vkDestroyCommandPool(device.logical, pool, device.allocator_callbacks);
+  cache = {};
+}
+
+void pass_cache_invalidate(Pass_Cache& cache) {
+  for (auto& entry : cache.entries) {
+    entry.key       = 0;
+    entry.last_used = 0;
+  }
+}
+
+static VkCommandBuffer pass_cache_get(
+    Pass_Cache& cache,
+    Render_Queue queue,
+    u64 key,
+    Render_Pass_Fn execute,
+    void* user_data) {
+  assert(key != 0 && "0 marks free entries");
+  cache.use_count++;
+
+  // free entries were never used or got invalidated, their `last_used` of 0 makes them the first to go.
+  Pass_Cache::Entry* oldest = &cache.entries[0];
+  for (auto& entry : cache.entries) {
+    if (entry.key == key && entry.queue == queue) {
+      entry.last_used = cache.use_count;
+      cache.reused++;
+      return entry.cmd;
+    }
+    if (entry.last_used < oldest->last_used) oldest = &entry;
+  }
+
+  PROFILE_SCOPE("record cached pass");
+  const Device& device     = *cache.device;
+  Pass_Cache::Entry& entry = *oldest;
+  if (entry.cmd != VK_NULL_HANDLE && entry.queue != queue) {
+    vkFreeCommandBuffers(device.logical, cache.pools[(u32)entry.queue], 1, &entry.cmd);
+    entry.cmd = VK_NULL_HANDLE;
+  }
+  if (entry.cmd == VK_NULL_HANDLE) {
+    VkCommandBufferAllocateInfo allocate_info = {};
+    allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.commandPool                 = cache.pools[(u32)queue];
+    allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocate_info.commandBufferCount          = 1;
+    VK_CHECK(vkAllocateCommandBuffers(device.logical, &allocate_info, &entry.cmd));
+  }
+  entry.key       = key;
+  entry.queue     = queue;
+  entry.last_used = cache.use_count;
+
+  // executed outside of any render pass, nothing to inherit. beginning resets what was recorded before.
+  VkCommandBufferInheritanceInfo inheritance_info = {};
+  inheritance_info.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.pInheritanceInfo         = &inheritance_info;
+  VK_CHECK(vkBeginCommandBuffer(entry.cmd, &begin_info));
+  if (cache.prologue) cache.prologue(entry.cmd, cache.prologue_data);
+  execute(entry.cmd, user_data);
+  VK_CHECK(vkEndCommandBuffer(entry.cmd));
+  cache.recorded++;
+  return entry.cmd;
+}
+
+void pass_cache_execute(
+    Pass_Cache& cache,
+    VkCommandBuffer cmd,
+    Render_Queue queue,
+    u64 key,
+    Render_Pass_Fn execute,
+    void* user_data) {
+  VkCommandBuffer secondary = pass_cache_get(cache, queue, key, execute, user_data);
+  vkCmdExecuteCommands(cmd, 1, &secondary);
+  if (cache.prologue) cache.prologue(cmd, cache.prologue_data);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "common.hpp"
+#include "defs.hpp"
+#include "device.hpp"
+#include "render_graph.hpp"
+
+/// Secondary command buffers holding passes that record the same commands every frame, see `render_graph_cache_pass`.
+/// Each buffer is recorded once for a set of inputs and executed until nothing asks for those inputs anymore, the
+/// least recently used one is recorded over then. There is one cache per frame slot: a buffer is only recorded again
+/// once the gpu is done with the slot's last frame, and never executed by two frames at once.
+struct Pass_Cache {
+  static constexpr u32 MAX_ENTRIES = 16; // swapchain images alone make a few variants of a pass.
+
+  const Device* device;
+  // secondaries have to come from the queue family of the primary executing them.
+  VkCommandPool pools[(u32)Render_Queue::count];
+
+  struct Entry {
+    u64 key; // the pass and its inputs, 0 when free.
+    u64 last_used;
+    Render_Queue queue;
+    VkCommandBuffer cmd; // allocated on first use.
+  } entries[MAX_ENTRIES];
+  u64 use_count;
+
+  // recorded at the start of every buffer, a secondary inherits no bound state from the primary, and into the primary
+  // after executing one.
+  Render_Pass_Fn prologue;
+  void* prologue_data;
+
+  u64 recorded;
+  u64 reused;
+};
+
+void create_pass_cache(const Device& device, Pass_Cache& cache, Render_Pass_Fn prologue, void* prologue_data);
+void destroy_pass_cache(Pass_Cache& cache);
+
+/// Forgets every recording, for when something they reference is destroyed: a new object can come back with the same
+/// handle and a hash over handles wouldn't notice. The buffers are only recorded again by the slot's next frame.
+void pass_cache_invalidate(Pass_Cache& cache);
+
+/// Executes the buffer recorded for `key` from `cmd`, which is submitted to `queue`. Records `execute` into a buffer
+/// first if there is none, so only call while the gpu is done with the slot's last frame. The prologue is recorded into
+/// `cmd` again afterwards, executing secondaries leaves whatever the primary had bound undefined.
+void pass_cache_execute(
+    Pass_Cache& cache,
+    VkCommandBuffer cmd,
+    Render_Queue queue,
+    u64 key,
+    Render_Pass_Fn execute,
+    void* user_data);
@@ -0,0 +1,162 @@
+#include "pipeline_cache.hpp"
+#include "common.hpp"
+#include "core/common.hpp"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+static void pipeline_cache_make_header(const Device& device, Pipeline_Cache_Header& header) {
+  VkPhysicalDeviceIDProperties id_properties = {};
+  id_properties.sType                        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext                       = &id_properties;
+  vkGetPhysicalDeviceProperties2(device.physical, &properties);
+
+  memset(&header, 0, sizeof(header));
+  header.magic          = Pipeline_Cache_Header::MAGIC;
+  header.version        = Pipeline_Cache_Header::VERSION;
+  header.vendor_id      = properties.properties.vendorID;
+  header.device_id      = properties.properties.deviceID;
+  header.driver_version = properties.properties.driverVersion;
+  memcpy(header.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+  memcpy(header.driver_uuid, id_properties.driverUUID, VK_UUID_SIZE);
+  memcpy(header.pipeline_cache_uuid, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+}
+
+// one file per device so that switching gpus does not throw the other one's cache away.
+static void pipeline_cache_path(const Pipeline_Cache_Header& header, char* path, u64 size) {
+  snprintf(path, size, "pipeline_cache_%04x_%04x.bin", header.vendor_id, header.device_id);
+}
+
+// returns the reason the blob can't be used, or nullptr when it is fine.
+static const char* pipeline_cache_validate(const Pipeline_Cache_Header& expected, const u8* file, u64 file_size) {
+  if (file_size < sizeof(Pipeline_Cache_Header)) return "truncated header";
+
+  Pipeline_Cache_Header header;
+  memcpy(&header, file, sizeof(header));
+  if (header.magic != expected.magic) return "bad magic";
+  if (header.version != expected.version) return "old header version";
+  if (header.vendor_id != expected.vendor_id || header.device_id != expected.device_id) return "different device";
+  if (header.driver_version != expected.driver_version) return "driver version changed";
+  if (memcmp(header.device_uuid, expected.device_uuid, VK_UUID_SIZE)) return "device uuid changed";
+  if (memcmp(header.driver_uuid, expected.driver_uuid, VK_UUID_SIZE)) return "driver uuid changed";
+  if (memcmp(header.pipeline_cache_uuid, expected.pipeline_cache_uuid, VK_UUID_SIZE)) return "cache uuid changed";
+  if (header.data_size != file_size - sizeof(header)) return "size mismatch";
+
+  const u8* data = file + sizeof(header);
+  if (hash_bytes(data, header.data_size) != header.data_hash) return "corrupted data";
+
+  // the driver will also check its own header, but some drivers have been known to crash instead of refusing.
+  VkPipelineCacheHeaderVersionOne driver_header;
+  if (header.data_size < sizeof(driver_header)) return "truncated driver header";
+  memcpy(&driver_header, data, sizeof(driver_header));
+  if (driver_header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return "unknown driver header";
+  if (driver_header.vendorID != expected.vendor_id || driver_header.deviceID != expected.device_id)
+    return "driver header device mismatch";
+  if (memcmp(driver_header.pipelineCacheUUID, expected.pipeline_cache_uuid, VK_UUID_SIZE))
+    return "driver header uuid mismatch";
+  return nullptr;
+}
+
+void load_pipeline_cache(Temp_Linear_Allocator arena, Device& device) {
+  Pipeline_Cache_Header expected;
+  pipeline_cache_make_header(device, expected);
+
+  char path[64];
+  pipeline_cache_path(expected, path, sizeof(path));
+
+  const u8* initial_data = nullptr;
+  u64 initial_size       = 0;
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, path, "rb");
+  if (fp) {
+    fseek(fp, 0L, SEEK_END);
+    u64 file_size = (u64)ftell(fp);
+    rewind(fp);
+    u8* file  = arena.push_array_no_init<u8>(file_size > 0 ? file_size : 1);
+    file_size = fread(file, 1, file_size, fp);
+    fclose(fp);
+
+    if (const char* reason = pipeline_cache_validate(expected, file, file_size)) {
+      log_warn("[pipeline cache] discarding %s: %s", path, reason);
+    } else {
+      initial_data = file + sizeof(Pipeline_Cache_Header);
+      initial_size = file_size - sizeof(Pipeline_Cache_Header);
+    }
+  }
+
+  VkPipelineCacheCreateInfo create_info = {};
+  create_info.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  create_info.initialDataSize           = (size_t)initial_size;
+  create_info.pInitialData              = initial_data;
+
+  VkResult result = vkCreatePipelineCache(
+      device.logical,
+      &create_info,
+      device.allocator_callbacks,
+      &device.pipeline_cache);
+  if (result != VK_SUCCESS && initial_size > 0) {
+    log_warn("[pipeline cache] driver refused %s, starting cold", path);
+    create_info.initialDataSize = 0;
+    create_info.pInitialData    = nullptr;
+    result = vkCreatePipelineCache(device.logical, &create_info, device.allocator_callbacks, &device.pipeline_cache);
+  }
+  VK_CHECK(result);
+
+  if (initial_size > 0) {
+    log_info("[pipeline cache] warm, loaded %llu bytes from %s", (unsigned long long)initial_size, path);
+  } else {
+    log_info("[pipeline cache] cold");
+  }
+}
+
+void save_pipeline_cache(const Device& device) {
+  if (device.pipeline_cache == VK_NULL_HANDLE) return;
+
+  size_t data_size = 0;
+  VK_CHECK(vkGetPipelineCacheData(device.logical, device.pipeline_cache, &data_size, nullptr));
+  if (data_size == 0) return;
+
+  Allocator allocator;
+  auto allocation = allocator.allocate_no_zero(sizeof(Pipeline_Cache_Header) + data_size, 8);
+  assert(allocation.info == Allocation_Err::none);
+  auto file = (u8*)allocation.memory;
+  defer { allocator.free(file); };
+
+  u8* data = file + sizeof(Pipeline_Cache_Header);
+  VK_CHECK(vkGetPipelineCacheData(device.logical, device.pipeline_cache, &data_size, data));
+
+  Pipeline_Cache_Header header;
+  pipeline_cache_make_header(device, header);
+  header.data_size = data_size;
+  header.data_hash = hash_bytes(data, data_size);
+  memcpy(file, &header, sizeof(header));
+
+  char path[64];
+  char temp_path[72];
+  pipeline_cache_path(header, path, sizeof(path));
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, temp_path, "wb");
+  if (!fp) {
+    log_error("[pipeline cache] unable to open %s for writing", temp_path);
+    return;
+  }
+  const u64 file_size = sizeof(header) + data_size;
+  const bool written  = fwrite(file, 1, file_size, fp) == file_size;
+  const bool flushed  = fflush(fp) == 0;
+  fclose(fp);
+
+  if (!written || !flushed || !os_replace_file(temp_path, path)) {
+    log_error("[pipeline cache] failed to write %s", path);
+    remove(temp_path);
+    return;
+  }
+  log_info("[pipeline cache] saved %llu bytes to %s", (unsigned long long)data_size, path);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "core/memory.hpp"
+#include "device.hpp"
+
+/// Our own header in front of the driver blob. The driver header only carries vendor/device ids and the cache uuid,
+/// so a driver update that keeps the same uuid would still hand us a blob it may not like.
+struct Pipeline_Cache_Header {
+  static constexpr u32 MAGIC   = 0x4850434d; // "MCPH"
+  static constexpr u32 VERSION = 1;
+
+  u32 magic;
+  u32 version;
+  u32 vendor_id;
+  u32 device_id;
+  u32 driver_version;
+  u8 device_uuid[VK_UUID_SIZE];
+  u8 driver_uuid[VK_UUID_SIZE];
+  u8 pipeline_cache_uuid[VK_UUID_SIZE];
+  u64 data_size;
+  u64 data_hash;
+};
+
+/// Creates `device.pipeline_cache`, seeded from disk when the blob was written by this exact device and driver.
+void load_pipeline_cache(Temp_Linear_Allocator arena, Device& device);
+
+/// Writes the cache back through a temporary file, a crash halfway never leaves a torn blob behind.
+void save_pipeline_cache(const Device& device);
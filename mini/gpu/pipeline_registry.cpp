@@ -0,0 +1,278 @@
+#include "pipeline_registry.hpp"
+#include "core/common.hpp"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include "profile/profiler.hpp"
+#include "profile/sampling_profiler.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+static u64 pipeline_desc_hash(const Compute_Pipeline_Desc& desc) {
+  u64 hash = hash_bytes(desc.shader_path, strlen(desc.shader_path));
+  hash     = hash_bytes(desc.defines, strlen(desc.defines), hash);
+  hash     = hash_bytes(desc.entry, strlen(desc.entry), hash);
+  hash     = hash_bytes(&desc.layout, sizeof(desc.layout), hash);
+  hash     = hash_bytes(&desc.specialization.count, sizeof(u32), hash);
+  hash     = hash_bytes(desc.specialization.ids, sizeof(u32) * desc.specialization.count, hash);
+  hash     = hash_bytes(desc.specialization.values, sizeof(u32) * desc.specialization.count, hash);
+  return hash;
+}
+
+static bool pipeline_desc_equal(const Pipeline_Entry& entry, const Compute_Pipeline_Desc& desc) {
+  const Specialization_Desc& a = entry.specialization;
+  const Specialization_Desc& b = desc.specialization;
+  if (entry.layout != desc.layout || strcmp(entry.shader_path, desc.shader_path) || strcmp(entry.entry, desc.entry))
+    return false;
+  if (strcmp(entry.defines, desc.defines)) return false;
+  return a.count == b.count && !memcmp(a.ids, b.ids, sizeof(u32) * a.count) &&
+      !memcmp(a.values, b.values, sizeof(u32) * a.count);
+}
+
+// runs on a worker, only touches its own entry, the device and the thread safe shader compiler.
+static void pipeline_compile(const Device& device, Shader_Compiler* shaders, Pipeline_Entry& entry) {
+  PROFILE_SCOPE("compile pipeline");
+  const u64 begin = os_now_ticks();
+
+  Shader_Code code = {};
+  if (!shader_load(shaders, entry.shader_path, entry.defines, code)) {
+    entry.state.store(Pipeline_State::failed, std::memory_order_release);
+    return;
+  }
+  defer { shader_code_free(code); };
+
+  VkShaderModuleCreateInfo module_info = {};
+  module_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  module_info.codeSize                 = code.size;
+  module_info.pCode                    = code.words;
+
+  // a failure only loses this pipeline, `pipeline_registry_get` keeps handing out its fallback.
+  VkShaderModule module = VK_NULL_HANDLE;
+  VkResult result       = vkCreateShaderModule(device.logical, &module_info, device.allocator_callbacks, &module);
+  if (result != VK_SUCCESS) {
+    log_error("[pipelines] failed to create the module of %s (%d)", entry.shader_path, (s32)result);
+    entry.compile_ms = (f32)os_ticks_to_ms(os_now_ticks() - begin);
+    entry.state.store(Pipeline_State::failed, std::memory_order_release);
+    return;
+  }
+  defer { vkDestroyShaderModule(device.logical, module, device.allocator_callbacks); };
+
+  VkSpecializationMapEntry map_entries[Specialization_Desc::MAX_CONSTANTS];
+  for (u32 i = 0; i < entry.specialization.count; ++i) {
+    map_entries[i].constantID = entry.specialization.ids[i];
+    map_entries[i].offset     = i * sizeof(u32);
+    map_entries[i].size       = sizeof(u32);
+  }
+
+  VkSpecializationInfo specialization_info = {};
+  specialization_info.mapEntryCount        = entry.specialization.count;
+  specialization_info.pMapEntries          = map_entries;
+  specialization_info.dataSize             = entry.specialization.count * sizeof(u32);
+  specialization_info.pData                = entry.specialization.values;
+
+  VkPipelineShaderStageCreateInfo stage_info = {};
+  stage_info.sType                           = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stage_info.stage                           = VK_SHADER_STAGE_COMPUTE_BIT;
+  stage_info.module                          = module;
+  stage_info.pName                           = entry.entry;
+  stage_info.pSpecializationInfo             = entry.specialization.count ? &specialization_info : nullptr;
+
+  VkComputePipelineCreateInfo create_info = {};
+  create_info.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  create_info.layout                      = entry.layout;
+  create_info.stage                       = stage_info;
+
+  // the pipeline cache is internally synchronized, workers can share it.
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  result              = vkCreateComputePipelines(
+      device.logical,
+      device.pipeline_cache,
+      1,
+      &create_info,
+      device.allocator_callbacks,
+      &pipeline);
+
+  entry.compile_ms = (f32)os_ticks_to_ms(os_now_ticks() - begin);
+  if (result != VK_SUCCESS) {
+    log_error("[pipelines] failed to create %s (%d)", entry.shader_path, (s32)result);
+    entry.state.store(Pipeline_State::failed, std::memory_order_release);
+    return;
+  }
+  entry.pipeline = pipeline;
+  entry.state.store(Pipeline_State::ready, std::memory_order_release);
+}
+
+static void pipeline_worker(Pipeline_Registry* registry, u32 worker_idx) {
+  char name[32];
+  snprintf(name, sizeof(name), "pipeline worker %u", worker_idx);
+  profiler_set_thread_name(name);
+  sampling_profiler_register_thread(name);
+
+  std::unique_lock<std::mutex> lock(registry->mutex);
+  for (;;) {
+    registry->job_available.wait(lock, [&] { return registry->quit || registry->queue_head != registry->queue_tail; });
+    if (registry->quit) return;
+
+    Pipeline_Entry& entry = registry->entries[registry->queue[registry->queue_head++]];
+    registry->in_flight++;
+    lock.unlock();
+    pipeline_compile(*registry->device, registry->shaders, entry);
+    lock.lock();
+    registry->in_flight--;
+
+    if (registry->in_flight == 0 && registry->queue_head == registry->queue_tail) {
+      log_info(
+          "[pipelines] batch done in %.3fms on %u workers",
+          os_ticks_to_ms(os_now_ticks() - registry->batch_begin),
+          registry->worker_count);
+    }
+    registry->job_done.notify_all();
+  }
+}
+
+void create_pipeline_registry(
+    Pipeline_Registry& registry,
+    const Device& device,
+    Shader_Compiler* shaders,
+    u32 worker_count) {
+  registry.device     = &device;
+  registry.shaders    = shaders;
+  registry.count      = 0;
+  registry.queue_head = 0;
+  registry.queue_tail = 0;
+  registry.in_flight  = 0;
+  registry.quit       = false;
+
+  if (worker_count == 0) {
+    u32 cores    = std::thread::hardware_concurrency();
+    worker_count = cores > 1 ? cores - 1 : 1;
+  }
+  registry.worker_count = clamp(worker_count, 1u, Pipeline_Registry::MAX_WORKERS);
+  for (u32 i = 0; i < registry.worker_count; ++i) registry.workers[i] = std::thread(pipeline_worker, &registry, i);
+}
+
+void destroy_pipeline_registry(Pipeline_Registry& registry) {
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.quit = true;
+  }
+  registry.job_available.notify_all();
+  for (u32 i = 0; i < registry.worker_count; ++i) registry.workers[i].join();
+
+  // anything still queued never started, everything else finished before the workers returned.
+  for (u32 i = 0; i < registry.count; ++i) {
+    Pipeline_Entry& entry = registry.entries[i];
+    if (entry.state.load() == Pipeline_State::ready)
+      vkDestroyPipeline(registry.device->logical, entry.pipeline, registry.device->allocator_callbacks);
+  }
+  registry.count = 0;
+}
+
+Pipeline_Handle pipeline_registry_add(
+    Pipeline_Registry& registry,
+    const Compute_Pipeline_Desc& desc_in,
+    Pipeline_Handle fallback) {
+  assert(desc_in.shader_path && desc_in.entry);
+  assert(desc_in.specialization.count <= Specialization_Desc::MAX_CONSTANTS);
+  assert(strlen(desc_in.shader_path) < sizeof(Pipeline_Entry::shader_path));
+  assert(desc_in.defines && strlen(desc_in.defines) < sizeof(Pipeline_Entry::defines));
+  assert((!*desc_in.defines || shader_is_glsl(desc_in.shader_path)) && "spir-v has no defines to set");
+  assert(strlen(desc_in.entry) < sizeof(Pipeline_Entry::entry));
+  assert((fallback.idx == (u32)-1 || fallback.idx < registry.count) && "fallbacks have to be added first");
+
+  // the local size is just two more constants, so it takes part in hashing and comparing like the others.
+  Compute_Pipeline_Desc desc = desc_in;
+  if (desc.local_size.x) {
+    Specialization_Desc& specialization = desc.specialization;
+    assert(desc.local_size.y && specialization.count + 2 <= Specialization_Desc::MAX_CONSTANTS);
+    for (u32 i = 0; i < specialization.count; ++i)
+      assert(specialization.ids[i] > 1 && "ids 0 and 1 are the local size");
+    specialization.ids[specialization.count]        = 0;
+    specialization.values[specialization.count]     = desc.local_size.x;
+    specialization.ids[specialization.count + 1]    = 1;
+    specialization.values[specialization.count + 1] = desc.local_size.y;
+    specialization.count += 2;
+  } else {
+    desc.local_size = { 1, 1 };
+  }
+
+  const u64 hash = pipeline_desc_hash(desc);
+  for (u32 i = 0; i < registry.count; ++i) {
+    if (registry.entries[i].hash == hash && pipeline_desc_equal(registry.entries[i], desc)) return Pipeline_Handle{ i };
+  }
+
+  assert(registry.count < Pipeline_Registry::MAX_PIPELINES);
+  Pipeline_Entry& entry = registry.entries[registry.count];
+  snprintf(entry.shader_path, sizeof(entry.shader_path), "%s", desc.shader_path);
+  snprintf(entry.defines, sizeof(entry.defines), "%s", desc.defines);
+  snprintf(entry.entry, sizeof(entry.entry), "%s", desc.entry);
+  entry.layout         = desc.layout;
+  entry.specialization = desc.specialization;
+  entry.local_size     = desc.local_size;
+  entry.hash           = hash;
+  entry.fallback       = fallback;
+  entry.pipeline       = VK_NULL_HANDLE;
+  entry.compile_ms     = 0.0f;
+  entry.state.store(Pipeline_State::pending, std::memory_order_relaxed);
+  return Pipeline_Handle{ registry.count++ };
+}
+
+void pipeline_registry_compile(Pipeline_Registry& registry) {
+  u32 queued = 0;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.in_flight == 0 && registry.queue_head == registry.queue_tail) registry.batch_begin = os_now_ticks();
+    for (u32 i = 0; i < registry.count; ++i) {
+      Pipeline_Entry& entry = registry.entries[i];
+      if (entry.state.load(std::memory_order_relaxed) != Pipeline_State::pending) continue;
+      entry.state.store(Pipeline_State::queued, std::memory_order_relaxed);
+      registry.queue[registry.queue_tail++] = i;
+      queued++;
+    }
+  }
+  if (queued) registry.job_available.notify_all();
+}
+
+static bool pipeline_is_done(const Pipeline_Entry& entry) {
+  Pipeline_State state = entry.state.load(std::memory_order_acquire);
+  return state == Pipeline_State::ready || state == Pipeline_State::failed;
+}
+
+void pipeline_registry_wait(Pipeline_Registry& registry, Pipeline_Handle handle) {
+  assert(handle.idx < registry.count);
+  Pipeline_Entry& entry = registry.entries[handle.idx];
+  assert(entry.state.load() != Pipeline_State::pending && "call pipeline_registry_compile first");
+
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  registry.job_done.wait(lock, [&] { return pipeline_is_done(entry); });
+}
+
+void pipeline_registry_wait_all(Pipeline_Registry& registry) {
+  std::unique_lock<std::mutex> lock(registry.mutex);
+  registry.job_done.wait(lock, [&] { return registry.in_flight == 0 && registry.queue_head == registry.queue_tail; });
+}
+
+bool pipeline_registry_is_ready(const Pipeline_Registry& registry, Pipeline_Handle handle) {
+  if (handle.idx >= registry.count) return false;
+  return registry.entries[handle.idx].state.load(std::memory_order_acquire) == Pipeline_State::ready;
+}
+
+Pipeline_Handle pipeline_registry_resolve(const Pipeline_Registry& registry, Pipeline_Handle handle) {
+  // fallbacks are always added before the pipelines that use them, so this can't loop.
+  while (handle.idx < registry.count) {
+    const Pipeline_Entry& entry = registry.entries[handle.idx];
+    if (entry.state.load(std::memory_order_acquire) == Pipeline_State::ready) return handle;
+    handle = entry.fallback;
+  }
+  return {};
+}
+
+VkPipeline pipeline_registry_get(const Pipeline_Registry& registry, Pipeline_Handle handle) {
+  handle = pipeline_registry_resolve(registry, handle);
+  return handle.idx < registry.count ? registry.entries[handle.idx].pipeline : VK_NULL_HANDLE;
+}
+
+Workgroup_Size pipeline_registry_local_size(const Pipeline_Registry& registry, Pipeline_Handle handle) {
+  assert(handle.idx < registry.count);
+  return registry.entries[handle.idx].local_size;
+}
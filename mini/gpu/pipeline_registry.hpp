@@ -0,0 +1,120 @@
+#pragma once
+#include "common.hpp"
+#include "core/memory.hpp"
+#include "device.hpp"
+#include "shader_compiler.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// Every constant is 32 bits wide (int, uint, float or bool32), which covers everything our kernels use.
+struct Specialization_Desc {
+  static constexpr u32 MAX_CONSTANTS = 8;
+
+  u32 count;
+  u32 ids[MAX_CONSTANTS];
+  u32 values[MAX_CONSTANTS];
+};
+
+/// Local size of a 2d kernel, kernels declare it with `local_size_x_id = 0, local_size_y_id = 1`.
+struct Workgroup_Size {
+  u32 x;
+  u32 y;
+};
+
+struct Compute_Pipeline_Desc {
+  const char* shader_path; // spir-v, or glsl that the registry's shader compiler builds.
+  const char* defines = ""; // glsl only, `;` separated NAME or NAME=value.
+  const char* entry   = "main";
+  VkPipelineLayout layout;
+  Specialization_Desc specialization = {};
+  Workgroup_Size local_size          = {}; // set as constants 0 and 1 when not 0, keep them out of `specialization`.
+};
+
+struct Pipeline_Handle {
+  u32 idx = (u32)-1;
+};
+
+enum struct Pipeline_State : u32 { pending, queued, ready, failed };
+
+struct Pipeline_Entry {
+  // copied from the description, so callers can build descriptions from temporary strings.
+  char shader_path[128];
+  char defines[128];
+  char entry[32];
+  VkPipelineLayout layout;
+  Specialization_Desc specialization; // with the local size appended.
+  Workgroup_Size local_size;          // {1, 1} without one in the description, shaders aren't parsed for theirs.
+  u64 hash;
+
+  Pipeline_Handle fallback;
+  VkPipeline pipeline;
+  f32 compile_ms;
+  std::atomic<Pipeline_State> state;
+};
+
+/// Pipelines are described up front and compiled together on worker threads, identical descriptions share one
+/// pipeline. Handles can be used right away, `pipeline_registry_get` returns the fallback (or nothing) until the
+/// real pipeline is ready.
+struct Pipeline_Registry {
+  static constexpr u32 MAX_PIPELINES = 128;
+  static constexpr u32 MAX_WORKERS   = 16;
+
+  const Device* device;
+  Shader_Compiler* shaders; // null when only spir-v is loaded.
+  Pipeline_Entry entries[MAX_PIPELINES];
+  u32 count;
+
+  std::thread workers[MAX_WORKERS];
+  u32 worker_count;
+
+  // jobs are entry indices, `queue_tail` only moves forward since entries never get compiled twice.
+  std::mutex mutex;
+  std::condition_variable job_available;
+  std::condition_variable job_done;
+  u32 queue[MAX_PIPELINES];
+  u32 queue_head;
+  u32 queue_tail;
+  u32 in_flight;
+  bool quit;
+
+  u64 batch_begin;
+};
+
+/// Workers are started here, they compile glsl through `shaders` as well. `worker_count` 0 uses all cores but the
+/// calling one.
+void create_pipeline_registry(
+    Pipeline_Registry& registry,
+    const Device& device,
+    Shader_Compiler* shaders = nullptr,
+    u32 worker_count         = 0);
+void destroy_pipeline_registry(Pipeline_Registry& registry);
+
+/// Returns the existing handle when an identical description was already added.
+Pipeline_Handle pipeline_registry_add(
+    Pipeline_Registry& registry,
+    const Compute_Pipeline_Desc& desc,
+    Pipeline_Handle fallback = {});
+
+/// Hands every pending pipeline to the workers, never blocks.
+void pipeline_registry_compile(Pipeline_Registry& registry);
+
+void pipeline_registry_wait(Pipeline_Registry& registry, Pipeline_Handle handle);
+void pipeline_registry_wait_all(Pipeline_Registry& registry);
+
+bool pipeline_registry_is_ready(const Pipeline_Registry& registry, Pipeline_Handle handle);
+
+/// The pipeline if it is ready, its fallback chain otherwise, VK_NULL_HANDLE when nothing is usable yet.
+VkPipeline pipeline_registry_get(const Pipeline_Registry& registry, Pipeline_Handle handle);
+/// The handle `pipeline_registry_get` draws with, an invalid one when nothing is usable yet.
+Pipeline_Handle pipeline_registry_resolve(const Pipeline_Registry& registry, Pipeline_Handle handle);
+
+/// What the pipeline was created with, dispatches have to be sized by the pipeline `pipeline_registry_resolve`
+/// returns since a fallback may use a different one.
+Workgroup_Size pipeline_registry_local_size(const Pipeline_Registry& registry, Pipeline_Handle handle);
+
+/// Workgroups to cover `size` texels along one axis.
+inline u32 workgroup_count(u32 size, u32 local_size) {
+  return (size + local_size - 1) / local_size;
+}
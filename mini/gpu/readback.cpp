@@ -0,0 +1,542 @@
+#include "readback.hpp"
+#include "core/common.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include "profile/profiler.hpp"
+#include "profile/sampling_profiler.hpp"
+#include <cassert>
+#include <cstring>
+
+const char* readback_encoding_name(Readback_Encoding encoding) {
+  switch (encoding) {
+    case Readback_Encoding::raw: return "raw";
+    case Readback_Encoding::ppm: return "ppm";
+    case Readback_Encoding::png: return "png";
+    case Readback_Encoding::count: break;
+  }
+  return "UNKNOWN_READBACK_ENCODING";
+}
+
+static const char* readback_state_name(Readback_State state) {
+  switch (state) {
+    case Readback_State::free: return "free";
+    case Readback_State::recorded: return "recorded";
+    case Readback_State::in_flight: return "in flight";
+    case Readback_State::encoding: return "encoding";
+  }
+  return "UNKNOWN_READBACK_STATE";
+}
+
+// 0 for formats the encoders don't know.
+static u32 readback_texel_size(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB: return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT: return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT: return 16;
+    default: return 0;
+  }
+}
+
+bool readback_supports_format(VkFormat format) { return readback_texel_size(format) != 0; }
+
+static f32 half_to_float(u16 half) {
+  const u32 sign     = (u32)(half & 0x8000) << 16;
+  const u32 exponent = (half >> 10) & 0x1f;
+  const u32 mantissa = half & 0x3ff;
+
+  u32 bits = 0;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa != 0) {
+    // subnormal, normalize it.
+    u32 e = 113;
+    u32 m = mantissa;
+    while (!(m & 0x400)) {
+      m <<= 1;
+      e--;
+    }
+    bits = sign | (e << 23) | ((m & 0x3ff) << 13);
+  } else {
+    bits = sign;
+  }
+
+  f32 result;
+  memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+static u8 unorm8(f32 value) {
+  // also catches nan.
+  if (!(value > 0.0f)) return 0;
+  if (value >= 1.0f) return 255;
+  return (u8)(value * 255.0f + 0.5f);
+}
+
+// one row to rgba8, floats are clamped the same way a blit to a unorm swapchain would.
+static void readback_row_to_rgba8(const Readback_Image& image, u32 y, u8* rgba) {
+  const u32 texel_size = readback_texel_size(image.format);
+  const u8* row        = image.pixels + (VkDeviceSize)y * image.width * texel_size;
+  for (u32 x = 0; x < image.width; ++x) {
+    const u8* texel = row + x * texel_size;
+    u8* out         = rgba + x * 4;
+    switch (image.format) {
+      case VK_FORMAT_B8G8R8A8_UNORM:
+      case VK_FORMAT_B8G8R8A8_SRGB:
+        out[0] = texel[2];
+        out[1] = texel[1];
+        out[2] = texel[0];
+        out[3] = texel[3];
+        break;
+      case VK_FORMAT_R16G16B16A16_SFLOAT:
+        for (u32 c = 0; c < 4; ++c) {
+          u16 half;
+          memcpy(&half, texel + c * 2, sizeof(half));
+          out[c] = unorm8(half_to_float(half));
+        }
+        break;
+      case VK_FORMAT_R32G32B32A32_SFLOAT:
+        for (u32 c = 0; c < 4; ++c) {
+          f32 value;
+          memcpy(&value, texel + c * 4, sizeof(value));
+          out[c] = unorm8(value);
+        }
+        break;
+      default: memcpy(out, texel, 4); break;
+    }
+  }
+}
+
+static bool write_raw(FILE* fp, const Readback_Image& image, VkDeviceSize size) {
+  return fwrite(image.pixels, 1, size, fp) == size;
+}
+
+static bool write_ppm(FILE* fp, const Readback_Image& image, u8* rgba) {
+  fprintf(fp, "P6\n%u %u\n255\n", image.width, image.height);
+  for (u32 y = 0; y < image.height; ++y) {
+    readback_row_to_rgba8(image, y, rgba);
+    // rgba to rgb in place, every texel only moves towards the front.
+    for (u32 x = 0; x < image.width; ++x) memmove(rgba + x * 3, rgba + x * 4, 3);
+    if (fwrite(rgba, 1, image.width * 3, fp) != image.width * 3) return false;
+  }
+  return true;
+}
+
+struct Png_Writer {
+  FILE* fp;
+  u32 crc;
+  bool ok;
+};
+
+static u32 crc32_update(u32 crc, const u8* data, u64 size) {
+  struct Crc_Table {
+    u32 values[256];
+  };
+  static const Crc_Table table = [] {
+    Crc_Table result;
+    for (u32 i = 0; i < 256; ++i) {
+      u32 c = i;
+      for (u32 k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      result.values[i] = c;
+    }
+    return result;
+  }();
+
+  crc = ~crc;
+  for (u64 i = 0; i < size; ++i) crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void png_put(Png_Writer& writer, const void* data, u64 size) {
+  writer.crc = crc32_update(writer.crc, (const u8*)data, size);
+  writer.ok  = writer.ok && fwrite(data, 1, size, writer.fp) == size;
+}
+
+static void png_put_u32(Png_Writer& writer, u32 value) {
+  const u8 bytes[4] = { (u8)(value >> 24), (u8)(value >> 16), (u8)(value >> 8), (u8)value };
+  png_put(writer, bytes, sizeof(bytes));
+}
+
+static void png_begin_chunk(Png_Writer& writer, const char* type, u32 size) {
+  png_put_u32(writer, size);
+  writer.crc = 0;
+  png_put(writer, type, 4);
+}
+
+static void png_end_chunk(Png_Writer& writer) { png_put_u32(writer, writer.crc); }
+
+// scanlines without filtering in stored deflate blocks, a few bytes bigger than the pixels but nearly free to write.
+static bool write_png(FILE* fp, const Readback_Image& image, u8* rgba) {
+  constexpr u32 MAX_BLOCK = 65535;
+
+  const u64 row_size   = 1 + (u64)image.width * 4;
+  const u64 data_size  = row_size * image.height;
+  const u64 blocks     = (data_size + MAX_BLOCK - 1) / MAX_BLOCK;
+  const u64 zlib_size  = 2 + blocks * 5 + data_size + 4;
+  const u8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  if (zlib_size > 0x7fffffff) return false;
+
+  Png_Writer writer = { fp, 0, true };
+  png_put(writer, signature, sizeof(signature));
+
+  // 8 bits per channel, rgba, no interlacing.
+  const u8 header_tail[5] = { 8, 6, 0, 0, 0 };
+  png_begin_chunk(writer, "IHDR", 13);
+  png_put_u32(writer, image.width);
+  png_put_u32(writer, image.height);
+  png_put(writer, header_tail, sizeof(header_tail));
+  png_end_chunk(writer);
+
+  png_begin_chunk(writer, "IDAT", (u32)zlib_size);
+  const u8 zlib_header[2] = { 0x78, 0x01 };
+  png_put(writer, zlib_header, sizeof(zlib_header));
+
+  // rows are streamed through the blocks, a block can end anywhere in a row.
+  u32 adler_a = 1, adler_b = 0;
+  u64 remaining_in_block = 0;
+  u64 written            = 0;
+  for (u32 y = 0; y < image.height; ++y) {
+    rgba[0] = 0; // filter type none.
+    readback_row_to_rgba8(image, y, rgba + 1);
+
+    u64 row_offset = 0;
+    while (row_offset < row_size) {
+      if (remaining_in_block == 0) {
+        const u64 block_size = data_size - written < MAX_BLOCK ? data_size - written : MAX_BLOCK;
+        const u16 length     = (u16)block_size;
+        const u8 last        = written + block_size == data_size;
+        // final flag, then the length and its complement, little endian.
+        const u8 block_header[5] = { last, (u8)length, (u8)(length >> 8), (u8)~length, (u8)(~length >> 8) };
+        png_put(writer, block_header, sizeof(block_header));
+        remaining_in_block = block_size;
+      }
+      u64 size = row_size - row_offset;
+      if (size > remaining_in_block) size = remaining_in_block;
+      png_put(writer, rgba + row_offset, size);
+
+      for (u64 i = 0; i < size; ++i) {
+        adler_a = (adler_a + rgba[row_offset + i]) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+      }
+      row_offset += size;
+      remaining_in_block -= size;
+      written += size;
+    }
+  }
+  png_put_u32(writer, (adler_b << 16) | adler_a);
+  png_end_chunk(writer);
+
+  png_begin_chunk(writer, "IEND", 0);
+  png_end_chunk(writer);
+  return writer.ok;
+}
+
+// runs on the worker, only touches its own slot.
+static bool readback_deliver(Readback_Manager::Slot& slot) {
+  PROFILE_SCOPE("readback deliver");
+  if (slot.callback) {
+    slot.callback(slot.image, slot.user_data);
+    return true;
+  }
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, slot.path, "wb");
+  if (!fp) {
+    log_error("[readback] unable to open %s for writing", slot.path);
+    return false;
+  }
+  defer { fclose(fp); };
+
+  // one converted row, with room for the png filter byte.
+  Allocator allocator;
+  auto allocation = allocator.allocate_no_zero(1 + (u64)slot.image.width * 4, 4);
+  assert(allocation.info == Allocation_Err::none);
+  auto row = (u8*)allocation.memory;
+  defer { allocator.free(row); };
+
+  bool written = false;
+  switch (slot.encoding) {
+    case Readback_Encoding::raw: written = write_raw(fp, slot.image, slot.size); break;
+    case Readback_Encoding::ppm: written = write_ppm(fp, slot.image, row); break;
+    case Readback_Encoding::png: written = write_png(fp, slot.image, row); break;
+    case Readback_Encoding::count: break;
+  }
+  if (!written) {
+    log_error("[readback] writing %s failed", slot.path);
+    return false;
+  }
+
+  // lets golden image tests compare runs without keeping images around.
+  log_info(
+      "[readback] frame %llu to %s, %ux%u hash %016llx",
+      (unsigned long long)slot.image.frame,
+      slot.path,
+      slot.image.width,
+      slot.image.height,
+      (unsigned long long)hash_bytes(slot.image.pixels, slot.size));
+  return true;
+}
+
+static void readback_worker(Readback_Manager* readbacks) {
+  profiler_set_thread_name("readback worker");
+  sampling_profiler_register_thread("readback worker");
+
+  std::unique_lock<std::mutex> lock(readbacks->mutex);
+  for (;;) {
+    readbacks->job_available.wait(lock, [&] {
+      return readbacks->quit || readbacks->queue_head != readbacks->queue_tail;
+    });
+    // whatever was handed over still finishes when quitting.
+    if (readbacks->queue_head == readbacks->queue_tail) return;
+
+    auto& slot      = readbacks->slots[readbacks->queue[readbacks->queue_head++ % Readback_Manager::MAX_SLOTS]];
+    readbacks->busy = true;
+    lock.unlock();
+    const u64 begin = os_now_ticks();
+    const bool ok   = readback_deliver(slot);
+    const f64 ms    = os_ticks_to_ms(os_now_ticks() - begin);
+    lock.lock();
+
+    readbacks->stats.encode_ms = ms;
+    if (ok) {
+      readbacks->stats.completed++;
+    } else {
+      readbacks->stats.failed++;
+    }
+    readbacks->busy = false;
+    slot.state.store(Readback_State::free, std::memory_order_release);
+    readbacks->job_done.notify_all();
+  }
+}
+
+void create_readback_manager(Readback_Manager& readbacks) {
+  for (u32 i = 0; i < Readback_Manager::MAX_SLOTS; ++i) {
+    auto& slot      = readbacks.slots[i];
+    slot.buffer     = VK_NULL_HANDLE;
+    slot.allocation = VK_NULL_HANDLE;
+    slot.data       = nullptr;
+    slot.capacity   = 0;
+    slot.state.store(Readback_State::free, std::memory_order_relaxed);
+  }
+  readbacks.queue_head = 0;
+  readbacks.queue_tail = 0;
+  readbacks.busy       = false;
+  readbacks.quit       = false;
+  readbacks.stats      = {};
+  readbacks.worker     = std::thread(readback_worker, &readbacks);
+}
+
+void destroy_readback_manager(const Device& device, Readback_Manager& readbacks) {
+  {
+    std::lock_guard<std::mutex> lock(readbacks.mutex);
+    readbacks.quit = true;
+  }
+  readbacks.job_available.notify_all();
+  readbacks.worker.join();
+
+  for (u32 i = 0; i < Readback_Manager::MAX_SLOTS; ++i) {
+    auto& slot = readbacks.slots[i];
+    if (slot.buffer) vmaDestroyBuffer(device.allocator, slot.buffer, slot.allocation);
+    slot.buffer = VK_NULL_HANDLE;
+  }
+}
+
+// returns the slot ready for its copy with everything but the destination filled in.
+static u32 readback_reserve(
+    const Device& device,
+    Readback_Manager& readbacks,
+    u32 width,
+    u32 height,
+    VkFormat format,
+    u64 frame) {
+  const u32 texel_size = readback_texel_size(format);
+  assert(texel_size != 0 && "no encoder knows the format");
+  assert(width > 0 && height > 0);
+
+  u32 idx = 0;
+  for (; idx < Readback_Manager::MAX_SLOTS; ++idx) {
+    if (readbacks.slots[idx].state.load(std::memory_order_acquire) == Readback_State::free) break;
+  }
+  if (idx == Readback_Manager::MAX_SLOTS) {
+    std::lock_guard<std::mutex> lock(readbacks.mutex);
+    readbacks.stats.dropped++;
+    return (u32)-1;
+  }
+
+  auto& slot              = readbacks.slots[idx];
+  const VkDeviceSize size = (VkDeviceSize)width * height * texel_size;
+  if (slot.capacity < size) {
+    // free slots aren't used by the gpu or the worker anymore.
+    if (slot.buffer) vmaDestroyBuffer(device.allocator, slot.buffer, slot.allocation);
+
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size               = size;
+    buffer_info.usage              = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+    // the cpu reads every byte back, uncached memory would make that crawl.
+    VmaAllocationCreateInfo allocation_info = {};
+    allocation_info.usage                   = VMA_MEMORY_USAGE_AUTO;
+    allocation_info.flags          = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    allocation_info.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    VmaAllocationInfo info;
+    VK_CHECK(vmaCreateBuffer(device.allocator, &buffer_info, &allocation_info, &slot.buffer, &slot.allocation, &info));
+    slot.data     = (const u8*)info.pMappedData;
+    slot.capacity = size;
+    assert(slot.data);
+  }
+
+  slot.image.pixels   = slot.data;
+  slot.image.width    = width;
+  slot.image.height   = height;
+  slot.image.format   = format;
+  slot.image.frame    = frame;
+  slot.size           = size;
+  slot.timeline_value = 0;
+  slot.request_ticks  = os_now_ticks();
+  slot.path[0]        = '\0';
+  slot.callback       = nullptr;
+  slot.user_data      = nullptr;
+  slot.state.store(Readback_State::recorded, std::memory_order_relaxed);
+  return idx;
+}
+
+u32 readback_request(
+    const Device& device,
+    Readback_Manager& readbacks,
+    u32 width,
+    u32 height,
+    VkFormat format,
+    u64 frame,
+    Readback_Encoding encoding,
+    const char* path) {
+  assert(path && strlen(path) < Readback_Manager::PATH_SIZE);
+  const u32 idx = readback_reserve(device, readbacks, width, height, format, frame);
+  if (idx == (u32)-1) return idx;
+
+  auto& slot    = readbacks.slots[idx];
+  slot.encoding = encoding;
+  snprintf(slot.path, sizeof(slot.path), "%s", path);
+  return idx;
+}
+
+u32 readback_request(
+    const Device& device,
+    Readback_Manager& readbacks,
+    u32 width,
+    u32 height,
+    VkFormat format,
+    u64 frame,
+    Readback_Fn callback,
+    void* user_data) {
+  assert(callback);
+  const u32 idx = readback_reserve(device, readbacks, width, height, format, frame);
+  if (idx == (u32)-1) return idx;
+
+  auto& slot     = readbacks.slots[idx];
+  slot.callback  = callback;
+  slot.user_data = user_data;
+  return idx;
+}
+
+void readback_record_copy(const Readback_Manager& readbacks, u32 slot, VkCommandBuffer cmd, VkImage image) {
+  assert(slot < Readback_Manager::MAX_SLOTS);
+  const auto& entry = readbacks.slots[slot];
+  assert(entry.state.load(std::memory_order_relaxed) == Readback_State::recorded);
+
+  VkBufferImageCopy region           = {};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent                 = { entry.image.width, entry.image.height, 1 };
+  vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, entry.buffer, 1, &region);
+}
+
+VkBuffer readback_buffer(const Readback_Manager& readbacks, u32 slot) {
+  assert(slot < Readback_Manager::MAX_SLOTS);
+  return readbacks.slots[slot].buffer;
+}
+
+VkDeviceSize readback_size(const Readback_Manager& readbacks, u32 slot) {
+  assert(slot < Readback_Manager::MAX_SLOTS);
+  return readbacks.slots[slot].size;
+}
+
+void readback_submitted(Readback_Manager& readbacks, u64 timeline_value) {
+  for (u32 i = 0; i < Readback_Manager::MAX_SLOTS; ++i) {
+    auto& slot = readbacks.slots[i];
+    if (slot.state.load(std::memory_order_relaxed) != Readback_State::recorded) continue;
+    slot.timeline_value = timeline_value;
+    slot.state.store(Readback_State::in_flight, std::memory_order_relaxed);
+  }
+}
+
+void readback_update(const Device& device, Readback_Manager& readbacks, u64 completed) {
+  PROFILE_FUNCTION();
+  u32 handed_over = 0;
+  for (u32 i = 0; i < Readback_Manager::MAX_SLOTS; ++i) {
+    auto& slot = readbacks.slots[i];
+    if (slot.state.load(std::memory_order_relaxed) != Readback_State::in_flight) continue;
+    if (slot.timeline_value > completed) continue;
+
+    // the graph's host read barrier made the copy available, cached memory still has to be invalidated.
+    VK_CHECK(vmaInvalidateAllocation(device.allocator, slot.allocation, 0, slot.size));
+    slot.state.store(Readback_State::encoding, std::memory_order_relaxed);
+    const f64 latency_ms = os_ticks_to_ms(os_now_ticks() - slot.request_ticks);
+
+    std::lock_guard<std::mutex> lock(readbacks.mutex);
+    readbacks.stats.latency_ms                                            = latency_ms;
+    readbacks.queue[readbacks.queue_tail++ % Readback_Manager::MAX_SLOTS] = i;
+    handed_over++;
+  }
+  if (handed_over) readbacks.job_available.notify_one();
+}
+
+void readback_wait_idle(Readback_Manager& readbacks) {
+  std::unique_lock<std::mutex> lock(readbacks.mutex);
+  readbacks.job_done.wait(lock, [&] { return !readbacks.busy && readbacks.queue_head == readbacks.queue_tail; });
+}
+
+void readback_draw_imgui(Readback_Manager& readbacks, bool* open) {
+  if (!ImGui::Begin("readbacks", open)) {
+    ImGui::End();
+    return;
+  }
+
+  Readback_Stats stats;
+  {
+    std::lock_guard<std::mutex> lock(readbacks.mutex);
+    stats = readbacks.stats;
+  }
+  ImGui::Text(
+      "%llu done, %llu dropped, %llu failed",
+      (unsigned long long)stats.completed,
+      (unsigned long long)stats.dropped,
+      (unsigned long long)stats.failed);
+  ImGui::Text("last latency %.3f ms, encode %.3f ms", stats.latency_ms, stats.encode_ms);
+
+  if (ImGui::BeginTable("slots", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("slot");
+    ImGui::TableSetupColumn("state");
+    ImGui::TableSetupColumn("buffer MiB");
+    ImGui::TableHeadersRow();
+    for (u32 i = 0; i < Readback_Manager::MAX_SLOTS; ++i) {
+      const auto& slot = readbacks.slots[i];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%u", i);
+      ImGui::TableNextColumn();
+      ImGui::Text("%s", readback_state_name(slot.state.load(std::memory_order_acquire)));
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f", slot.capacity / (1024.0 * 1024.0));
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "common.hpp"
+#include "device.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// Pixels of a finished readback, valid for the duration of the callback only.
+struct Readback_Image {
+  const u8* pixels; // tightly packed rows, top to bottom.
+  u32 width;
+  u32 height;
+  VkFormat format;
+  u64 frame; // what the request was tagged with.
+};
+
+/// Runs on the readback worker.
+using Readback_Fn = void (*)(const Readback_Image& image, void* user_data);
+
+enum struct Readback_Encoding : u32 {
+  raw, // the texels as they are.
+  ppm, // rgb8, alpha is dropped.
+  png, // rgba8, stored without compression so encoding stays cheap.
+  count
+};
+
+const char* readback_encoding_name(Readback_Encoding encoding);
+/// Formats the encoders can convert, requests have to use one of them.
+bool readback_supports_format(VkFormat format);
+
+enum struct Readback_State : u32 {
+  free,
+  recorded,  // copy recorded, waiting for the frame's submission.
+  in_flight, // waiting for the gpu.
+  encoding,  // handed to the worker.
+};
+
+struct Readback_Stats {
+  u64 completed;
+  u64 dropped;    // requests that found every slot busy.
+  u64 failed;     // files that couldn't be written.
+  f64 latency_ms; // request to pixels on the cpu of the last one, polled once per frame so it's an upper bound.
+  f64 encode_ms;  // of the last one on the worker.
+};
+
+/// Copies images into a ring of host cached buffers without ever stalling the frame. A request reserves a slot, the
+/// frame records the copy into its buffer and tags it with the timeline value it signals. The buffer is only read
+/// once the gpu is past that value, some frames later, then a worker thread encodes it to a file or hands it to a
+/// callback. When every slot is busy the request is dropped instead of waiting.
+struct Readback_Manager {
+  static constexpr u32 MAX_SLOTS = 8;
+  static constexpr u32 PATH_SIZE = 256;
+
+  struct Slot {
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    const u8* data; // persistently mapped, only read once `timeline_value` is reached.
+    VkDeviceSize capacity;
+
+    Readback_Image image;
+    VkDeviceSize size;
+    u64 timeline_value;
+    u64 request_ticks;
+
+    Readback_Encoding encoding;
+    char path[PATH_SIZE]; // empty when there's a callback.
+    Readback_Fn callback;
+    void* user_data;
+
+    std::atomic<Readback_State> state;
+  } slots[MAX_SLOTS];
+
+  // slot indices waiting for the worker, guarded by `mutex` like the stats.
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable job_available;
+  std::condition_variable job_done;
+  u32 queue[MAX_SLOTS];
+  u32 queue_head; // both only grow, the queue index is modulo MAX_SLOTS.
+  u32 queue_tail;
+  bool busy;
+  bool quit;
+
+  Readback_Stats stats;
+};
+
+void create_readback_manager(Readback_Manager& readbacks);
+/// The gpu has to be idle. Readbacks that were never submitted or completed are dropped, queued ones still finish.
+void destroy_readback_manager(const Device& device, Readback_Manager& readbacks);
+
+/// Reserves a slot for an image of `width` x `height` texels, written to `path` once done. Returns the slot to record
+/// the copy with, (u32)-1 if none is free.
+u32 readback_request(
+    const Device& device,
+    Readback_Manager& readbacks,
+    u32 width,
+    u32 height,
+    VkFormat format,
+    u64 frame,
+    Readback_Encoding encoding,
+    const char* path);
+/// Same, but `callback` gets the pixels instead.
+u32 readback_request(
+    const Device& device,
+    Readback_Manager& readbacks,
+    u32 width,
+    u32 height,
+    VkFormat format,
+    u64 frame,
+    Readback_Fn callback,
+    void* user_data);
+
+/// Copies mip 0 of layer 0 of `image`, which has to be in transfer src, into the slot's buffer.
+void readback_record_copy(const Readback_Manager& readbacks, u32 slot, VkCommandBuffer cmd, VkImage image);
+VkBuffer readback_buffer(const Readback_Manager& readbacks, u32 slot);
+VkDeviceSize readback_size(const Readback_Manager& readbacks, u32 slot);
+
+/// Call once the frame is submitted, `timeline_value` is what its graphics submission signals.
+void readback_submitted(Readback_Manager& readbacks, u64 timeline_value);
+
+/// Call once per frame, hands the readbacks the gpu is done with to the worker.
+void readback_update(const Device& device, Readback_Manager& readbacks, u64 completed);
+
+/// Waits for the worker to finish everything handed to it.
+void readback_wait_idle(Readback_Manager& readbacks);
+
+void readback_draw_imgui(Readback_Manager& readbacks, bool* open);
@@ -0,0 +1,905 @@
+#include "render_graph.hpp"
+#include "core/common.hpp"
+#include "imgui.h"
+#include "pass_cache.hpp"
+#include "profile/gpu_profiler.hpp"
+#include "profile/profiler.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+struct Usage_Info {
+  VkPipelineStageFlags2 stages;
+  VkAccessFlags2 access;
+  VkImageLayout layout;
+  const char* name;
+};
+
+static const Usage_Info image_usage_infos[(u32)Image_Usage::count] = {
+  { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, "undefined" },
+  { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, "acquired" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    VK_IMAGE_LAYOUT_GENERAL,
+    "compute read" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    VK_IMAGE_LAYOUT_GENERAL,
+    "compute write" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    VK_IMAGE_LAYOUT_GENERAL,
+    "compute read write" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    "compute sampled" },
+  { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+    VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    "fragment sampled" },
+  { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+    VK_ACCESS_2_TRANSFER_READ_BIT,
+    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    "transfer src" },
+  { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+    VK_ACCESS_2_TRANSFER_WRITE_BIT,
+    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+    "transfer dst" },
+  { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    "color attachment" },
+  { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+    "color attachment load" },
+  { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+    VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+    "depth attachment" },
+  // the present engine waits on a semaphore, the barrier only has to get the layout right.
+  { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, "present" },
+};
+
+static const Usage_Info buffer_usage_infos[(u32)Buffer_Usage::count] = {
+  { VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED, "none" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    "compute read" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    "compute write" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    "compute read write" },
+  { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, "transfer src" },
+  { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, "transfer dst" },
+  { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+    VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    "indirect" },
+  { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+    VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    "vertex" },
+  { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, "index" },
+  { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+    VK_ACCESS_2_UNIFORM_READ_BIT,
+    VK_IMAGE_LAYOUT_UNDEFINED,
+    "uniform" },
+  { VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, "host read" },
+};
+
+static const VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+// where a resource is at while walking the passes.
+struct Resource_State {
+  VkPipelineStageFlags2 write_stages; // the last write, layout transitions count as one.
+  VkAccessFlags2 write_access;
+  VkPipelineStageFlags2 read_stages;    // every read since the last write.
+  VkPipelineStageFlags2 visible_stages; // stages that already waited on the last write, with `visible_access`.
+  VkAccessFlags2 visible_access;
+  VkImageLayout layout;
+  u32 queue; // Render_Queue that owns it, (u32)-1 while its contents don't matter.
+};
+
+struct Barrier_Masks {
+  VkPipelineStageFlags2 src_stages;
+  VkAccessFlags2 src_access;
+  VkPipelineStageFlags2 dst_stages;
+  VkAccessFlags2 dst_access;
+  VkImageLayout old_layout;
+  VkImageLayout new_layout;
+  u32 src_queue_family;
+  u32 dst_queue_family;
+};
+
+static Resource_State resource_state_init(const Usage_Info& info) {
+  Resource_State state = {};
+  if (info.access & WRITE_ACCESS) {
+    state.write_stages = info.stages;
+    state.write_access = info.access & WRITE_ACCESS;
+  } else {
+    state.read_stages = info.stages;
+  }
+  state.layout = info.layout;
+  // whatever comes in with contents comes from graphics.
+  state.queue = info.stages != 0 || info.layout != VK_IMAGE_LAYOUT_UNDEFINED ? (u32)Render_Queue::graphics : (u32)-1;
+  return state;
+}
+
+// moves `state` to the new usage, returns false when what came before already orders it.
+static bool resource_state_transition(
+    Resource_State& state,
+    VkPipelineStageFlags2 stages,
+    VkAccessFlags2 access,
+    VkImageLayout layout,
+    Barrier_Masks& barrier) {
+  const bool writes        = (access & WRITE_ACCESS) != 0;
+  const bool layout_change = layout != state.layout;
+  barrier.old_layout       = state.layout;
+  barrier.new_layout       = layout;
+  barrier.src_queue_family = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dst_queue_family = VK_QUEUE_FAMILY_IGNORED;
+
+  if (writes || layout_change) {
+    // write after write needs the previous write available, write after read only has to wait on the readers.
+    barrier.src_stages = state.write_stages | state.read_stages;
+    barrier.src_access = state.write_access;
+    barrier.dst_stages = stages;
+    barrier.dst_access = access;
+
+    state.write_stages   = stages;
+    state.write_access   = access & WRITE_ACCESS;
+    state.read_stages    = 0;
+    state.visible_stages = stages;
+    state.visible_access = access;
+    state.layout         = layout;
+    return layout_change || barrier.src_stages != 0;
+  }
+
+  state.read_stages |= stages;
+  if (state.write_stages == 0) return false;
+  if (!(stages & ~state.visible_stages) && !(access & ~state.visible_access)) return false;
+
+  // widen to everything made visible so far so every stage and access pair in the masks is covered.
+  state.visible_stages |= stages;
+  state.visible_access |= access;
+  barrier.src_stages = state.write_stages;
+  barrier.src_access = state.write_access;
+  barrier.dst_stages = state.visible_stages;
+  barrier.dst_access = state.visible_access;
+  return true;
+}
+
+void render_graph_reset(Render_Graph& graph) {
+  graph.image_count          = 0;
+  graph.buffer_count         = 0;
+  graph.pass_count           = 0;
+  graph.image_barrier_count  = 0;
+  graph.buffer_barrier_count = 0;
+  graph.final_barriers       = {};
+  graph.queue_release        = {};
+  graph.async_wait_stages    = 0;
+  graph.transients           = nullptr;
+  graph.compiled             = false;
+}
+
+Graph_Image render_graph_import_image(
+    Render_Graph& graph,
+    const char* name,
+    VkImage image,
+    VkImageAspectFlags aspect,
+    Image_Usage initial_usage,
+    Image_Usage final_usage) {
+  assert(graph.image_count < Render_Graph::MAX_IMAGES);
+  auto& resource         = graph.images[graph.image_count];
+  resource.name          = name;
+  resource.image         = image;
+  resource.aspect        = aspect;
+  resource.initial_usage = initial_usage;
+  resource.final_usage   = final_usage;
+  resource.transient     = false;
+  resource.view          = VK_NULL_HANDLE;
+  return Graph_Image{ graph.image_count++ };
+}
+
+Graph_Image render_graph_create_image(Render_Graph& graph, const char* name, const Transient_Image_Desc& desc) {
+  assert(graph.image_count < Render_Graph::MAX_IMAGES);
+  auto& resource         = graph.images[graph.image_count];
+  resource.name          = name;
+  resource.image         = VK_NULL_HANDLE;
+  resource.aspect        = transient_image_aspect(desc.format);
+  resource.initial_usage = Image_Usage::undefined;
+  resource.final_usage   = Image_Usage::undefined;
+  resource.transient     = true;
+  resource.desc          = desc;
+  resource.view          = VK_NULL_HANDLE;
+  return Graph_Image{ graph.image_count++ };
+}
+
+Graph_Buffer render_graph_import_buffer(
+    Render_Graph& graph,
+    const char* name,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    Buffer_Usage initial_usage,
+    Buffer_Usage final_usage) {
+  assert(graph.buffer_count < Render_Graph::MAX_BUFFERS);
+  auto& resource         = graph.buffers[graph.buffer_count];
+  resource.name          = name;
+  resource.buffer        = buffer;
+  resource.offset        = offset;
+  resource.size          = size;
+  resource.initial_usage = initial_usage;
+  resource.final_usage   = final_usage;
+  return Graph_Buffer{ graph.buffer_count++ };
+}
+
+u32 render_graph_add_pass(
+    Render_Graph& graph,
+    const char* name,
+    Render_Pass_Fn execute,
+    void* user_data,
+    bool side_effects,
+    Render_Queue queue) {
+  assert(graph.pass_count < Render_Graph::MAX_PASSES);
+  auto& pass        = graph.passes[graph.pass_count];
+  pass.name         = name;
+  pass.execute      = execute;
+  pass.user_data    = user_data;
+  pass.side_effects = side_effects;
+  pass.queue        = queue;
+  pass.cache_key    = 0;
+  pass.access_count = 0;
+  pass.culled       = false;
+  pass.barriers     = {};
+  return graph.pass_count++;
+}
+
+void render_graph_cache_pass(Render_Graph& graph, u32 pass_idx, u64 inputs_hash) {
+  assert(pass_idx < graph.pass_count);
+  auto& pass     = graph.passes[pass_idx];
+  pass.cache_key = hash_bytes(pass.name, strlen(pass.name), inputs_hash);
+  if (pass.cache_key == 0) pass.cache_key = 1;
+}
+
+static void render_graph_use(Render_Graph& graph, u32 pass_idx, bool is_buffer, u32 resource, u32 usage) {
+  assert(pass_idx < graph.pass_count);
+  const Usage_Info& info = is_buffer ? buffer_usage_infos[usage] : image_usage_infos[usage];
+  assert(info.access != VK_ACCESS_2_NONE && "this usage only describes the state entering or leaving the graph");
+
+  auto& pass = graph.passes[pass_idx];
+  for (u32 i = 0; i < pass.access_count; ++i) {
+    auto& access = pass.accesses[i];
+    if (access.is_buffer != is_buffer || access.resource != resource) continue;
+    assert(access.layout == info.layout && "an image can only be in one layout during a pass");
+    access.stages |= info.stages;
+    access.access |= info.access;
+    return;
+  }
+
+  assert(pass.access_count < Render_Graph::MAX_ACCESSES);
+  auto& access     = pass.accesses[pass.access_count++];
+  access.is_buffer = is_buffer;
+  access.resource  = resource;
+  access.usage     = usage;
+  access.stages    = info.stages;
+  access.access    = info.access;
+  access.layout    = info.layout;
+}
+
+void render_graph_use_image(Render_Graph& graph, u32 pass, Graph_Image image, Image_Usage usage) {
+  assert(image.idx < graph.image_count);
+  render_graph_use(graph, pass, false, image.idx, (u32)usage);
+}
+
+void render_graph_use_buffer(Render_Graph& graph, u32 pass, Graph_Buffer buffer, Buffer_Usage usage) {
+  assert(buffer.idx < graph.buffer_count);
+  render_graph_use(graph, pass, true, buffer.idx, (u32)usage);
+}
+
+// walks the passes backwards from the outputs, a pass survives if it writes something a later survivor reads.
+static void render_graph_cull(Render_Graph& graph) {
+  bool image_needed[Render_Graph::MAX_IMAGES];
+  bool buffer_needed[Render_Graph::MAX_BUFFERS];
+  for (u32 i = 0; i < graph.image_count; ++i) image_needed[i] = graph.images[i].final_usage != Image_Usage::undefined;
+  for (u32 i = 0; i < graph.buffer_count; ++i) buffer_needed[i] = graph.buffers[i].final_usage != Buffer_Usage::none;
+
+  for (u32 p = graph.pass_count; p-- > 0;) {
+    auto& pass = graph.passes[p];
+    bool alive = pass.side_effects;
+    for (u32 i = 0; i < pass.access_count && !alive; ++i) {
+      const auto& access = pass.accesses[i];
+      bool needed        = access.is_buffer ? buffer_needed[access.resource] : image_needed[access.resource];
+      alive              = needed && (access.access & WRITE_ACCESS);
+    }
+    pass.culled = !alive;
+    if (!alive) continue;
+
+    for (u32 i = 0; i < pass.access_count; ++i) {
+      const auto& access = pass.accesses[i];
+      bool& needed       = access.is_buffer ? buffer_needed[access.resource] : image_needed[access.resource];
+      // a write only usage overwrites everything, whatever came before it is dead unless read on the way.
+      needed = (access.access & ~WRITE_ACCESS) != 0;
+    }
+  }
+}
+
+static void push_image_barrier(Render_Graph& graph, u32 resource, const Barrier_Masks& masks) {
+  assert(graph.image_barrier_count < Render_Graph::MAX_BARRIERS);
+  const auto& image = graph.images[resource];
+
+  VkImageMemoryBarrier2 barrier           = {};
+  barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.srcStageMask                    = masks.src_stages;
+  barrier.srcAccessMask                   = masks.src_access;
+  barrier.dstStageMask                    = masks.dst_stages;
+  barrier.dstAccessMask                   = masks.dst_access;
+  barrier.oldLayout                       = masks.old_layout;
+  barrier.newLayout                       = masks.new_layout;
+  barrier.srcQueueFamilyIndex             = masks.src_queue_family;
+  barrier.dstQueueFamilyIndex             = masks.dst_queue_family;
+  barrier.image                           = image.image;
+  barrier.subresourceRange.aspectMask     = image.aspect;
+  barrier.subresourceRange.baseMipLevel   = 0;
+  barrier.subresourceRange.levelCount     = VK_REMAINING_MIP_LEVELS;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount     = VK_REMAINING_ARRAY_LAYERS;
+
+  graph.image_barrier_resources[graph.image_barrier_count] = resource;
+  graph.image_barriers[graph.image_barrier_count++]        = barrier;
+}
+
+static void push_buffer_barrier(Render_Graph& graph, u32 resource, const Barrier_Masks& masks) {
+  assert(graph.buffer_barrier_count < Render_Graph::MAX_BARRIERS);
+  const auto& buffer = graph.buffers[resource];
+
+  VkBufferMemoryBarrier2 barrier = {};
+  barrier.sType                  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+  barrier.srcStageMask           = masks.src_stages;
+  barrier.srcAccessMask          = masks.src_access;
+  barrier.dstStageMask           = masks.dst_stages;
+  barrier.dstAccessMask          = masks.dst_access;
+  barrier.srcQueueFamilyIndex    = masks.src_queue_family;
+  barrier.dstQueueFamilyIndex    = masks.dst_queue_family;
+  barrier.buffer                 = buffer.buffer;
+  barrier.offset                 = buffer.offset;
+  barrier.size                   = buffer.size;
+
+  graph.buffer_barrier_resources[graph.buffer_barrier_count] = resource;
+  graph.buffer_barriers[graph.buffer_barrier_count++]        = barrier;
+}
+
+// lifetimes of the transient images over the passes that survived culling, then their place in the heap.
+static void render_graph_place_transients(const Device& device, Render_Graph& graph, Transient_Heap& transients) {
+  for (u32 i = 0; i < graph.image_count; ++i) {
+    graph.images[i].first_pass = (u32)-1;
+    graph.images[i].last_pass  = 0;
+  }
+  for (u32 p = 0; p < graph.pass_count; ++p) {
+    const auto& pass = graph.passes[p];
+    if (pass.culled) continue;
+    for (u32 i = 0; i < pass.access_count; ++i) {
+      if (pass.accesses[i].is_buffer) continue;
+      auto& image = graph.images[pass.accesses[i].resource];
+      if (image.first_pass == (u32)-1) image.first_pass = p;
+      image.last_pass = p;
+    }
+  }
+  // pass order says nothing about when async compute runs next to graphics, its images can't share memory.
+  for (u32 p = 0; p < graph.pass_count; ++p) {
+    const auto& pass = graph.passes[p];
+    if (pass.culled || pass.queue != Render_Queue::async_compute) continue;
+    for (u32 i = 0; i < pass.access_count; ++i) {
+      if (pass.accesses[i].is_buffer) continue;
+      auto& image      = graph.images[pass.accesses[i].resource];
+      image.first_pass = 0;
+      image.last_pass  = graph.pass_count - 1;
+    }
+  }
+
+  Transient_Request requests[Transient_Heap::MAX_IMAGES];
+  u32 request_count = 0;
+  for (u32 i = 0; i < graph.image_count; ++i) {
+    auto& image         = graph.images[i];
+    image.transient_idx = (u32)-1;
+    if (!image.transient || image.first_pass == (u32)-1) continue;
+
+    assert(request_count < Transient_Heap::MAX_IMAGES);
+    auto& request       = requests[request_count];
+    request.desc        = image.desc;
+    request.first_pass  = image.first_pass;
+    request.last_pass   = image.last_pass;
+    image.transient_idx = request_count++;
+  }
+  transient_heap_place(device, transients, requests, request_count);
+
+  for (u32 i = 0; i < graph.image_count; ++i) {
+    auto& image = graph.images[i];
+    if (!image.transient) continue;
+    const bool placed = image.transient_idx != (u32)-1;
+    image.image       = placed ? transients.images[image.transient_idx].image : VK_NULL_HANDLE;
+    image.view        = placed ? transients.images[image.transient_idx].view : VK_NULL_HANDLE;
+  }
+  graph.transients = &transients;
+}
+
+// a transient image starts out where whatever shared its memory before left off, its first barrier has to wait on
+// those to be done with the memory.
+static Resource_State aliased_state(const Render_Graph& graph, u32 image_idx, const Resource_State* image_states) {
+  const auto& image    = graph.images[image_idx];
+  Resource_State state = {};
+  state.layout         = VK_IMAGE_LAYOUT_UNDEFINED;
+  state.queue          = (u32)-1;
+  for (u32 i = 0; i < graph.image_count; ++i) {
+    const auto& other = graph.images[i];
+    if (i == image_idx || other.transient_idx == (u32)-1 || other.last_pass >= image.first_pass) continue;
+    if (!transient_heap_overlaps(*graph.transients, image.transient_idx, other.transient_idx)) continue;
+    state.write_stages |= image_states[i].write_stages;
+    state.write_access |= image_states[i].write_access;
+    state.read_stages |= image_states[i].read_stages;
+  }
+  return state;
+}
+
+static void push_barrier(Render_Graph& graph, bool is_buffer, u32 resource, const Barrier_Masks& masks) {
+  if (is_buffer) push_buffer_barrier(graph, resource, masks);
+  else
+    push_image_barrier(graph, resource, masks);
+}
+
+// moves a resource into a usage on `queue`, pushing the barriers it takes in front of the current pass. going from
+// async compute to graphics the semaphore between the submissions already orders the work and makes the writes
+// visible, what's left is the layout and, across families, the ownership. that barrier has to chain onto the wait:
+// the wait only holds back `stages`, so they are its source, a transition with no source stages could run before
+// the compute work is done. `release` gets the half of the transfer the async compute side records.
+static void render_graph_transition(
+    Render_Graph& graph,
+    Resource_State& state,
+    bool is_buffer,
+    u32 resource,
+    Render_Queue queue,
+    VkPipelineStageFlags2 stages,
+    VkAccessFlags2 access,
+    VkImageLayout layout,
+    Barrier_Masks& release,
+    bool& released) {
+  Barrier_Masks masks;
+  if (state.queue == (u32)-1 || state.queue == (u32)queue) {
+    state.queue = (u32)queue;
+    if (resource_state_transition(state, stages, access, layout, masks))
+      push_barrier(graph, is_buffer, resource, masks);
+    return;
+  }
+  assert(
+      state.queue == (u32)Render_Queue::async_compute &&
+      "async compute runs ahead of graphics, it can't use what graphics touched earlier in the graph");
+
+  const u32 src_family   = graph.queue_families[state.queue];
+  const u32 dst_family   = graph.queue_families[(u32)queue];
+  const bool transfer    = src_family != dst_family;
+  masks.old_layout       = state.layout;
+  masks.new_layout       = layout;
+  masks.src_queue_family = transfer ? src_family : VK_QUEUE_FAMILY_IGNORED;
+  masks.dst_queue_family = transfer ? dst_family : VK_QUEUE_FAMILY_IGNORED;
+  if (transfer) {
+    release            = masks;
+    release.src_stages = state.write_stages | state.read_stages;
+    release.src_access = state.write_access;
+    release.dst_stages = VK_PIPELINE_STAGE_2_NONE;
+    release.dst_access = VK_ACCESS_2_NONE;
+    released           = true;
+  }
+
+  // the semaphore already made the writes visible, only the execution has to chain.
+  masks.src_stages = stages;
+  masks.src_access = VK_ACCESS_2_NONE;
+  masks.dst_stages = stages;
+  masks.dst_access = access;
+  if (transfer || layout != state.layout) push_barrier(graph, is_buffer, resource, masks);
+  graph.async_wait_stages |= stages;
+
+  // later passes chain onto the wait (and the acquire) like onto a write.
+  state                = {};
+  state.write_stages   = stages;
+  state.write_access   = access & WRITE_ACCESS;
+  state.visible_stages = stages;
+  state.visible_access = access;
+  state.layout         = layout;
+  state.queue          = (u32)queue;
+}
+
+void render_graph_compile(const Device& device, Render_Graph& graph, Transient_Heap& transients) {
+  PROFILE_FUNCTION();
+  graph.image_barrier_count                              = 0;
+  graph.buffer_barrier_count                             = 0;
+  graph.async_wait_stages                                = 0;
+  graph.queue_families[(u32)Render_Queue::graphics]      = device.queue_family;
+  graph.queue_families[(u32)Render_Queue::async_compute] = device.compute_queue_family;
+  if (!device.async_compute) {
+    for (u32 p = 0; p < graph.pass_count; ++p) graph.passes[p].queue = Render_Queue::graphics;
+  }
+  render_graph_cull(graph);
+  render_graph_place_transients(device, graph, transients);
+
+  Resource_State image_states[Render_Graph::MAX_IMAGES];
+  Resource_State buffer_states[Render_Graph::MAX_BUFFERS];
+  for (u32 i = 0; i < graph.image_count; ++i)
+    image_states[i] = resource_state_init(image_usage_infos[(u32)graph.images[i].initial_usage]);
+  for (u32 i = 0; i < graph.buffer_count; ++i)
+    buffer_states[i] = resource_state_init(buffer_usage_infos[(u32)graph.buffers[i].initial_usage]);
+
+  Barrier_Masks image_releases[Render_Graph::MAX_IMAGES];
+  Barrier_Masks buffer_releases[Render_Graph::MAX_BUFFERS];
+  bool image_released[Render_Graph::MAX_IMAGES]   = {};
+  bool buffer_released[Render_Graph::MAX_BUFFERS] = {};
+
+  for (u32 p = 0; p < graph.pass_count; ++p) {
+    auto& pass                 = graph.passes[p];
+    pass.barriers.first_image  = graph.image_barrier_count;
+    pass.barriers.first_buffer = graph.buffer_barrier_count;
+    if (!pass.culled) {
+      for (u32 i = 0; i < pass.access_count; ++i) {
+        const auto& access = pass.accesses[i];
+        const u32 r        = access.resource;
+        if (access.is_buffer) {
+          render_graph_transition(
+              graph,
+              buffer_states[r],
+              true,
+              r,
+              pass.queue,
+              access.stages,
+              access.access,
+              access.layout,
+              buffer_releases[r],
+              buffer_released[r]);
+        } else {
+          if (graph.images[r].transient && graph.images[r].first_pass == p)
+            image_states[r] = aliased_state(graph, r, image_states);
+          render_graph_transition(
+              graph,
+              image_states[r],
+              false,
+              r,
+              pass.queue,
+              access.stages,
+              access.access,
+              access.layout,
+              image_releases[r],
+              image_released[r]);
+        }
+      }
+    }
+    pass.barriers.image_count  = graph.image_barrier_count - pass.barriers.first_image;
+    pass.barriers.buffer_count = graph.buffer_barrier_count - pass.barriers.first_buffer;
+  }
+
+  graph.final_barriers.first_image  = graph.image_barrier_count;
+  graph.final_barriers.first_buffer = graph.buffer_barrier_count;
+  // outputs leave the graph from graphics.
+  for (u32 i = 0; i < graph.image_count; ++i) {
+    if (graph.images[i].final_usage == Image_Usage::undefined) continue;
+    const Usage_Info& info = image_usage_infos[(u32)graph.images[i].final_usage];
+    render_graph_transition(
+        graph,
+        image_states[i],
+        false,
+        i,
+        Render_Queue::graphics,
+        info.stages,
+        info.access,
+        info.layout,
+        image_releases[i],
+        image_released[i]);
+  }
+  for (u32 i = 0; i < graph.buffer_count; ++i) {
+    if (graph.buffers[i].final_usage == Buffer_Usage::none) continue;
+    const Usage_Info& info = buffer_usage_infos[(u32)graph.buffers[i].final_usage];
+    render_graph_transition(
+        graph,
+        buffer_states[i],
+        true,
+        i,
+        Render_Queue::graphics,
+        info.stages,
+        info.access,
+        info.layout,
+        buffer_releases[i],
+        buffer_released[i]);
+  }
+  graph.final_barriers.image_count  = graph.image_barrier_count - graph.final_barriers.first_image;
+  graph.final_barriers.buffer_count = graph.buffer_barrier_count - graph.final_barriers.first_buffer;
+
+  graph.queue_release.first_image  = graph.image_barrier_count;
+  graph.queue_release.first_buffer = graph.buffer_barrier_count;
+  for (u32 i = 0; i < graph.image_count; ++i)
+    if (image_released[i]) push_image_barrier(graph, i, image_releases[i]);
+  for (u32 i = 0; i < graph.buffer_count; ++i)
+    if (buffer_released[i]) push_buffer_barrier(graph, i, buffer_releases[i]);
+  graph.queue_release.image_count  = graph.image_barrier_count - graph.queue_release.first_image;
+  graph.queue_release.buffer_count = graph.buffer_barrier_count - graph.queue_release.first_buffer;
+  graph.compiled                   = true;
+}
+
+VkImage render_graph_image(const Render_Graph& graph, Graph_Image image) {
+  assert(image.idx < graph.image_count);
+  return graph.images[image.idx].image;
+}
+
+VkImageView render_graph_image_view(const Render_Graph& graph, Graph_Image image) {
+  assert(image.idx < graph.image_count);
+  return graph.images[image.idx].view;
+}
+
+static void record_barriers(const Render_Graph& graph, VkCommandBuffer cmd, const Render_Graph::Barrier_Batch& batch) {
+  if (batch.image_count == 0 && batch.buffer_count == 0) return;
+
+  VkDependencyInfo dependency_info         = {};
+  dependency_info.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency_info.imageMemoryBarrierCount  = batch.image_count;
+  dependency_info.pImageMemoryBarriers     = graph.image_barriers + batch.first_image;
+  dependency_info.bufferMemoryBarrierCount = batch.buffer_count;
+  dependency_info.pBufferMemoryBarriers    = graph.buffer_barriers + batch.first_buffer;
+  vkCmdPipelineBarrier2(cmd, &dependency_info);
+}
+
+bool render_graph_has_work(const Render_Graph& graph, Render_Queue queue) {
+  assert(graph.compiled && "call render_graph_compile first");
+  for (u32 p = 0; p < graph.pass_count; ++p)
+    if (!graph.passes[p].culled && graph.passes[p].queue == queue) return true;
+  return false;
+}
+
+static void render_graph_record_pass(const Render_Graph::Pass& pass, VkCommandBuffer cmd, Pass_Cache* cache) {
+  if (cache && pass.cache_key) {
+    pass_cache_execute(*cache, cmd, pass.queue, pass.cache_key, pass.execute, pass.user_data);
+  } else {
+    pass.execute(cmd, pass.user_data);
+  }
+}
+
+void render_graph_execute(
+    const Render_Graph& graph,
+    Render_Queue queue,
+    VkCommandBuffer cmd,
+    GPU_Profiler* profiler,
+    Pass_Cache* cache) {
+  PROFILE_FUNCTION();
+  assert(graph.compiled && "call render_graph_compile first");
+  for (u32 p = 0; p < graph.pass_count; ++p) {
+    const auto& pass = graph.passes[p];
+    if (pass.culled || pass.queue != queue) continue;
+
+    record_barriers(graph, cmd, pass.barriers);
+    if (profiler) {
+      GPU_PROFILE_SCOPE(*profiler, cmd, pass.name);
+      render_graph_record_pass(pass, cmd, cache);
+    } else {
+      render_graph_record_pass(pass, cmd, cache);
+    }
+  }
+  if (queue == Render_Queue::async_compute) record_barriers(graph, cmd, graph.queue_release);
+  else
+    record_barriers(graph, cmd, graph.final_barriers);
+}
+
+struct Flag_Name {
+  u64 bit;
+  const char* name;
+};
+
+static const Flag_Name stage_names[] = {
+  { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, "indirect" },
+  { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, "index" },
+  { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, "vertex input" },
+  { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, "vertex" },
+  { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT, "early tests" },
+  { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, "fragment" },
+  { VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, "late tests" },
+  { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, "color output" },
+  { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, "compute" },
+  { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, "transfer" },
+  { VK_PIPELINE_STAGE_2_HOST_BIT, "host" },
+};
+
+static const Flag_Name access_names[] = {
+  { VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, "indirect read" },
+  { VK_ACCESS_2_INDEX_READ_BIT, "index read" },
+  { VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, "vertex read" },
+  { VK_ACCESS_2_UNIFORM_READ_BIT, "uniform read" },
+  { VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, "sampled read" },
+  { VK_ACCESS_2_SHADER_STORAGE_READ_BIT, "storage read" },
+  { VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, "storage write" },
+  { VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT, "color read" },
+  { VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, "color write" },
+  { VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, "depth read" },
+  { VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, "depth write" },
+  { VK_ACCESS_2_TRANSFER_READ_BIT, "transfer read" },
+  { VK_ACCESS_2_TRANSFER_WRITE_BIT, "transfer write" },
+  { VK_ACCESS_2_HOST_READ_BIT, "host read" },
+  { VK_ACCESS_2_HOST_WRITE_BIT, "host write" },
+};
+
+static const char* flags_to_string(char* buffer, u32 size, u64 flags, const Flag_Name* names, u32 name_count) {
+  if (flags == 0) return "none";
+  u32 length = 0;
+  buffer[0]  = '\0';
+  for (u32 i = 0; i < name_count && length < size; ++i) {
+    if (!(flags & names[i].bit)) continue;
+    length += snprintf(buffer + length, size - length, "%s%s", length ? " | " : "", names[i].name);
+  }
+  return buffer;
+}
+
+static const char* layout_name(VkImageLayout layout) {
+  switch (layout) {
+  case VK_IMAGE_LAYOUT_UNDEFINED: return "undefined";
+  case VK_IMAGE_LAYOUT_GENERAL: return "general";
+  case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "color attachment";
+  case VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL: return "depth attachment";
+  case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "shader read only";
+  case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "transfer src";
+  case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "transfer dst";
+  case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "present";
+  default: return "other";
+  }
+}
+
+static void draw_barrier_batch(const Render_Graph& graph, const Render_Graph::Barrier_Batch& batch) {
+  char src_stages[128], dst_stages[128], src_access[128], dst_access[128];
+  for (u32 i = 0; i < batch.image_count; ++i) {
+    const auto& barrier = graph.image_barriers[batch.first_image + i];
+    ImGui::BulletText(
+        "%s: %s -> %s",
+        graph.images[graph.image_barrier_resources[batch.first_image + i]].name,
+        layout_name(barrier.oldLayout),
+        layout_name(barrier.newLayout));
+    ImGui::Indent();
+    ImGui::TextDisabled(
+        "stages %s -> %s",
+        flags_to_string(src_stages, sizeof(src_stages), barrier.srcStageMask, stage_names, ARRAY_SIZE(stage_names)),
+        flags_to_string(dst_stages, sizeof(dst_stages), barrier.dstStageMask, stage_names, ARRAY_SIZE(stage_names)));
+    ImGui::TextDisabled(
+        "access %s -> %s",
+        flags_to_string(src_access, sizeof(src_access), barrier.srcAccessMask, access_names, ARRAY_SIZE(access_names)),
+        flags_to_string(dst_access, sizeof(dst_access), barrier.dstAccessMask, access_names, ARRAY_SIZE(access_names)));
+    if (barrier.srcQueueFamilyIndex != barrier.dstQueueFamilyIndex)
+      ImGui::TextDisabled("queue family %u -> %u", barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex);
+    ImGui::Unindent();
+  }
+  for (u32 i = 0; i < batch.buffer_count; ++i) {
+    const auto& barrier = graph.buffer_barriers[batch.first_buffer + i];
+    ImGui::BulletText("%s", graph.buffers[graph.buffer_barrier_resources[batch.first_buffer + i]].name);
+    ImGui::Indent();
+    ImGui::TextDisabled(
+        "stages %s -> %s",
+        flags_to_string(src_stages, sizeof(src_stages), barrier.srcStageMask, stage_names, ARRAY_SIZE(stage_names)),
+        flags_to_string(dst_stages, sizeof(dst_stages), barrier.dstStageMask, stage_names, ARRAY_SIZE(stage_names)));
+    ImGui::TextDisabled(
+        "access %s -> %s",
+        flags_to_string(src_access, sizeof(src_access), barrier.srcAccessMask, access_names, ARRAY_SIZE(access_names)),
+        flags_to_string(dst_access, sizeof(dst_access), barrier.dstAccessMask, access_names, ARRAY_SIZE(access_names)));
+    if (barrier.srcQueueFamilyIndex != barrier.dstQueueFamilyIndex)
+      ImGui::TextDisabled("queue family %u -> %u", barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex);
+    ImGui::Unindent();
+  }
+}
+
+void render_graph_draw_imgui(const Render_Graph& graph, bool* open) {
+  if (!ImGui::Begin("render graph", open)) {
+    ImGui::End();
+    return;
+  }
+  if (!graph.compiled) {
+    ImGui::Text("nothing compiled yet.");
+    ImGui::End();
+    return;
+  }
+
+  u32 culled = 0, batches = graph.final_barriers.image_count + graph.final_barriers.buffer_count > 0 ? 1u : 0u;
+  batches += graph.queue_release.image_count + graph.queue_release.buffer_count > 0;
+  for (u32 p = 0; p < graph.pass_count; ++p) {
+    culled += graph.passes[p].culled;
+    batches += graph.passes[p].barriers.image_count + graph.passes[p].barriers.buffer_count > 0;
+  }
+  ImGui::Text(
+      "%u passes (%u culled), %u images, %u buffers",
+      graph.pass_count,
+      culled,
+      graph.image_count,
+      graph.buffer_count);
+  ImGui::Text(
+      "%u image and %u buffer barriers in %u batches",
+      graph.image_barrier_count,
+      graph.buffer_barrier_count,
+      batches);
+  if (graph.async_wait_stages) {
+    char stages[128];
+    ImGui::Text(
+        "graphics waits for async compute at %s",
+        flags_to_string(stages, sizeof(stages), graph.async_wait_stages, stage_names, ARRAY_SIZE(stage_names)));
+  }
+  ImGui::Separator();
+
+  for (u32 p = 0; p < graph.pass_count; ++p) {
+    const auto& pass = graph.passes[p];
+    if (pass.culled) ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+    bool expanded = ImGui::TreeNodeEx(
+        (void*)(uintptr_t)p,
+        ImGuiTreeNodeFlags_DefaultOpen,
+        "%u %s%s%s%s",
+        p,
+        pass.name,
+        pass.queue == Render_Queue::async_compute ? " (async compute)" : "",
+        pass.cache_key ? " (cached)" : "",
+        pass.culled ? " (culled)" : "");
+    if (pass.culled) ImGui::PopStyleColor();
+    if (!expanded) continue;
+
+    for (u32 i = 0; i < pass.access_count; ++i) {
+      const auto& access = pass.accesses[i];
+      ImGui::Text(
+          "%s %s: %s",
+          access.is_buffer ? "buffer" : "image",
+          access.is_buffer ? graph.buffers[access.resource].name : graph.images[access.resource].name,
+          access.is_buffer ? buffer_usage_infos[access.usage].name : image_usage_infos[access.usage].name);
+    }
+    draw_barrier_batch(graph, pass.barriers);
+    ImGui::TreePop();
+  }
+
+  if (graph.final_barriers.image_count + graph.final_barriers.buffer_count > 0 &&
+      ImGui::TreeNodeEx("outputs", ImGuiTreeNodeFlags_DefaultOpen)) {
+    draw_barrier_batch(graph, graph.final_barriers);
+    ImGui::TreePop();
+  }
+  if (graph.queue_release.image_count + graph.queue_release.buffer_count > 0 &&
+      ImGui::TreeNodeEx("released by async compute", ImGuiTreeNodeFlags_DefaultOpen)) {
+    draw_barrier_batch(graph, graph.queue_release);
+    ImGui::TreePop();
+  }
+
+  const Transient_Heap* transients = graph.transients;
+  if (transients && transients->image_count > 0) {
+    ImGui::Separator();
+    const f64 mib = 1024.0 * 1024.0;
+    ImGui::Text(
+        "transient heap: %.2f MiB for %.2f MiB of images, %.2f MiB saved",
+        transients->used_size / mib,
+        transients->unaliased_size / mib,
+        ((f64)transients->unaliased_size - (f64)transients->used_size) / mib);
+    if (ImGui::BeginTable("transients", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+      ImGui::TableSetupColumn("image");
+      ImGui::TableSetupColumn("passes");
+      ImGui::TableSetupColumn("offset MiB");
+      ImGui::TableSetupColumn("size MiB");
+      ImGui::TableHeadersRow();
+      for (u32 i = 0; i < graph.image_count; ++i) {
+        const auto& image = graph.images[i];
+        if (image.transient_idx == (u32)-1) continue;
+        const auto& placed = transients->images[image.transient_idx];
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%s", image.name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%u - %u", image.first_pass, image.last_pass);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", placed.offset / mib);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", placed.size / mib);
+      }
+      ImGui::EndTable();
+    }
+  }
+  ImGui::End();
+}
@@ -0,0 +1,209 @@
+#pragma once
+#include "common.hpp"
+#include "defs.hpp"
+#include "transient_heap.hpp"
+
+struct GPU_Profiler;
+struct Pass_Cache;
+
+/// How a pass touches an image. Each usage maps to the stages, accesses and layout barriers are built from.
+enum struct Image_Usage : u32 {
+  undefined, // contents don't matter, only meaningful as the state an image enters or leaves the graph in.
+  acquired,  // straight from vkAcquireNextImageKHR, the acquire semaphore is waited on at color attachment output.
+  compute_read,
+  compute_write,
+  compute_read_write,
+  compute_sampled,
+  fragment_sampled,
+  transfer_src,
+  transfer_dst,
+  color_attachment,      // cleared or fully overwritten.
+  color_attachment_load, // blends over what is already there.
+  depth_attachment,
+  present,
+  count
+};
+
+enum struct Buffer_Usage : u32 {
+  none,
+  compute_read,
+  compute_write,
+  compute_read_write,
+  transfer_src,
+  transfer_dst,
+  indirect,
+  vertex,
+  index,
+  uniform,
+  host_read,
+  count
+};
+
+/// Async compute passes run ahead of the graphics ones: they are submitted first and graphics waits on them, so they
+/// can't use anything a graphics pass of the same graph touched before them. Without an async compute queue every
+/// pass runs on graphics.
+enum struct Render_Queue : u32 { graphics, async_compute, count };
+
+struct Graph_Image {
+  u32 idx = (u32)-1;
+};
+
+struct Graph_Buffer {
+  u32 idx = (u32)-1;
+};
+
+using Render_Pass_Fn = void (*)(VkCommandBuffer cmd, void* user_data);
+
+/// Rebuilt every frame: import the resources, add passes in submission order with what they read and write, then
+/// compile and execute. Compiling culls passes whose results nobody reads and turns the declared usages into the
+/// smallest set of barriers, one vkCmdPipelineBarrier2 in front of each pass that needs any.
+///
+/// Write only usages are assumed to overwrite the whole resource, so earlier writes to it that nobody reads in
+/// between get culled. Images and buffers with a final usage other than undefined/none are the graph's outputs.
+///
+/// Images created by the graph are transient: they live from the first to the last pass that survived culling and
+/// get placed in a Transient_Heap, sharing memory with the ones whose lifetimes don't overlap. Those touched by async
+/// compute live through the whole graph, both queues run at the same time. Images that have to keep their contents
+/// from one frame to the next, like a render target shown again by later frames, are imported instead.
+///
+/// Resources going from async compute to graphics get a queue family ownership transfer when the families differ:
+/// released at the end of the async compute work and acquired in front of the first graphics pass using them.
+struct Render_Graph {
+  static constexpr u32 MAX_PASSES   = 32;
+  static constexpr u32 MAX_IMAGES   = 32;
+  static constexpr u32 MAX_BUFFERS  = 32;
+  static constexpr u32 MAX_ACCESSES = 8; // per pass.
+  static constexpr u32 MAX_BARRIERS = MAX_PASSES * MAX_ACCESSES;
+
+  struct Image_Resource {
+    const char* name;
+    VkImage image;
+    VkImageAspectFlags aspect;
+    Image_Usage initial_usage;
+    Image_Usage final_usage;
+
+    bool transient;
+    Transient_Image_Desc desc;
+    VkImageView view;  // only known for transient images, once compiled.
+    u32 transient_idx; // in the heap, (u32)-1 if no pass that survived uses it.
+    u32 first_pass;
+    u32 last_pass;
+  } images[MAX_IMAGES];
+  u32 image_count;
+
+  struct Buffer_Resource {
+    const char* name;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    Buffer_Usage initial_usage;
+    Buffer_Usage final_usage;
+  } buffers[MAX_BUFFERS];
+  u32 buffer_count;
+
+  // usages of the same resource within a pass are merged into one access.
+  struct Access {
+    bool is_buffer;
+    u32 resource;
+    u32 usage; // Image_Usage or Buffer_Usage of the first declaration, for the debug view.
+    VkPipelineStageFlags2 stages;
+    VkAccessFlags2 access;
+    VkImageLayout layout;
+  };
+
+  // a batch of barriers, recorded in front of a pass or after the last one.
+  struct Barrier_Batch {
+    u32 first_image;
+    u32 image_count;
+    u32 first_buffer;
+    u32 buffer_count;
+  };
+
+  struct Pass {
+    const char* name;
+    Render_Pass_Fn execute;
+    void* user_data;
+    bool side_effects; // never culled, for passes whose results leave the graph another way (readbacks, ...).
+    Render_Queue queue;
+    u64 cache_key; // of the pass and its inputs, 0 records it every frame. see `render_graph_cache_pass`.
+    Access accesses[MAX_ACCESSES];
+    u32 access_count;
+
+    // filled by `render_graph_compile`.
+    bool culled;
+    Barrier_Batch barriers;
+  } passes[MAX_PASSES];
+  u32 pass_count;
+
+  VkImageMemoryBarrier2 image_barriers[MAX_BARRIERS];
+  u32 image_barrier_resources[MAX_BARRIERS]; // for the debug view.
+  u32 image_barrier_count;
+  VkBufferMemoryBarrier2 buffer_barriers[MAX_BARRIERS];
+  u32 buffer_barrier_resources[MAX_BARRIERS];
+  u32 buffer_barrier_count;
+  Barrier_Batch final_barriers; // moves the outputs into their final usage.
+  Barrier_Batch queue_release;  // ownership releases, recorded after the last async compute pass.
+  u32 queue_families[(u32)Render_Queue::count];
+  VkPipelineStageFlags2 async_wait_stages; // where graphics has to wait for async compute, 0 if it doesn't.
+  const Transient_Heap* transients;
+  bool compiled;
+};
+
+void render_graph_reset(Render_Graph& graph);
+
+Graph_Image render_graph_import_image(
+    Render_Graph& graph,
+    const char* name,
+    VkImage image,
+    VkImageAspectFlags aspect,
+    Image_Usage initial_usage,
+    Image_Usage final_usage);
+/// The image is created (and its memory shared) when compiling, see `render_graph_image`.
+Graph_Image render_graph_create_image(Render_Graph& graph, const char* name, const Transient_Image_Desc& desc);
+Graph_Buffer render_graph_import_buffer(
+    Render_Graph& graph,
+    const char* name,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    VkDeviceSize size,
+    Buffer_Usage initial_usage,
+    Buffer_Usage final_usage);
+
+/// Returns the pass index the usages are declared on.
+u32 render_graph_add_pass(
+    Render_Graph& graph,
+    const char* name,
+    Render_Pass_Fn execute,
+    void* user_data,
+    bool side_effects  = false,
+    Render_Queue queue = Render_Queue::graphics);
+void render_graph_use_image(Render_Graph& graph, u32 pass, Graph_Image image, Image_Usage usage);
+/// The pass records the same commands for as long as `inputs_hash` stays the same, so they are recorded once into a
+/// secondary command buffer of the frame slot's Pass_Cache and executed from there. The hash has to cover everything
+/// the commands reference, the barriers around the pass are still recorded every frame.
+void render_graph_cache_pass(Render_Graph& graph, u32 pass, u64 inputs_hash);
+void render_graph_use_buffer(Render_Graph& graph, u32 pass, Graph_Buffer buffer, Buffer_Usage usage);
+
+/// Places the transient images in `transients`, which has to be idle: wait for the last frame that used it first.
+/// Async compute passes move to graphics when the device has no async compute queue.
+void render_graph_compile(const Device& device, Render_Graph& graph, Transient_Heap& transients);
+
+/// Valid after compiling, transient images that got culled away have no image.
+VkImage render_graph_image(const Render_Graph& graph, Graph_Image image);
+VkImageView render_graph_image_view(const Render_Graph& graph, Graph_Image image);
+
+/// True if a pass that survived culling runs on `queue`, nothing has to be submitted there otherwise.
+bool render_graph_has_work(const Render_Graph& graph, Render_Queue queue);
+
+/// Records the passes of `queue` that survived culling with their barriers, each one in a gpu profiler scope if given
+/// one. `cmd` has to be submitted to that queue, graphics after async compute and waiting on it at
+/// `async_wait_stages`. Cached passes come from `cache` when given one, they are recorded into `cmd` otherwise.
+void render_graph_execute(
+    const Render_Graph& graph,
+    Render_Queue queue,
+    VkCommandBuffer cmd,
+    GPU_Profiler* profiler = nullptr,
+    Pass_Cache* cache      = nullptr);
+
+/// Shows the last compiled graph.
+void render_graph_draw_imgui(const Render_Graph& graph, bool* open);
@@ -0,0 +1,369 @@
+#include "shader_compiler.hpp"
+#include "core/common.hpp"
+#include "core/memory.hpp"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include "profile/profiler.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+struct Shader_Cache_Header {
+  u32 magic;
+  u32 version;
+  u64 key;  // what the module was compiled from.
+  u64 size; // of the spir-v after the header.
+};
+
+// bump when the compile options below change, modules built with the old ones are stale then.
+static constexpr u32 SHADER_OPTIONS_VERSION = 1;
+
+// the whole file, null when it can't be opened. free it with an `Allocator`.
+static u8* shader_read_file(const char* path, u64& size) {
+  FILE* fp = nullptr;
+  fopen_s(&fp, path, "rb");
+  if (!fp) return nullptr;
+  defer { fclose(fp); };
+
+  fseek(fp, 0L, SEEK_END);
+  size = (u64)ftell(fp);
+  rewind(fp);
+
+  Allocator allocator;
+  auto allocation = allocator.allocate_no_zero(size > 0 ? size : 4, 4);
+  assert(allocation.info == Allocation_Err::none);
+  size = fread(allocation.memory, 1, size, fp);
+  return (u8*)allocation.memory;
+}
+
+static const char* path_file_name(const char* path) {
+  const char* name = path;
+  for (const char* c = path; *c; ++c) {
+    if (*c == '/' || *c == '\\') name = c + 1;
+  }
+  return name;
+}
+
+// `name` relative to the directory `from` is in.
+static void path_sibling(char* out, u64 size, const char* from, const char* name) {
+  snprintf(out, size, "%.*s%s", (int)(path_file_name(from) - from), from, name);
+}
+
+// hashes everything `#include "..."` pulls in. a plain text scan, includes behind an #if count as well.
+static u64 shader_hash_includes(const char* path, const u8* source, u64 size, u64 hash, u32 depth) {
+  if (depth == Shader_Compiler::MAX_INCLUDE_DEPTH) return hash;
+
+  const char* c   = (const char*)source;
+  const char* end = c + size;
+  while (c < end) {
+    const char* line_end = (const char*)memchr(c, '\n', end - c);
+    if (!line_end) line_end = end;
+    while (c < line_end && (*c == ' ' || *c == '\t')) ++c;
+
+    const bool include = line_end - c > 8 && !memcmp(c, "#include", 8);
+    const char* open   = include ? (const char*)memchr(c, '"', line_end - c) : nullptr;
+    const char* close  = open ? (const char*)memchr(open + 1, '"', line_end - open - 1) : nullptr;
+    if (close) {
+      char name[Shader_Compiler::PATH_SIZE];
+      char include_path[Shader_Compiler::PATH_SIZE];
+      snprintf(name, sizeof(name), "%.*s", (int)(close - open - 1), open + 1);
+      path_sibling(include_path, sizeof(include_path), path, name);
+      hash = hash_bytes(name, strlen(name), hash);
+
+      u64 included_size = 0;
+      if (u8* included = shader_read_file(include_path, included_size)) {
+        Allocator allocator;
+        defer { allocator.free(included); };
+        hash = hash_bytes(included, included_size, hash);
+        hash = shader_hash_includes(include_path, included, included_size, hash, depth + 1);
+      }
+    }
+    c = line_end + 1;
+  }
+  return hash;
+}
+
+// one file per variant, compiling again replaces it instead of piling up old ones. the name is only there to be
+// read, the hash over the whole path and the defines tells same named sources in different directories apart.
+static void shader_cache_path(
+    const Shader_Compiler& compiler,
+    const char* path,
+    const char* defines,
+    char* out,
+    u64 size) {
+  u64 hash      = hash_bytes(path, strlen(path));
+  hash          = hash_bytes(defines, strlen(defines), hash);
+  const u32 tag = (u32)(hash ^ (hash >> 32));
+  snprintf(out, size, "%s/%s.%08x.spv", compiler.cache_dir, path_file_name(path), tag);
+}
+
+// `key` 0 takes the module whatever it was compiled from.
+static bool shader_cache_read(const char* cache_path, u64 key, Shader_Code& code) {
+  u64 size = 0;
+  u8* file = shader_read_file(cache_path, size);
+  if (!file) return false;
+  Allocator allocator;
+  defer { allocator.free(file); };
+
+  Shader_Cache_Header header;
+  if (size < sizeof(header)) return false;
+  memcpy(&header, file, sizeof(header));
+  if (header.magic != Shader_Compiler::MAGIC || header.version != Shader_Compiler::VERSION) return false;
+  if (header.size != size - sizeof(header) || header.size % sizeof(u32)) return false;
+  if (key && header.key != key) return false;
+
+  auto allocation = allocator.allocate_no_zero(header.size, sizeof(u32));
+  assert(allocation.info == Allocation_Err::none);
+  code.words = (u32*)allocation.memory;
+  code.size  = header.size;
+  memcpy(code.words, file + sizeof(header), header.size);
+  return true;
+}
+
+static void shader_cache_write(const char* cache_path, u64 key, const Shader_Code& code) {
+  char temp_path[Shader_Compiler::PATH_SIZE * 2];
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", cache_path);
+
+  Shader_Cache_Header header = {};
+  header.magic               = Shader_Compiler::MAGIC;
+  header.version             = Shader_Compiler::VERSION;
+  header.key                 = key;
+  header.size                = code.size;
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, temp_path, "wb");
+  if (!fp) {
+    log_warn("[shaders] unable to open %s for writing", temp_path);
+    return;
+  }
+  const bool written = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(code.words, 1, code.size, fp) == code.size;
+  const bool flushed = fflush(fp) == 0;
+  fclose(fp);
+
+  if (!written || !flushed || !os_replace_file(temp_path, cache_path)) {
+    log_warn("[shaders] failed to write %s", cache_path);
+    remove(temp_path);
+  }
+}
+
+static bool shader_read_spirv(const char* path, Shader_Code& code) {
+  u64 size = 0;
+  u8* file = shader_read_file(path, size);
+  if (!file) return false;
+  code.words = (u32*)file;
+  code.size  = size;
+  return true;
+}
+
+#if MINI_SHADER_COMPILER
+struct Shader_Include {
+  shaderc_include_result result;
+  char path[Shader_Compiler::PATH_SIZE];
+  u8* content;
+};
+
+// includes are relative to the file including them, there are no include directories.
+static shaderc_include_result* shader_include_resolve(
+    void* user_data,
+    const char* requested_source,
+    int type,
+    const char* requesting_source,
+    size_t include_depth) {
+  Allocator allocator;
+  auto include = (Shader_Include*)allocator.allocate(sizeof(Shader_Include), alignof(Shader_Include)).memory;
+  path_sibling(include->path, sizeof(include->path), requesting_source, requested_source);
+
+  u64 size         = 0;
+  include->content = shader_read_file(include->path, size);
+  if (include->content) {
+    include->result.source_name        = include->path;
+    include->result.source_name_length = strlen(include->path);
+    include->result.content            = (const char*)include->content;
+    include->result.content_length     = size;
+  } else {
+    // an empty name tells shaderc the include failed, the content is the error then.
+    snprintf(include->path, sizeof(include->path), "unable to open %s", requested_source);
+    include->result.source_name        = "";
+    include->result.source_name_length = 0;
+    include->result.content            = include->path;
+    include->result.content_length     = strlen(include->path);
+  }
+  include->result.user_data = include;
+  return &include->result;
+}
+
+static void shader_include_release(void* user_data, shaderc_include_result* result) {
+  auto include = (Shader_Include*)result->user_data;
+  Allocator allocator;
+  if (include->content) allocator.free(include->content);
+  allocator.free(include);
+}
+
+static shaderc_shader_kind shader_kind(const char* path) {
+  const char* extension = strrchr(path, '.');
+  if (extension && !strcmp(extension, ".vert")) return shaderc_vertex_shader;
+  if (extension && !strcmp(extension, ".frag")) return shaderc_fragment_shader;
+  return shaderc_compute_shader;
+}
+
+static bool shader_compile(
+    Shader_Compiler& compiler,
+    const char* path,
+    const u8* source,
+    u64 source_size,
+    const char* defines,
+    Shader_Code& code) {
+  PROFILE_SCOPE("compile shader");
+  shaderc_compile_options_t options = shaderc_compile_options_initialize();
+  defer { shaderc_compile_options_release(options); };
+  shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_3);
+  shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+  shaderc_compile_options_set_include_callbacks(options, shader_include_resolve, shader_include_release, nullptr);
+
+  for (const char* define = defines; *define;) {
+    const char* end = strchr(define, ';');
+    if (!end) end = define + strlen(define);
+    const char* equals   = (const char*)memchr(define, '=', end - define);
+    const char* name_end = equals ? equals : end;
+    const char* value    = equals ? equals + 1 : end;
+    if (name_end > define)
+      shaderc_compile_options_add_macro_definition(options, define, name_end - define, value, end - value);
+    define = *end ? end + 1 : end;
+  }
+
+  shaderc_compilation_result_t result = shaderc_compile_into_spv(
+      compiler.compiler,
+      (const char*)source,
+      source_size,
+      shader_kind(path),
+      path,
+      "main",
+      options);
+  defer { shaderc_result_release(result); };
+  if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
+    log_error("[shaders] %s failed to compile:\n%s", path, shaderc_result_get_error_message(result));
+    return false;
+  }
+
+  const u64 size = shaderc_result_get_length(result);
+  Allocator allocator;
+  auto allocation = allocator.allocate_no_zero(size > 0 ? size : 4, sizeof(u32));
+  assert(allocation.info == Allocation_Err::none);
+  code.words = (u32*)allocation.memory;
+  code.size  = size;
+  memcpy(code.words, shaderc_result_get_bytes(result), size);
+  return true;
+}
+#endif
+
+void create_shader_compiler(Shader_Compiler& compiler, const char* cache_dir, const char* spirv_dir) {
+  snprintf(compiler.cache_dir, sizeof(compiler.cache_dir), "%s", cache_dir);
+  snprintf(compiler.spirv_dir, sizeof(compiler.spirv_dir), "%s", spirv_dir);
+  compiler.hits.store(0, std::memory_order_relaxed);
+  compiler.compiled.store(0, std::memory_order_relaxed);
+  compiler.failed.store(0, std::memory_order_relaxed);
+  compiler.compiler_hash = hash_bytes(&SHADER_OPTIONS_VERSION, sizeof(u32));
+
+#if MINI_SHADER_COMPILER
+  if (!os_create_directory(cache_dir)) log_warn("[shaders] unable to create %s, nothing gets cached", cache_dir);
+
+  // shaderc has no version of its own to ask for, the spir-v it targets and its revision come closest.
+  unsigned int version = 0, revision = 0;
+  shaderc_get_spv_version(&version, &revision);
+  compiler.compiler      = shaderc_compiler_initialize();
+  compiler.compiler_hash = hash_bytes(&version, sizeof(version), compiler.compiler_hash);
+  compiler.compiler_hash = hash_bytes(&revision, sizeof(revision), compiler.compiler_hash);
+  log_info("[shaders] compiling glsl at runtime, cached in %s", cache_dir);
+#else
+  log_info("[shaders] loading cached spir-v from %s", cache_dir);
+#endif
+}
+
+void destroy_shader_compiler(Shader_Compiler& compiler) {
+  log_info(
+      "[shaders] %u cached, %u compiled, %u failed",
+      compiler.hits.load(),
+      compiler.compiled.load(),
+      compiler.failed.load());
+#if MINI_SHADER_COMPILER
+  shaderc_compiler_release(compiler.compiler);
+  compiler.compiler = nullptr;
+#endif
+}
+
+bool shader_is_glsl(const char* path) {
+  const char* extension = strrchr(path, '.');
+  if (!extension) return false;
+  return !strcmp(extension, ".comp") || !strcmp(extension, ".vert") || !strcmp(extension, ".frag");
+}
+
+bool shader_load(Shader_Compiler* compiler, const char* path, const char* defines, Shader_Code& code) {
+  code = {};
+  if (!defines) defines = "";
+  if (!shader_is_glsl(path)) {
+    if (shader_read_spirv(path, code)) return true;
+    log_error("[shaders] unable to open %s", path);
+    return false;
+  }
+  assert(compiler && "glsl needs a shader compiler");
+
+  char cache_path[Shader_Compiler::PATH_SIZE * 2];
+  shader_cache_path(*compiler, path, defines, cache_path, sizeof(cache_path));
+
+#if MINI_SHADER_COMPILER
+  u64 source_size = 0;
+  if (u8* source = shader_read_file(path, source_size)) {
+    Allocator allocator;
+    defer { allocator.free(source); };
+
+    u64 key = hash_bytes(source, source_size, compiler->compiler_hash);
+    key     = hash_bytes(defines, strlen(defines), key);
+    key     = shader_hash_includes(path, source, source_size, key, 0);
+    if (shader_cache_read(cache_path, key, code)) {
+      compiler->hits++;
+      return true;
+    }
+
+    const u64 begin = os_now_ticks();
+    if (shader_compile(*compiler, path, source, source_size, defines, code)) {
+      compiler->compiled++;
+      shader_cache_write(cache_path, key, code);
+      log_info(
+          "[shaders] compiled %s%s%s in %.3fms",
+          path,
+          *defines ? " with " : "",
+          defines,
+          os_ticks_to_ms(os_now_ticks() - begin));
+      return true;
+    }
+
+    // keep going with the last version that compiled, the error is in the log.
+    compiler->failed++;
+    if (shader_cache_read(cache_path, 0, code)) {
+      log_warn("[shaders] %s: using the last module that compiled", path);
+      return true;
+    }
+    return false;
+  }
+  log_warn("[shaders] unable to open %s, looking in the cache", path);
+#endif
+
+  if (shader_cache_read(cache_path, 0, code)) {
+    compiler->hits++;
+    return true;
+  }
+  if (!*defines) {
+    char spirv_path[Shader_Compiler::PATH_SIZE * 2];
+    snprintf(spirv_path, sizeof(spirv_path), "%s/%s.spv", compiler->spirv_dir, path_file_name(path));
+    if (shader_read_spirv(spirv_path, code)) return true;
+  }
+  compiler->failed++;
+  log_error("[shaders] no spir-v for %s%s%s", path, *defines ? " with " : "", defines);
+  return false;
+}
+
+void shader_code_free(Shader_Code& code) {
+  Allocator allocator;
+  if (code.words) allocator.free(code.words);
+  code = {};
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "defs.hpp"
+#include <atomic>
+
+// GLSL is compiled at runtime in debug builds, pass -DMINI_SHADER_COMPILER=1 (`build shaders`) to keep it in release.
+// Without it only SPIR-V that is already cached gets loaded.
+#if !defined(MINI_SHADER_COMPILER)
+#if defined(_DEBUG)
+#define MINI_SHADER_COMPILER 1
+#else
+#define MINI_SHADER_COMPILER 0
+#endif
+#endif
+
+#if MINI_SHADER_COMPILER
+#include <shaderc/shaderc.h>
+#endif
+
+/// Turns GLSL into SPIR-V through shaderc, cached on disk. Each variant (a source and its defines) has one cache file
+/// tagged with a hash of the source, everything it includes, the defines and the compiler version, it is only
+/// compiled again once that hash changes. Thread safe, the pipeline registry calls it from its workers.
+struct Shader_Compiler {
+  static constexpr u32 PATH_SIZE         = 256;
+  static constexpr u32 MAX_INCLUDE_DEPTH = 8;
+  static constexpr u32 MAGIC             = 0x5653434d; // "MCSV"
+  static constexpr u32 VERSION           = 1;
+
+  char cache_dir[PATH_SIZE];
+  // offline builds (`extra/kernel/build.bat`), variants without defines are looked up there when the cache has
+  // nothing and they can't be compiled.
+  char spirv_dir[PATH_SIZE];
+
+#if MINI_SHADER_COMPILER
+  shaderc_compiler_t compiler;
+#endif
+  u64 compiler_hash; // spir-v version and our options, either changing makes every cached module stale.
+
+  std::atomic<u32> hits;
+  std::atomic<u32> compiled;
+  std::atomic<u32> failed;
+};
+
+struct Shader_Code {
+  u32* words;
+  u64 size; // in bytes.
+};
+
+void create_shader_compiler(Shader_Compiler& compiler, const char* cache_dir, const char* spirv_dir);
+void destroy_shader_compiler(Shader_Compiler& compiler);
+
+/// True for the sources the compiler takes (.comp, .vert, .frag), anything else is loaded as SPIR-V.
+bool shader_is_glsl(const char* path);
+
+/// Loads the SPIR-V of `path`, compiling it first if it's GLSL that changed. `defines` is a `;` separated list of NAME
+/// or NAME=value. `compiler` may be null when only SPIR-V files are loaded. Free the code with `shader_code_free`.
+bool shader_load(Shader_Compiler* compiler, const char* path, const char* defines, Shader_Code& code);
+void shader_code_free(Shader_Code& code);
@@ -2,6 +2,8 @@
 #include "common.hpp"
 #include "core/common.hpp"
 #include "device.hpp"
+#include "log.hpp"
+#include "profile/profiler.hpp"
 #include <GLFW/glfw3.h>
 
 #if 0 // TODO
@@ -34,24 +36,39 @@ static void swapchain_acquire_next_image(Swapchain& swapchain) {
 
 #endif
 
-static void create_or_reinitialize_swapchain(Temp_Linear_Allocator arena, Device* device, Surface* surface) {
+const char* present_mode_name(Present_Mode mode) {
+  switch (mode) {
+    case Present_Mode::fifo: return "fifo";
+    case Present_Mode::mailbox: return "mailbox";
+    case Present_Mode::immediate: return "immediate";
+    case Present_Mode::count: break;
+  }
+  return "UNKNOWN_PRESENT_MODE";
+}
+
+// `width` and `height` are only used when the surface leaves the extent up to the swapchain.
+static bool create_or_reinitialize_swapchain(
+    Temp_Linear_Allocator arena,
+    Device* device,
+    Surface* surface,
+    s32 width,
+    s32 height,
+    Delay_Queue* retired,
+    u64 retire_value) {
   const auto old_num_images             = surface->num_images;
   VkSurfaceCapabilitiesKHR capabilities = {};
   VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->physical, surface->surface, &capabilities));
 
-  if (surface->swapchain != VK_NULL_HANDLE && capabilities.currentExtent.width == surface->width &&
-      capabilities.currentExtent.height == surface->height)
-    return;
-
-  s16 width  = surface->width;
-  s16 height = surface->height;
-
   if (capabilities.currentExtent.width != UINT32_MAX) {
     width  = capabilities.currentExtent.width;
     height = capabilities.currentExtent.height;
+  } else {
+    width  = clamp((u32)width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+    height = clamp((u32)height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
   }
 
-  if (surface->swapchain != VK_NULL_HANDLE && width == surface->width && height == surface->height) return;
+  // minimized, there's nothing to present to.
+  if (width == 0 || height == 0) return false;
 
   surface->width  = width;
   surface->height = height;
@@ -87,16 +104,31 @@ static void create_or_reinitialize_swapchain(Temp_Linear_Allocator arena, Device
   }
 
   if (!format_chosen) surface->format = formats[0];
-
-  VkPresentModeKHR chosen_present_mode = VK_PRESENT_MODE_FIFO_KHR;
-  // @NOTE: FIFO for smooth resize but dragging window is laggy
-  /*for (u32 i = 0; i < present_mode_count; ++i) {
-      const auto& mode = present_modes[i];
-      if (mode == VK_PRESENT_MODE_MAILBOX_KHR) chosen_present_mode = mode;
-  }*/
+  surface->readable = (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+
+  // fifo is the only mode every surface has to support.
+  const VkPresentModeKHR vk_present_modes[(u32)Present_Mode::count] = {
+    VK_PRESENT_MODE_FIFO_KHR,
+    VK_PRESENT_MODE_MAILBOX_KHR,
+    VK_PRESENT_MODE_IMMEDIATE_KHR,
+  };
+  for (u32 i = 0; i < (u32)Present_Mode::count; ++i) {
+    surface->present_mode_supported[i] = false;
+    for (u32 j = 0; j < present_mode_count; ++j) {
+      if (present_modes[j] == vk_present_modes[i]) surface->present_mode_supported[i] = true;
+    }
+  }
+  surface->vk_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+  if (surface->present_mode_supported[(u32)surface->present_mode]) {
+    surface->vk_present_mode = vk_present_modes[(u32)surface->present_mode];
+  } else {
+    log_warn("[surface] %s isn't supported, presenting with fifo", present_mode_name(surface->present_mode));
+  }
 
   constexpr u32 desired_image_count = 3;
-  const auto image_count = clamp(desired_image_count, capabilities.minImageCount, capabilities.maxImageCount);
+  // a max of 0 means there's none.
+  const u32 max_image_count = capabilities.maxImageCount ? capabilities.maxImageCount : desired_image_count;
+  const auto image_count    = clamp(desired_image_count, capabilities.minImageCount, max_image_count);
   // clamp here.
   // if (image_count < capabilities.minImageCount) image_count = capabilities.minImageCount;
   // if (image_count > capabilities.maxImageCount) image_count = capabilities.maxImageCount;
@@ -123,6 +155,7 @@ static void create_or_reinitialize_swapchain(Temp_Linear_Allocator arena, Device
   create_info.imageExtent           = { (u32)surface->width, (u32)surface->height };
   create_info.imageArrayLayers      = 1;
   create_info.imageUsage            = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (surface->readable) create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
   create_info.imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE;
   create_info.queueFamilyIndexCount = 0;
   create_info.pQueueFamilyIndices   = nullptr;
@@ -130,23 +163,21 @@ static void create_or_reinitialize_swapchain(Temp_Linear_Allocator arena, Device
                ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR
                : capabilities.currentTransform;
   create_info.compositeAlpha        = composite; // VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-  create_info.presentMode           = chosen_present_mode;
+  create_info.presentMode           = surface->vk_present_mode;
   create_info.clipped               = VK_TRUE;
   create_info.oldSwapchain          = surface->swapchain;
   VK_CHECK(vkCreateSwapchainKHR(device->logical, &create_info, device->allocator_callbacks, &surface->swapchain));
   arena.clear();
 
-  // @TODO: erase all resources without waiting for gpu to be idle
-  vkDeviceWaitIdle(device->logical);
-
-  // cleanup : required to safely destroy after creating new swapchain.
-  if (create_info.oldSwapchain != nullptr) {
-    for (u8 i = 0; i < old_num_images; ++i) {
-      vkDestroyImageView(device->logical, surface->image_views[i], device->allocator_callbacks);
-      vkDestroySemaphore(device->logical, surface->render_done[i], device->allocator_callbacks);
-      vkDestroySemaphore(device->logical, surface->image_avail[i], device->allocator_callbacks);
+  // the old swapchain is retired by now but frames in flight may still render to its images and present them, it
+  // goes once the gpu is past `retire_value`.
+  if (create_info.oldSwapchain != VK_NULL_HANDLE) {
+    assert(retired);
+    delay_queue_push(*retired, create_info.oldSwapchain, retire_value);
+    for (s8 i = 0; i < old_num_images; ++i) {
+      delay_queue_push(*retired, surface->image_views[i], retire_value);
+      delay_queue_push(*retired, surface->render_done[i], retire_value);
     }
-    vkDestroySwapchainKHR(device->logical, create_info.oldSwapchain, device->allocator_callbacks);
   }
 
   u32 num_images = surface->num_images;
@@ -191,39 +222,118 @@ static void create_or_reinitialize_swapchain(Temp_Linear_Allocator arena, Device
     VkSemaphoreCreateInfo semaphore_info{};
     semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    VK_CHECK(
-        vkCreateSemaphore(device->logical, &semaphore_info, device->allocator_callbacks, surface->image_avail + i));
     VK_CHECK(
         vkCreateSemaphore(device->logical, &semaphore_info, device->allocator_callbacks, surface->render_done + i));
   }
 
   // swapchain_acquire_next_image(swapchain);
+  return true;
 }
 
 Surface create_surface(Temp_Linear_Allocator arena, Device& device, GLFWwindow* window, s16 width, s16 height) {
   Surface surface;
   surface.surface = platform_create_vk_surface(window);
 
-  // Short should be enough since it goes up to 32k?
-  surface.width  = width;
-  surface.height = height;
-
   VkBool32 res = VK_FALSE;
   // I think we have to call this or we get a validation error.
   vkGetPhysicalDeviceSurfaceSupportKHR(device.physical, device.queue_family, surface.surface, &res);
   assert(res == VK_TRUE);
 
-  create_or_reinitialize_swapchain(arena, &device, &surface);
+  const bool created = create_or_reinitialize_swapchain(arena, &device, &surface, width, height, nullptr, 0);
+  assert(created && "window has no area");
+  UNUSED_VAR(created);
   return surface;
 }
 
+Surface create_headless_surface(Device& device, s32 width, s32 height) {
+  assert(width > 0 && height > 0);
+  Surface surface  = {};
+  surface.headless = true;
+  surface.readable = true;
+  surface.width    = width;
+  surface.height   = height;
+  surface.format   = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+
+  VkImageCreateInfo image_info = {};
+  image_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType         = VK_IMAGE_TYPE_2D;
+  image_info.format            = surface.format.format;
+  image_info.extent            = { (u32)width, (u32)height, 1 };
+  image_info.mipLevels         = 1;
+  image_info.arrayLayers       = 1;
+  image_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+  // what a swapchain image is created with, plus the readback.
+  image_info.usage =
+      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  image_info.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo allocation_info = {};
+  allocation_info.usage                   = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+  surface.num_images = Surface::MAX_IMAGES;
+  for (s8 i = 0; i < surface.num_images; ++i) {
+    VK_CHECK(vmaCreateImage(
+        device.allocator,
+        &image_info,
+        &allocation_info,
+        surface.images + i,
+        surface.image_allocations + i,
+        nullptr));
+
+    VkImageViewCreateInfo view_info           = {};
+    view_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image                           = surface.images[i];
+    view_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format                          = surface.format.format;
+    view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    view_info.subresourceRange.baseMipLevel   = 0;
+    view_info.subresourceRange.levelCount     = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount     = 1;
+    VK_CHECK(vkCreateImageView(device.logical, &view_info, device.allocator_callbacks, surface.image_views + i));
+    surface.render_done[i] = VK_NULL_HANDLE;
+  }
+
+  log_info("[surface] headless at %dx%d with %d images", width, height, surface.num_images);
+  return surface;
+}
+
+bool resize_surface(
+    Temp_Linear_Allocator arena,
+    Device& device,
+    Surface& surface,
+    s32 width,
+    s32 height,
+    Delay_Queue& retired,
+    u64 retire_value) {
+  PROFILE_FUNCTION();
+  assert(!surface.headless && "headless surfaces have a fixed size");
+  if (!create_or_reinitialize_swapchain(arena, &device, &surface, width, height, &retired, retire_value)) return false;
+  log_info(
+      "[surface] swapchain recreated at %dx%d with %d images, %s",
+      surface.width,
+      surface.height,
+      surface.num_images,
+      present_mode_name(surface.present_mode));
+  return true;
+}
+
 void destroy_surface(Device& device, Surface& surface) {
   vkDeviceWaitIdle(device.logical);
 
+  if (surface.headless) {
+    for (s8 i = 0; i < surface.num_images; ++i) {
+      vkDestroyImageView(device.logical, surface.image_views[i], device.allocator_callbacks);
+      vmaDestroyImage(device.allocator, surface.images[i], surface.image_allocations[i]);
+    }
+    return;
+  }
+
   // destroy swapchain resources
   for (s8 i = 0; i < surface.num_images; ++i) {
     vkDestroyImageView(device.logical, surface.image_views[i], device.allocator_callbacks);
-    vkDestroySemaphore(device.logical, surface.image_avail[i], device.allocator_callbacks);
     vkDestroySemaphore(device.logical, surface.render_done[i], device.allocator_callbacks);
   }
   vkDestroySwapchainKHR(device.logical, surface.swapchain, device.allocator_callbacks);
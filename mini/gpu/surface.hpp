@@ -7,6 +7,15 @@
 struct GLFWwindow;
 struct Device;
 
+enum struct Present_Mode : u32 {
+  fifo,      // waits for vblank, never tears.
+  mailbox,   // replaces the queued image on each present, never tears and never blocks.
+  immediate, // no waiting at all, tears.
+  count
+};
+
+const char* present_mode_name(Present_Mode mode);
+
 struct Surface {
   static constexpr auto MAX_IMAGES = 3;
 
@@ -21,14 +30,42 @@ struct Surface {
 
   VkSurfaceFormatKHR format = {};
 
+  // what the next swapchain is created with, modes the surface doesn't support fall back to fifo.
+  Present_Mode present_mode                             = Present_Mode::fifo;
+  VkPresentModeKHR vk_present_mode                      = VK_PRESENT_MODE_FIFO_KHR;
+  bool present_mode_supported[(u32)Present_Mode::count] = {};
+
+  // offscreen images instead of a swapchain, there's no acquire or present.
+  bool headless = false;
+  // images can be copied from, for captures.
+  bool readable = false;
+
   // FRAME STUFF
   VkImage images[MAX_IMAGES];
   VkImageView image_views[MAX_IMAGES];
-  VkSemaphore image_avail[MAX_IMAGES];
+  VmaAllocation image_allocations[MAX_IMAGES]; // headless only, swapchain images belong to the swapchain.
+  // indexed by the acquired image: it can only be acquired again once its last present consumed the semaphore.
+  // acquire semaphores belong to the frames in flight, the image index isn't known before acquiring.
   VkSemaphore render_done[MAX_IMAGES];
 
   s8 num_images = 0;
 };
 
 Surface create_surface(Temp_Linear_Allocator arena, Device& device, GLFWwindow* window, s16 width, s16 height);
+/// A ring of MAX_IMAGES offscreen images in the format a swapchain would pick, for running without a window. Frames
+/// take the next one in turn and leave it in transfer src for reading it back. Can't be resized.
+Surface create_headless_surface(Device& device, s32 width, s32 height);
+/// Recreates the swapchain for the window's current size and the surface's present mode with the old one as
+/// `oldSwapchain`, call it between frames with no image acquired. The old swapchain, its views and semaphores go to
+/// `retired` tagged with `retire_value`, the first graphics timeline value that can't have used them. Returns false
+/// without touching anything when the window has no area, try again later. `width` and `height` are only used if
+/// the surface doesn't dictate them.
+bool resize_surface(
+    Temp_Linear_Allocator arena,
+    Device& device,
+    Surface& surface,
+    s32 width,
+    s32 height,
+    Delay_Queue& retired,
+    u64 retire_value);
 void destroy_surface(Device& device, Surface& surface);
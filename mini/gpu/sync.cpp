@@ -1,123 +1,256 @@
 #include "sync.hpp"
-#include <cstring>
+#include "log.hpp"
+#include <cassert>
+#include <cstdlib>
+#include <thread>
 
-constexpr auto gpu_delay_info_stack_size = 1000;
-static Delay_Info gpu_delay_info_stack[gpu_delay_info_stack_size];
-static size_t gpu_delay_info_stack_ptr = 0;
+void create_timeline_semaphore(const Device& device, Timeline_Semaphore& timeline) {
+  VkSemaphoreTypeCreateInfo type_info = {};
+  type_info.sType                     = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  type_info.semaphoreType             = VK_SEMAPHORE_TYPE_TIMELINE;
+  type_info.initialValue              = 0;
 
-static void default_delay_queue_allocator_proc(Allocation_Parameters* params, Allocation_Result* result) {
-  assert(result);
-  assert(params);
-  assert(params->size == sizeof(Delay_Info));
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_info.pNext                 = &type_info;
+  VK_CHECK(vkCreateSemaphore(device.logical, &semaphore_info, device.allocator_callbacks, &timeline.semaphore));
+  timeline.submitted = 0;
+  timeline.completed = 0;
+}
 
-  result->info = Allocation_Err::none;
+void destroy_timeline_semaphore(const Device& device, Timeline_Semaphore& timeline) {
+  vkDestroySemaphore(device.logical, timeline.semaphore, device.allocator_callbacks);
+  timeline.semaphore = VK_NULL_HANDLE;
+}
 
-  assert(params->op == Allocation_Op::alloc || params->op != Allocation_Op::alloc_no_zero);
+u64 timeline_next_value(Timeline_Semaphore& timeline) {
+  return ++timeline.submitted;
+}
 
-  if (gpu_delay_info_stack_ptr >= gpu_delay_info_stack_size) {
-    result->info   = Allocation_Err::out_of_memory;
-    result->memory = nullptr;
-    return;
-  }
+bool timeline_is_complete(const Device& device, Timeline_Semaphore& timeline, u64 value) {
+  if (value <= timeline.completed) return true;
+  VK_CHECK(vkGetSemaphoreCounterValue(device.logical, timeline.semaphore, &timeline.completed));
+  return value <= timeline.completed;
+}
+
+void timeline_wait(const Device& device, Timeline_Semaphore& timeline, u64 value) {
+  if (timeline_is_complete(device, timeline, value)) return;
+  assert(value <= timeline.submitted && "waiting on a value nothing will signal");
+
+  VkSemaphoreWaitInfo wait_info = {};
+  wait_info.sType               = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.semaphoreCount      = 1;
+  wait_info.pSemaphores         = &timeline.semaphore;
+  wait_info.pValues             = &value;
+  VK_CHECK(vkWaitSemaphores(device.logical, &wait_info, UINT64_MAX));
+  timeline.completed = value;
+}
+
+void create_delay_queue(const Device& device, Delay_Queue& queue) {
+  queue.reserved.store(0, std::memory_order_relaxed);
+  queue.written[0].store(0, std::memory_order_relaxed);
+  queue.written[1].store(0, std::memory_order_relaxed);
+  for (auto& batch : queue.retired) batch.count = 0;
+  queue.overflow_lock.store(false, std::memory_order_relaxed);
+  queue.overflow          = nullptr;
+  queue.overflow_count    = 0;
+  queue.overflow_capacity = 0;
+
+  queue.instance            = device.instance;
+  queue.device              = device.logical;
+  queue.allocator           = device.allocator;
+  queue.allocator_callbacks = device.allocator_callbacks;
+}
+
+void destroy_delay_queue(Delay_Queue& queue) {
+  delay_queue_flush(queue);
+  assert(delay_queue_count(queue) == 0 && "pushed while being destroyed");
+  free(queue.overflow);
+  queue.overflow          = nullptr;
+  queue.overflow_capacity = 0;
+}
 
-  result->memory = (void*)(gpu_delay_info_stack + gpu_delay_info_stack_ptr++);
-  if (params->op == Allocation_Op::alloc) {
-    memset(result->memory, 0, params->size);
+static void delay_queue_lock_overflow(Delay_Queue& queue) {
+  while (queue.overflow_lock.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+}
+
+static void delay_queue_unlock_overflow(Delay_Queue& queue) {
+  queue.overflow_lock.store(false, std::memory_order_release);
+}
+
+static void delay_queue_push_generic(Delay_Queue& queue, GPU_Resource_Type type, u64 handle, u64 value) {
+  // the half is read from the same add that reserves the slot, so it can't change under the push.
+  const u64 reserved = queue.reserved.fetch_add(1, std::memory_order_acq_rel);
+  const u32 half     = (reserved & Delay_Queue::HALF_BIT) ? 1 : 0;
+  const u64 idx      = reserved & ~Delay_Queue::HALF_BIT;
+  Delay_Queue::Entry entry = {};
+  entry.handle             = handle;
+  entry.value              = value;
+  entry.type               = type;
+  if (idx < Delay_Queue::MAX_PENDING) {
+    queue.pending[half][idx] = entry;
+  } else {
+    // rare, a burst of destruction. the flush picks these up with the half it drains.
+    delay_queue_lock_overflow(queue);
+    if (queue.overflow_count == queue.overflow_capacity) {
+      const u32 capacity = queue.overflow_capacity ? queue.overflow_capacity * 2 : Delay_Queue::MAX_PENDING;
+      queue.overflow     = (Delay_Queue::Entry*)realloc(queue.overflow, capacity * sizeof(Delay_Queue::Entry));
+      assert(queue.overflow);
+      queue.overflow_capacity = capacity;
+    }
+    queue.overflow[queue.overflow_count++] = entry;
+    delay_queue_unlock_overflow(queue);
   }
+  queue.written[half].fetch_add(1, std::memory_order_release);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkPipeline pipeline, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Pipeline, (u64)pipeline, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkDescriptorPool pool, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Descriptor_Pool, (u64)pool, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkCommandPool pool, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Command_Pool, (u64)pool, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkImageView image_view, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Image_View, (u64)image_view, value);
 }
 
-Allocator default_delay_queue_allocator() {
-  Allocator allocator;
-  allocator.alloc_proc = default_delay_queue_allocator_proc;
-  allocator.user_ptr   = nullptr;
-  return allocator;
+void delay_queue_push(Delay_Queue& queue, VkBuffer buffer, VmaAllocation allocation, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Buffer, (u64)buffer, value);
+  if (allocation) delay_queue_push_generic(queue, GPU_Resource_Type::Allocation, (u64)allocation, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkImage image, VmaAllocation allocation, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Image, (u64)image, value);
+  if (allocation) delay_queue_push_generic(queue, GPU_Resource_Type::Allocation, (u64)allocation, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VmaAllocation allocation, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Allocation, (u64)allocation, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkSemaphore semaphore, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Semaphore, (u64)semaphore, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkFence fence, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Fence, (u64)fence, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkSwapchainKHR swapchain, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Swapchain, (u64)swapchain, value);
+}
+
+void delay_queue_push(Delay_Queue& queue, VkSurfaceKHR surface, u64 value) {
+  delay_queue_push_generic(queue, GPU_Resource_Type::Surface, (u64)surface, value);
 }
 
 // clang-format off
-static void delay_queue_proc(Delay_Info* info) {
-  switch (info->resource_type) {
+static void delay_queue_destroy(const Delay_Queue& queue, GPU_Resource_Type type, u64 handle) {
+  switch (type) {
+    case GPU_Resource_Type::Pipeline:
+      vkDestroyPipeline(queue.device, (VkPipeline)handle, queue.allocator_callbacks);
+      break;
+    case GPU_Resource_Type::Descriptor_Pool:
+      vkDestroyDescriptorPool(queue.device, (VkDescriptorPool)handle, queue.allocator_callbacks);
+      break;
+    case GPU_Resource_Type::Command_Pool:
+      vkDestroyCommandPool(queue.device, (VkCommandPool)handle, queue.allocator_callbacks);
+      break;
     case GPU_Resource_Type::Image_View:
-      vkDestroyImageView(info->device, (VkImageView)info->resource_ptr, info->allocator_callbacks);
+      vkDestroyImageView(queue.device, (VkImageView)handle, queue.allocator_callbacks);
+      break;
+    case GPU_Resource_Type::Buffer:
+      vkDestroyBuffer(queue.device, (VkBuffer)handle, queue.allocator_callbacks);
+      break;
+    case GPU_Resource_Type::Image:
+      vkDestroyImage(queue.device, (VkImage)handle, queue.allocator_callbacks);
+      break;
+    case GPU_Resource_Type::Allocation:
+      vmaFreeMemory(queue.allocator, (VmaAllocation)handle);
       break;
     case GPU_Resource_Type::Semaphore:
-      vkDestroySemaphore(info->device, (VkSemaphore)info->resource_ptr, info->allocator_callbacks);
+      vkDestroySemaphore(queue.device, (VkSemaphore)handle, queue.allocator_callbacks);
       break;
-    case GPU_Resource_Type::Fence: 
-      vkDestroyFence(info->device, (VkFence)info->resource_ptr, info->allocator_callbacks); 
+    case GPU_Resource_Type::Fence:
+      vkDestroyFence(queue.device, (VkFence)handle, queue.allocator_callbacks);
       break;
     case GPU_Resource_Type::Swapchain:
-      vkDestroySwapchainKHR(info->device, (VkSwapchainKHR)info->resource_ptr, info->allocator_callbacks);
+      vkDestroySwapchainKHR(queue.device, (VkSwapchainKHR)handle, queue.allocator_callbacks);
+      break;
+    case GPU_Resource_Type::Surface:
+      vkDestroySurfaceKHR(queue.instance, (VkSurfaceKHR)handle, queue.allocator_callbacks);
       break;
     default:
-      // not implemented yet.
       assert(false);
       break;
   }
 }
 // clang-format on
 
-void Delay_Queue::flush() {
-  auto node = head;
-  while (node) {
-    delay_queue_proc(node);
-    auto next = node->next;
-    // push (front) back into storage.
-    node->next = storage;
-    storage    = node;
-    node       = next;
+static void delay_queue_destroy_retired(Delay_Queue& queue, u64 completed) {
+  for (u32 type = 0; type < (u32)GPU_Resource_Type::count; ++type) {
+    auto& batch = queue.retired[type];
+    u32 kept    = 0;
+    for (u32 i = 0; i < batch.count; ++i) {
+      if (batch.values[i] <= completed) {
+        delay_queue_destroy(queue, (GPU_Resource_Type)type, batch.handles[i]);
+      } else {
+        batch.handles[kept]  = batch.handles[i];
+        batch.values[kept++] = batch.values[i];
+      }
+    }
+    batch.count = kept;
   }
-  head = nullptr;
 }
 
-Delay_Info* Delay_Queue::push_generic() {
-  Delay_Info* result = nullptr;
-  if (storage) {
-    // pop off the storage list
-    result  = storage;
-    storage = storage->next;
-  } else {
-    auto alloc_result = allocator.allocate_no_zero(sizeof(Delay_Info), alignof(Delay_Info));
-    assert(alloc_result.info != Allocation_Err::out_of_memory);
-    result = (Delay_Info*)alloc_result.memory;
+static void delay_queue_retire(Delay_Queue& queue, const Delay_Queue::Entry& entry) {
+  auto& batch = queue.retired[(u32)entry.type];
+  if (batch.count == Delay_Queue::MAX_RETIRED) {
+    // the gpu is too far behind for the batch to drain, stalling beats leaking.
+    log_error("[delay queue] more than %u retired of type %u, waiting for the device", batch.count, (u32)entry.type);
+    VK_CHECK(vkDeviceWaitIdle(queue.device));
+    delay_queue_destroy_retired(queue, ~0ull);
   }
-  assert(result);
-
-  // push to the top of the list (when we iterate forward it will be similar to a stack).
-  memset(result, 0, sizeof(Delay_Info));
-  result->next = head;
-  if (head) head->prev = result; // just to preserve next.
-
-  return result;
+  batch.handles[batch.count] = entry.handle;
+  batch.values[batch.count]  = entry.value;
+  batch.count++;
 }
 
-void Delay_Queue::push(VkDevice device, VkImageView image_view, const VkAllocationCallbacks* allocator_callbacks) {
-  auto node                 = push_generic();
-  node->resource_type       = GPU_Resource_Type::Image_View;
-  node->resource_ptr        = image_view;
-  node->device              = device;
-  node->allocator_callbacks = allocator_callbacks;
-}
+void delay_queue_flush(Delay_Queue& queue, u64 completed) {
+  // only flushes flip the half, pushes that reserved a slot in the old one before the flip are waited for, they're
+  // a few stores away from done.
+  const u64 reserved       = queue.reserved.load(std::memory_order_relaxed);
+  const u64 flipped        = (reserved & Delay_Queue::HALF_BIT) ^ Delay_Queue::HALF_BIT;
+  const u64 drained        = queue.reserved.exchange(flipped, std::memory_order_acq_rel);
+  const u32 half           = (drained & Delay_Queue::HALF_BIT) ? 1 : 0;
+  const u32 reserved_count = (u32)(drained & ~Delay_Queue::HALF_BIT);
+  while (queue.written[half].load(std::memory_order_acquire) != reserved_count) std::this_thread::yield();
 
-void Delay_Queue::push(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* allocator_callbacks) {
-  auto node                 = push_generic();
-  node->resource_type       = GPU_Resource_Type::Semaphore;
-  node->resource_ptr        = semaphore;
-  node->device              = device;
-  node->allocator_callbacks = allocator_callbacks;
-}
+  const u32 count = clamp(reserved_count, 0u, Delay_Queue::MAX_PENDING);
+  for (u32 i = 0; i < count; ++i) delay_queue_retire(queue, queue.pending[half][i]);
+  // no push can touch this half until the next flush flips back to it.
+  queue.written[half].store(0, std::memory_order_relaxed);
+
+  // pushes racing with the flush may already be in here, retiring them early is fine.
+  delay_queue_lock_overflow(queue);
+  const u32 overflow_count = queue.overflow_count;
+  for (u32 i = 0; i < overflow_count; ++i) delay_queue_retire(queue, queue.overflow[i]);
+  queue.overflow_count = 0;
+  delay_queue_unlock_overflow(queue);
+  if (overflow_count)
+    log_warn("[delay queue] %u pushes past the %u between two flushes", overflow_count, Delay_Queue::MAX_PENDING);
 
-void Delay_Queue::push(VkDevice device, VkFence fence, const VkAllocationCallbacks* allocator_callbacks) {
-  auto node                 = push_generic();
-  node->resource_type       = GPU_Resource_Type::Fence;
-  node->resource_ptr        = fence;
-  node->device              = device;
-  node->allocator_callbacks = allocator_callbacks;
+  delay_queue_destroy_retired(queue, completed);
 }
 
-void Delay_Queue::push(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks* allocator_callbacks) {
-  auto node                 = push_generic();
-  node->resource_type       = GPU_Resource_Type::Swapchain;
-  node->resource_ptr        = swapchain;
-  node->device              = device;
-  node->allocator_callbacks = allocator_callbacks;
+u32 delay_queue_count(const Delay_Queue& queue) {
+  u32 count = (u32)(queue.reserved.load(std::memory_order_relaxed) & ~Delay_Queue::HALF_BIT);
+  for (const auto& batch : queue.retired) count += batch.count;
+  return count;
 }
@@ -1,48 +1,101 @@
 #pragma once
 #include "common.hpp"
-#include "core/memory.hpp"
+#include "device.hpp"
+#include <atomic>
 
-enum struct GPU_Resource_Type {
-  // Buffer,
-  Image,
+/// One per queue. Every submission signals the next value, waiting for a value is how the cpu knows the gpu is done
+/// with a frame, so no per frame fences are needed.
+struct Timeline_Semaphore {
+  VkSemaphore semaphore;
+  u64 submitted; // last value handed to a submission.
+  u64 completed; // last value seen signaled, only refreshed by the calls below.
+};
+
+void create_timeline_semaphore(const Device& device, Timeline_Semaphore& timeline);
+void destroy_timeline_semaphore(const Device& device, Timeline_Semaphore& timeline);
+
+/// The value the next submission has to signal.
+u64 timeline_next_value(Timeline_Semaphore& timeline);
+bool timeline_is_complete(const Device& device, Timeline_Semaphore& timeline, u64 value);
+/// Returns right away if `value` is already known to be signaled.
+void timeline_wait(const Device& device, Timeline_Semaphore& timeline, u64 value);
+
+// in the order a flush destroys them, whatever uses a resource goes before it.
+enum struct GPU_Resource_Type : u32 {
+  Pipeline,
+  Descriptor_Pool,
+  Command_Pool,
   Image_View,
+  Buffer,
+  Image,
+  Allocation,
   Semaphore,
   Fence,
-  Command_Pool,
-  Surface,
   Swapchain,
+  Surface,
+  count
 };
 
-/// This struct may be too huge right now? we can probably reduce it more.
-/// This instance is always the same and the ... are always the same.
-struct Delay_Info {
-  void* resource_ptr                               = nullptr;
-  VkInstance instance                              = VK_NULL_HANDLE;
-  VkDevice device                                  = VK_NULL_HANDLE;
-  VmaAllocator allocator                           = VK_NULL_HANDLE;
-  const VkAllocationCallbacks* allocator_callbacks = nullptr;
-  // probably shouldn't be accessed by the user?
-  Delay_Info* next;
-  Delay_Info* prev;
-  GPU_Resource_Type resource_type;
-  u32 pad;
-};
+/// Resources the gpu may still use, each tagged with the timeline value after which nothing does anymore. Pushing
+/// is lock-free (below MAX_PENDING) and safe from any thread, flushing only from one thread at a time.
+///
+/// Pushes reserve a slot in one of two pending halves with a single atomic add, a flush swaps the halves and moves
+/// what was pushed into per type batches of handles and values, the device is only stored once. VMA images and
+/// buffers are pushed as the resource and its allocation, the allocation is freed after the resource is destroyed.
+///
+/// Neither limit drops anything: pushes past MAX_PENDING go to a heap array behind a spin lock, and a flush that
+/// finds a type's batch full waits for the device to go idle and destroys everything retired so far.
+struct Delay_Queue {
+  static constexpr u32 MAX_PENDING = 1 << 12; // pushes between two flushes before the slow path.
+  static constexpr u32 MAX_RETIRED = 1 << 10; // per type, waiting for the gpu.
+  static constexpr u64 HALF_BIT    = 1ull << 63;
 
-Allocator default_delay_queue_allocator();
+  struct Entry {
+    u64 handle;
+    u64 value;
+    GPU_Resource_Type type;
+  };
 
-struct Delay_Queue {
-  void flush();
+  Entry pending[2][MAX_PENDING];
+  std::atomic<u64> reserved; // `HALF_BIT` set when pushes go to the second half, the rest counts them.
+  std::atomic<u32> written[2];
+
+  // pushes that found their half full, from either half. grown as needed, freed by `destroy_delay_queue`.
+  std::atomic<bool> overflow_lock;
+  Entry* overflow;
+  u32 overflow_count;
+  u32 overflow_capacity;
+
+  struct Batch {
+    u64 handles[MAX_RETIRED];
+    u64 values[MAX_RETIRED];
+    u32 count;
+  } retired[(u32)GPU_Resource_Type::count];
+
+  VkInstance instance;
+  VkDevice device;
+  VmaAllocator allocator;
+  const VkAllocationCallbacks* allocator_callbacks;
+};
 
-  void push(VkDevice device, VkImageView image_view, const VkAllocationCallbacks* allocator_callbacks);
-  void push(VkDevice device, VkSemaphore semaphore, const VkAllocationCallbacks* allocator_callbacks);
-  void push(VkDevice device, VkFence fence, const VkAllocationCallbacks* allocator_callbacks);
-  void push(VkDevice device, VkSwapchainKHR swapchain, const VkAllocationCallbacks* allocator_callbacks);
+void create_delay_queue(const Device& device, Delay_Queue& queue);
+/// Destroys everything right away, the gpu has to be done with it.
+void destroy_delay_queue(Delay_Queue& queue);
 
-  Allocator allocator = default_delay_queue_allocator();
+void delay_queue_push(Delay_Queue& queue, VkPipeline pipeline, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkDescriptorPool pool, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkCommandPool pool, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkImageView image_view, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkBuffer buffer, VmaAllocation allocation, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkImage image, VmaAllocation allocation, u64 value);
+void delay_queue_push(Delay_Queue& queue, VmaAllocation allocation, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkSemaphore semaphore, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkFence fence, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkSwapchainKHR swapchain, u64 value);
+void delay_queue_push(Delay_Queue& queue, VkSurfaceKHR surface, u64 value);
 
-private:
-  Delay_Info* push_generic();
+/// Destroys what was pushed with a value up to `completed`, everything by default.
+void delay_queue_flush(Delay_Queue& queue, u64 completed = ~0ull);
 
-  Delay_Info* head    = nullptr;
-  Delay_Info* storage = nullptr;
-};
\ No newline at end of file
+/// Pushed and not destroyed yet, a flush picks up pushes racing with it the next time.
+u32 delay_queue_count(const Delay_Queue& queue);
@@ -0,0 +1,183 @@
+#include "transient_heap.hpp"
+#include "core/common.hpp"
+#include "log.hpp"
+#include "profile/profiler.hpp"
+#include <cassert>
+#include <cstring>
+
+static VkImageCreateInfo transient_image_info(const Transient_Image_Desc& desc) {
+  VkImageCreateInfo info = {};
+  info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  info.imageType         = VK_IMAGE_TYPE_2D;
+  info.format            = desc.format;
+  info.extent            = desc.extent;
+  info.mipLevels         = 1;
+  info.arrayLayers       = 1;
+  info.samples           = VK_SAMPLE_COUNT_1_BIT;
+  info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+  info.usage             = desc.usage;
+  info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+  info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+  return info;
+}
+
+VkImageAspectFlags transient_image_aspect(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_D16_UNORM:
+  case VK_FORMAT_X8_D24_UNORM_PACK32:
+  case VK_FORMAT_D32_SFLOAT: return VK_IMAGE_ASPECT_DEPTH_BIT;
+  case VK_FORMAT_D16_UNORM_S8_UINT:
+  case VK_FORMAT_D24_UNORM_S8_UINT:
+  case VK_FORMAT_D32_SFLOAT_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+  default: return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+static bool lifetimes_overlap(const Transient_Request& a, const Transient_Request& b) {
+  return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+}
+
+static void transient_heap_release_images(const Device& device, Transient_Heap& heap) {
+  for (u32 i = 0; i < heap.image_count; ++i) {
+    vkDestroyImageView(device.logical, heap.images[i].view, device.allocator_callbacks);
+    vkDestroyImage(device.logical, heap.images[i].image, device.allocator_callbacks);
+  }
+  heap.image_count = 0;
+}
+
+void create_transient_heap(Transient_Heap& heap) {
+  memset(&heap, 0, sizeof(heap));
+}
+
+void destroy_transient_heap(const Device& device, Transient_Heap& heap) {
+  transient_heap_release_images(device, heap);
+  if (heap.allocation) vmaFreeMemory(device.allocator, heap.allocation);
+  heap.allocation      = VK_NULL_HANDLE;
+  heap.allocation_size = 0;
+}
+
+bool transient_heap_overlaps(const Transient_Heap& heap, u32 a, u32 b) {
+  const auto& x = heap.images[a];
+  const auto& y = heap.images[b];
+  return x.offset < y.offset + y.size && y.offset < x.offset + x.size;
+}
+
+void transient_heap_place(const Device& device, Transient_Heap& heap, const Transient_Request* requests, u32 count) {
+  assert(count <= Transient_Heap::MAX_IMAGES);
+  const u64 hash = hash_bytes(requests, sizeof(Transient_Request) * count, hash_bytes(&count, sizeof(count)));
+  if (hash == heap.requests_hash) return;
+
+  PROFILE_FUNCTION();
+  transient_heap_release_images(device, heap);
+  heap.requests_hash = hash;
+  heap.generation++;
+
+  VkMemoryRequirements requirements[Transient_Heap::MAX_IMAGES];
+  VkDeviceSize alignment = 1;
+  u32 type_bits          = ~0u;
+  heap.unaliased_size    = 0;
+  for (u32 i = 0; i < count; ++i) {
+    VkImageCreateInfo image_info = transient_image_info(requests[i].desc);
+
+    VkDeviceImageMemoryRequirements requirements_info = {};
+    requirements_info.sType                           = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS;
+    requirements_info.pCreateInfo                     = &image_info;
+
+    VkMemoryRequirements2 image_requirements = {};
+    image_requirements.sType                 = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    vkGetDeviceImageMemoryRequirements(device.logical, &requirements_info, &image_requirements);
+
+    requirements[i] = image_requirements.memoryRequirements;
+    type_bits &= requirements[i].memoryTypeBits;
+    if (requirements[i].alignment > alignment) alignment = requirements[i].alignment;
+    heap.unaliased_size = align_forward(heap.unaliased_size, requirements[i].alignment) + requirements[i].size;
+  }
+  assert(type_bits != 0 && "transient images have no memory type in common");
+
+  // biggest first, each one goes to the lowest offset that doesn't collide with an image alive at the same time.
+  u32 order[Transient_Heap::MAX_IMAGES];
+  for (u32 i = 0; i < count; ++i) {
+    u32 j = i;
+    for (; j > 0 && requirements[order[j - 1]].size < requirements[i].size; --j) order[j] = order[j - 1];
+    order[j] = i;
+  }
+
+  heap.used_size = 0;
+  for (u32 k = 0; k < count; ++k) {
+    const u32 i             = order[k];
+    const VkDeviceSize size = requirements[i].size;
+    VkDeviceSize offset     = 0;
+    for (bool moved = true; moved;) {
+      moved  = false;
+      offset = align_forward(offset, requirements[i].alignment);
+      for (u32 p = 0; p < k; ++p) {
+        const u32 j         = order[p];
+        const auto& placed  = heap.images[j];
+        const bool collides = offset < placed.offset + placed.size && placed.offset < offset + size;
+        if (!collides || !lifetimes_overlap(requests[i], requests[j])) continue;
+        offset = placed.offset + placed.size;
+        moved  = true;
+      }
+    }
+    heap.images[i].offset = offset;
+    heap.images[i].size   = size;
+    if (offset + size > heap.used_size) heap.used_size = offset + size;
+  }
+
+  // keep the allocation as long as everything still fits.
+  if (heap.allocation) {
+    VmaAllocationInfo allocation_info;
+    vmaGetAllocationInfo(device.allocator, heap.allocation, &allocation_info);
+    const bool type_ok = (type_bits >> allocation_info.memoryType) & 1;
+    if (!type_ok || heap.used_size > heap.allocation_size) {
+      vmaFreeMemory(device.allocator, heap.allocation);
+      heap.allocation      = VK_NULL_HANDLE;
+      heap.allocation_size = 0;
+    }
+  }
+  if (!heap.allocation && heap.used_size > 0) {
+    VkMemoryRequirements heap_requirements = {};
+    heap_requirements.size                 = heap.used_size;
+    heap_requirements.alignment            = alignment;
+    heap_requirements.memoryTypeBits       = type_bits;
+
+    VmaAllocationCreateInfo allocation_create_info = {};
+    allocation_create_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+    allocation_create_info.requiredFlags           = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    VK_CHECK(vmaAllocateMemory(
+        device.allocator,
+        &heap_requirements,
+        &allocation_create_info,
+        &heap.allocation,
+        nullptr));
+    heap.allocation_size = heap.used_size;
+  }
+
+  for (u32 i = 0; i < count; ++i) {
+    auto& placed                 = heap.images[i];
+    VkImageCreateInfo image_info = transient_image_info(requests[i].desc);
+    VK_CHECK(vmaCreateAliasingImage2(device.allocator, heap.allocation, placed.offset, &image_info, &placed.image));
+
+    VkImageViewCreateInfo view_info           = {};
+    view_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.image                           = placed.image;
+    view_info.format                          = requests[i].desc.format;
+    view_info.subresourceRange.aspectMask     = transient_image_aspect(requests[i].desc.format);
+    view_info.subresourceRange.baseMipLevel   = 0;
+    view_info.subresourceRange.levelCount     = 1;
+    view_info.subresourceRange.baseArrayLayer = 0;
+    view_info.subresourceRange.layerCount     = 1;
+    VK_CHECK(vkCreateImageView(device.logical, &view_info, device.allocator_callbacks, &placed.view));
+
+    heap.requests[i] = requests[i];
+  }
+  heap.image_count = count;
+
+  log_info(
+      "[transient] %u images, %.2f MiB placed in %.2f MiB, aliasing saves %.2f MiB",
+      count,
+      heap.unaliased_size / (1024.0 * 1024.0),
+      heap.used_size / (1024.0 * 1024.0),
+      ((f64)heap.unaliased_size - (f64)heap.used_size) / (1024.0 * 1024.0));
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "common.hpp"
+#include "device.hpp"
+
+/// A 2d image with a single mip and layer that only lives within one frame's render graph.
+struct Transient_Image_Desc {
+  VkFormat format;
+  VkExtent3D extent;
+  VkImageUsageFlags usage;
+};
+
+VkImageAspectFlags transient_image_aspect(VkFormat format);
+
+/// `first_pass` and `last_pass` are the first and last pass (inclusive) that touch the image.
+struct Transient_Request {
+  Transient_Image_Desc desc;
+  u32 first_pass;
+  u32 last_pass;
+};
+
+/// One VMA allocation that every transient image of a frame is placed in with `vmaCreateAliasingImage2`. Images
+/// whose pass ranges don't overlap share memory. The placement and the images are kept until the requests change,
+/// so a frame that declares the same graph as last time costs a hash.
+///
+/// The heap is reused by every frame that runs in the same frame slot, so there is one per frame in flight.
+struct Transient_Heap {
+  static constexpr u32 MAX_IMAGES = 32;
+
+  VmaAllocation allocation;
+  VkDeviceSize allocation_size;
+  u32 memory_type_bits;
+
+  struct Placed_Image {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    VkImage image;
+    VkImageView view;
+  } images[MAX_IMAGES];
+  Transient_Request requests[MAX_IMAGES];
+  u32 image_count;
+
+  u64 requests_hash;
+  u32 generation; // bumped every time the images are recreated, whoever caches views has to refresh them.
+
+  VkDeviceSize used_size;      // end of the furthest placed image.
+  VkDeviceSize unaliased_size; // what giving every image its own memory would take.
+};
+
+void create_transient_heap(Transient_Heap& heap);
+void destroy_transient_heap(const Device& device, Transient_Heap& heap);
+
+/// Makes `heap.images[i]` match `requests[i]`. Only call once the gpu is done with the last frame that used the heap,
+/// images get destroyed when the requests change.
+void transient_heap_place(const Device& device, Transient_Heap& heap, const Transient_Request* requests, u32 count);
+
+/// Two images share memory if this is true for them.
+bool transient_heap_overlaps(const Transient_Heap& heap, u32 a, u32 b);
@@ -0,0 +1,492 @@
+#include "upload.hpp"
+#include "core/common.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include "profile/profiler.hpp"
+#include <cassert>
+#include <cstring>
+
+static bool upload_transfers_ownership(const Upload_Manager& uploads) {
+  return uploads.queue_family != uploads.graphics_family;
+}
+
+static Upload_Manager::Batch& upload_batch(Upload_Manager& uploads, u64 value) {
+  return uploads.batches[value % Upload_Manager::MAX_BATCHES];
+}
+
+// moves the tail past every batch the gpu is done with, stops early when their acquires don't fit anymore.
+static void upload_retire(const Device& device, Upload_Manager& uploads) {
+  while (uploads.retired < uploads.timeline.submitted) {
+    const u64 value = uploads.retired + 1;
+    if (!timeline_is_complete(device, uploads.timeline, value)) break;
+
+    auto& batch = upload_batch(uploads, value);
+    if (upload_transfers_ownership(uploads)) {
+      if (uploads.buffer_acquire_count + batch.buffer_copy_count > Upload_Manager::MAX_ACQUIRES) break;
+      if (uploads.image_acquire_count + batch.image_copy_count > Upload_Manager::MAX_ACQUIRES) break;
+
+      // same barriers as the release, the layout transition only happens once.
+      for (u32 i = 0; i < batch.buffer_copy_count; ++i) {
+        const auto& copy               = batch.buffer_copies[i];
+        VkBufferMemoryBarrier2 barrier = {};
+        barrier.sType                  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        barrier.srcStageMask           = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstStageMask           = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask          = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+        barrier.srcQueueFamilyIndex    = uploads.queue_family;
+        barrier.dstQueueFamilyIndex    = uploads.graphics_family;
+        barrier.buffer                 = copy.buffer;
+        barrier.offset                 = copy.region.dstOffset;
+        barrier.size                   = copy.region.size;
+
+        uploads.buffer_acquires[uploads.buffer_acquire_count++] = barrier;
+      }
+      for (u32 i = 0; i < batch.image_copy_count; ++i) {
+        const auto& copy                        = batch.image_copies[i];
+        VkImageMemoryBarrier2 barrier           = {};
+        barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask                    = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstStageMask                    = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        barrier.dstAccessMask                   = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+        barrier.oldLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout                       = copy.final_layout;
+        barrier.srcQueueFamilyIndex             = uploads.queue_family;
+        barrier.dstQueueFamilyIndex             = uploads.graphics_family;
+        barrier.image                           = copy.image;
+        barrier.subresourceRange.aspectMask     = copy.region.imageSubresource.aspectMask;
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.levelCount     = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount     = 1;
+
+        uploads.image_acquires[uploads.image_acquire_count++] = barrier;
+      }
+    }
+
+    auto& stats      = uploads.stats;
+    stats.latency_ms = os_ticks_to_ms(os_now_ticks() - batch.submit_ticks);
+    stats.window_bytes += batch.bytes;
+    uploads.tail    = batch.ring_end;
+    uploads.retired = value;
+  }
+}
+
+// blocks until the oldest batch in flight is retired. fails when that can't happen before the next `upload_acquire`,
+// the acquires of every finished batch have to be recorded before more of them fit.
+static bool upload_stall(const Device& device, Upload_Manager& uploads) {
+  PROFILE_SCOPE("upload stall");
+  if (uploads.retired == uploads.timeline.submitted) {
+    log_error("[upload] nothing in flight to wait for");
+    return false;
+  }
+  const u64 begin = os_now_ticks();
+  timeline_wait(device, uploads.timeline, uploads.retired + 1);
+
+  const u64 retired = uploads.retired;
+  upload_retire(device, uploads);
+  uploads.stats.stalls++;
+  uploads.stats.stall_ms += os_ticks_to_ms(os_now_ticks() - begin);
+  if (uploads.retired == retired) {
+    log_error("[upload] more uploads than fit until the next upload_acquire, dropping one");
+    return false;
+  }
+  return true;
+}
+
+// nullptr when the slot can't be freed, see `upload_stall`.
+static Upload_Manager::Batch* upload_open_batch(const Device& device, Upload_Manager& uploads) {
+  const u64 value = uploads.timeline.submitted + 1;
+  auto& batch     = upload_batch(uploads, value);
+  if (uploads.batch_open) return &batch;
+
+  // the slot still holds the batch from MAX_BATCHES submissions ago.
+  upload_retire(device, uploads);
+  while (value > uploads.retired + Upload_Manager::MAX_BATCHES)
+    if (!upload_stall(device, uploads)) return nullptr;
+
+  batch.value             = value;
+  batch.bytes             = 0;
+  batch.buffer_copy_count = 0;
+  batch.image_copy_count  = 0;
+  uploads.batch_open      = true;
+  return &batch;
+}
+
+// finds the staging offset `size` bytes can be written at, waiting for the gpu to free some if needed. fails like
+// `upload_stall`.
+static bool upload_reserve(const Device& device, Upload_Manager& uploads, VkDeviceSize size, VkDeviceSize* offset) {
+  assert(size <= uploads.staging_size && "upload bigger than the staging ring");
+  for (;;) {
+    // an allocation never wraps, the end of the ring gets skipped instead. an empty ring starts over at 0.
+    if (uploads.head == uploads.tail) {
+      uploads.head += (uploads.staging_size - uploads.head % uploads.staging_size) % uploads.staging_size;
+      uploads.tail = uploads.head;
+    }
+    u64 head                  = align_forward(uploads.head, Upload_Manager::ALIGNMENT);
+    const VkDeviceSize wrap = head % uploads.staging_size;
+    if (wrap + size > uploads.staging_size) head += uploads.staging_size - wrap;
+
+    if (head + size - uploads.tail <= uploads.staging_size) {
+      uploads.head              = head + size;
+      const VkDeviceSize in_use = uploads.head - uploads.tail;
+      if (in_use > uploads.stats.peak_in_use) uploads.stats.peak_in_use = in_use;
+      *offset = head % uploads.staging_size;
+      return true;
+    }
+
+    upload_retire(device, uploads);
+    if (head + size - uploads.tail <= uploads.staging_size) continue;
+
+    // nothing in flight means the open batch itself holds the ring.
+    if (uploads.retired == uploads.timeline.submitted) {
+      upload_flush(device, uploads);
+      if (!upload_open_batch(device, uploads)) return false;
+    }
+    if (!upload_stall(device, uploads)) return false;
+  }
+}
+
+static void upload_write(
+    const Device& device,
+    Upload_Manager& uploads,
+    VkDeviceSize offset,
+    const void* data,
+    VkDeviceSize size) {
+  memcpy(uploads.staging_data + offset, data, size);
+  // no-op on coherent memory.
+  VK_CHECK(vmaFlushAllocation(device.allocator, uploads.staging_allocation, offset, size));
+}
+
+void create_upload_manager(const Device& device, Upload_Manager& uploads, VkDeviceSize staging_size) {
+  memset(&uploads, 0, sizeof(uploads));
+  uploads.queue           = device.transfer_queue;
+  uploads.queue_family    = device.transfer_queue_family;
+  uploads.graphics_family = device.queue_family;
+  uploads.staging_size    = staging_size;
+  create_timeline_semaphore(device, uploads.timeline);
+
+  VkBufferCreateInfo buffer_info = {};
+  buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size               = staging_size;
+  buffer_info.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+  VmaAllocationCreateInfo allocation_info = {};
+  allocation_info.usage                   = VMA_MEMORY_USAGE_AUTO;
+  allocation_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+  VmaAllocationInfo staging_info;
+  VK_CHECK(vmaCreateBuffer(
+      device.allocator,
+      &buffer_info,
+      &allocation_info,
+      &uploads.staging,
+      &uploads.staging_allocation,
+      &staging_info));
+  uploads.staging_data = (u8*)staging_info.pMappedData;
+  assert(uploads.staging_data);
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex        = uploads.queue_family;
+  for (u32 i = 0; i < Upload_Manager::MAX_BATCHES; ++i) {
+    auto& batch = uploads.batches[i];
+    VK_CHECK(vkCreateCommandPool(device.logical, &pool_info, device.allocator_callbacks, &batch.command_pool));
+
+    VkCommandBufferAllocateInfo command_buffer_info = {};
+    command_buffer_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    command_buffer_info.commandPool                 = batch.command_pool;
+    command_buffer_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    command_buffer_info.commandBufferCount          = 1;
+    VK_CHECK(vkAllocateCommandBuffers(device.logical, &command_buffer_info, &batch.command_buffer));
+  }
+
+  uploads.stats.window_begin_ticks = os_now_ticks();
+  log_info(
+      "[upload] %.1f MiB staging on the %s queue",
+      staging_size / (1024.0 * 1024.0),
+      device.dedicated_transfer ? "transfer" : "graphics");
+}
+
+void destroy_upload_manager(const Device& device, Upload_Manager& uploads) {
+  upload_flush(device, uploads);
+  timeline_wait(device, uploads.timeline, uploads.timeline.submitted);
+  for (u32 i = 0; i < Upload_Manager::MAX_BATCHES; ++i)
+    vkDestroyCommandPool(device.logical, uploads.batches[i].command_pool, device.allocator_callbacks);
+  vmaDestroyBuffer(device.allocator, uploads.staging, uploads.staging_allocation);
+  destroy_timeline_semaphore(device, uploads.timeline);
+}
+
+u64 upload_buffer(
+    const Device& device,
+    Upload_Manager& uploads,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    const void* data,
+    VkDeviceSize size) {
+  auto* batch = upload_open_batch(device, uploads);
+  if (batch && batch->buffer_copy_count == Upload_Manager::MAX_COPIES) {
+    upload_flush(device, uploads);
+    batch = upload_open_batch(device, uploads);
+  }
+
+  VkDeviceSize staging_offset = 0;
+  if (!batch || !upload_reserve(device, uploads, size, &staging_offset)) return 0;
+  batch = upload_open_batch(device, uploads); // reserving may have flushed it.
+  if (!batch) return 0;
+  upload_write(device, uploads, staging_offset, data, size);
+
+  auto& copy            = batch->buffer_copies[batch->buffer_copy_count++];
+  copy.buffer           = buffer;
+  copy.region.srcOffset = staging_offset;
+  copy.region.dstOffset = offset;
+  copy.region.size      = size;
+  batch->bytes += size;
+  return batch->value;
+}
+
+u64 upload_image(
+    const Device& device,
+    Upload_Manager& uploads,
+    VkImage image,
+    VkImageAspectFlags aspect,
+    VkExtent3D extent,
+    const void* data,
+    VkDeviceSize size,
+    VkImageLayout final_layout) {
+  auto* batch = upload_open_batch(device, uploads);
+  if (batch && batch->image_copy_count == Upload_Manager::MAX_COPIES) {
+    upload_flush(device, uploads);
+    batch = upload_open_batch(device, uploads);
+  }
+
+  VkDeviceSize staging_offset = 0;
+  if (!batch || !upload_reserve(device, uploads, size, &staging_offset)) return 0;
+  batch = upload_open_batch(device, uploads);
+  if (!batch) return 0;
+  upload_write(device, uploads, staging_offset, data, size);
+
+  auto& copy                                  = batch->image_copies[batch->image_copy_count++];
+  copy.image                                  = image;
+  copy.final_layout                           = final_layout;
+  copy.region                                 = {};
+  copy.region.bufferOffset                    = staging_offset;
+  copy.region.imageSubresource.aspectMask     = aspect;
+  copy.region.imageSubresource.mipLevel       = 0;
+  copy.region.imageSubresource.baseArrayLayer = 0;
+  copy.region.imageSubresource.layerCount     = 1;
+  copy.region.imageExtent                     = extent;
+  batch->bytes += size;
+  return batch->value;
+}
+
+u64 upload_flush(const Device& device, Upload_Manager& uploads) {
+  if (!uploads.batch_open) return 0;
+  PROFILE_FUNCTION();
+
+  auto& batch          = upload_batch(uploads, uploads.timeline.submitted + 1);
+  VkCommandBuffer cmd  = batch.command_buffer;
+  const bool transfers = upload_transfers_ownership(uploads);
+  uploads.batch_open   = false;
+  VK_CHECK(vkResetCommandPool(device.logical, batch.command_pool, 0));
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+  // images are written whole, their old contents go.
+  VkImageMemoryBarrier2 image_barriers[Upload_Manager::MAX_COPIES];
+  for (u32 i = 0; i < batch.image_copy_count; ++i) {
+    const auto& copy                        = batch.image_copies[i];
+    VkImageMemoryBarrier2& barrier          = image_barriers[i];
+    barrier                                 = {};
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask                    = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask                   = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask                    = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.dstAccessMask                   = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = copy.image;
+    barrier.subresourceRange.aspectMask     = copy.region.imageSubresource.aspectMask;
+    barrier.subresourceRange.baseMipLevel   = 0;
+    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = 1;
+  }
+
+  // earlier batches on the queue might still be copying to the same place, the last upload has to win.
+  VkMemoryBarrier2 copy_barrier = {};
+  copy_barrier.sType            = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+  copy_barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COPY_BIT;
+  copy_barrier.srcAccessMask    = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  copy_barrier.dstStageMask     = VK_PIPELINE_STAGE_2_COPY_BIT;
+  copy_barrier.dstAccessMask    = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+  VkDependencyInfo dependency_info        = {};
+  dependency_info.sType                   = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency_info.memoryBarrierCount      = 1;
+  dependency_info.pMemoryBarriers         = &copy_barrier;
+  dependency_info.imageMemoryBarrierCount = batch.image_copy_count;
+  dependency_info.pImageMemoryBarriers    = image_barriers;
+  vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+  for (u32 i = 0; i < batch.buffer_copy_count; ++i) {
+    const auto& copy = batch.buffer_copies[i];
+    vkCmdCopyBuffer(cmd, uploads.staging, copy.buffer, 1, &copy.region);
+  }
+  for (u32 i = 0; i < batch.image_copy_count; ++i) {
+    const auto& copy = batch.image_copies[i];
+    vkCmdCopyBufferToImage(cmd, uploads.staging, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+  }
+
+  // images move to their final layout. across families this is the release half of the ownership transfer,
+  // buffers only need one then: within a family the semaphore already makes the writes visible.
+  VkBufferMemoryBarrier2 buffer_barriers[Upload_Manager::MAX_COPIES];
+  u32 buffer_barrier_count = 0;
+  for (u32 i = 0; transfers && i < batch.buffer_copy_count; ++i) {
+    const auto& copy                = batch.buffer_copies[i];
+    VkBufferMemoryBarrier2& barrier = buffer_barriers[buffer_barrier_count++];
+    barrier                         = {};
+    barrier.sType                   = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+    barrier.srcStageMask            = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask           = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex     = uploads.queue_family;
+    barrier.dstQueueFamilyIndex     = uploads.graphics_family;
+    barrier.buffer                  = copy.buffer;
+    barrier.offset                  = copy.region.dstOffset;
+    barrier.size                    = copy.region.size;
+  }
+  for (u32 i = 0; i < batch.image_copy_count; ++i) {
+    VkImageMemoryBarrier2& barrier = image_barriers[i];
+    barrier.srcStageMask           = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask          = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask           = transfers ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask          = 0;
+    barrier.oldLayout              = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout              = batch.image_copies[i].final_layout;
+    barrier.srcQueueFamilyIndex    = transfers ? uploads.queue_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex    = transfers ? uploads.graphics_family : VK_QUEUE_FAMILY_IGNORED;
+  }
+
+  dependency_info.memoryBarrierCount       = 0;
+  dependency_info.bufferMemoryBarrierCount = buffer_barrier_count;
+  dependency_info.pBufferMemoryBarriers    = buffer_barriers;
+  if (buffer_barrier_count || batch.image_copy_count) vkCmdPipelineBarrier2(cmd, &dependency_info);
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  const u64 value = timeline_next_value(uploads.timeline);
+  assert(value == batch.value);
+  batch.ring_end     = uploads.head;
+  batch.submit_ticks = os_now_ticks();
+
+  VkCommandBufferSubmitInfo command_buffer_info = {};
+  command_buffer_info.sType                     = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+  command_buffer_info.commandBuffer             = cmd;
+
+  VkSemaphoreSubmitInfo signal_info = {};
+  signal_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+  signal_info.semaphore             = uploads.timeline.semaphore;
+  signal_info.value                 = value;
+  signal_info.stageMask             = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+  VkSubmitInfo2 submit_info            = {};
+  submit_info.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submit_info.commandBufferInfoCount   = 1;
+  submit_info.pCommandBufferInfos      = &command_buffer_info;
+  submit_info.signalSemaphoreInfoCount = 1;
+  submit_info.pSignalSemaphoreInfos    = &signal_info;
+  VK_CHECK(vkQueueSubmit2(uploads.queue, 1, &submit_info, VK_NULL_HANDLE));
+
+  uploads.stats.bytes += batch.bytes;
+  uploads.stats.copies += batch.buffer_copy_count + batch.image_copy_count;
+  uploads.stats.batches++;
+  return value;
+}
+
+u64 upload_acquire(const Device& device, Upload_Manager& uploads, VkCommandBuffer cmd) {
+  upload_retire(device, uploads);
+
+  auto& stats         = uploads.stats;
+  const u64 now       = os_now_ticks();
+  const f64 window_ms = os_ticks_to_ms(now - stats.window_begin_ticks);
+  if (window_ms >= Upload_Manager::STATS_WINDOW_MS) {
+    stats.mib_per_s          = stats.window_bytes / (1024.0 * 1024.0) / (window_ms / 1000.0);
+    stats.window_bytes       = 0;
+    stats.window_begin_ticks = now;
+  }
+
+  if (uploads.acquired == uploads.retired) return 0;
+
+  if (uploads.buffer_acquire_count || uploads.image_acquire_count) {
+    VkDependencyInfo dependency_info         = {};
+    dependency_info.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.bufferMemoryBarrierCount = uploads.buffer_acquire_count;
+    dependency_info.pBufferMemoryBarriers    = uploads.buffer_acquires;
+    dependency_info.imageMemoryBarrierCount  = uploads.image_acquire_count;
+    dependency_info.pImageMemoryBarriers     = uploads.image_acquires;
+    vkCmdPipelineBarrier2(cmd, &dependency_info);
+    uploads.buffer_acquire_count = 0;
+    uploads.image_acquire_count  = 0;
+  }
+  uploads.acquired = uploads.retired;
+  return uploads.acquired;
+}
+
+bool upload_is_complete(const Upload_Manager& uploads, u64 ticket) {
+  return ticket <= uploads.acquired;
+}
+
+void upload_draw_imgui(const Upload_Manager& uploads, bool* open) {
+  if (!ImGui::Begin("uploads", open)) {
+    ImGui::End();
+    return;
+  }
+
+  const auto& stats = uploads.stats;
+  const f64 mib     = 1024.0 * 1024.0;
+  if (upload_transfers_ownership(uploads))
+    ImGui::Text("dedicated transfer family %u, handed to graphics %u", uploads.queue_family, uploads.graphics_family);
+  else
+    ImGui::Text("on the graphics queue, family %u", uploads.queue_family);
+  ImGui::Text(
+      "staging %.1f / %.1f MiB in use, peak %.1f MiB",
+      (uploads.head - uploads.tail) / mib,
+      uploads.staging_size / mib,
+      stats.peak_in_use / mib);
+  ImGui::Text("in flight %llu batches", (unsigned long long)(uploads.timeline.submitted - uploads.retired));
+
+  if (ImGui::BeginTable("stats", 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::Text("throughput");
+    ImGui::TableNextColumn();
+    ImGui::Text("%.1f MiB/s", stats.mib_per_s);
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::Text("last batch latency");
+    ImGui::TableNextColumn();
+    ImGui::Text("%.3f ms", stats.latency_ms);
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::Text("uploaded");
+    ImGui::TableNextColumn();
+    ImGui::Text(
+        "%.1f MiB, %llu copies in %llu batches",
+        stats.bytes / mib,
+        (unsigned long long)stats.copies,
+        (unsigned long long)stats.batches);
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::Text("stalls");
+    ImGui::TableNextColumn();
+    ImGui::Text("%u, %.3f ms", stats.stalls, stats.stall_ms);
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
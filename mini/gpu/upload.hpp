@@ -0,0 +1,118 @@
+#pragma once
+#include "common.hpp"
+#include "device.hpp"
+#include "sync.hpp"
+
+struct Upload_Stats {
+  u64 bytes; // handed to the gpu since creation.
+  u64 copies;
+  u64 batches;
+  u32 stalls; // times the cpu had to wait for staging space or a batch slot.
+  f64 stall_ms;
+  f64 latency_ms; // submit to seen done of the last retired batch, retiring is polled so it's an upper bound.
+  f64 mib_per_s;  // retired over the last window of about a second.
+  VkDeviceSize peak_in_use;
+
+  u64 window_bytes;
+  u64 window_begin_ticks;
+};
+
+/// Copies cpu data into buffers and images through one persistently mapped staging ring. Uploads are batched and go
+/// out as a single submission per `upload_flush` on the device's transfer queue, each one signals the manager's
+/// timeline semaphore. The cpu only waits on it when the ring or the batch slots run out.
+///
+/// Every upload returns a ticket. Once `upload_is_complete` says so, the resource can be used by graphics work
+/// recorded after the `upload_acquire` that completed it. With a dedicated transfer family that's where the
+/// ownership goes over to graphics, images end up in the layout they were uploaded with.
+struct Upload_Manager {
+  static constexpr u32 MAX_BATCHES        = 8;
+  static constexpr u32 MAX_COPIES         = 256; // per batch, a full batch gets flushed.
+  // retired resources waiting for `upload_acquire`, every batch in flight fits.
+  static constexpr u32 MAX_ACQUIRES       = MAX_BATCHES * MAX_COPIES;
+  static constexpr VkDeviceSize ALIGNMENT = 16;  // covers the texel size of every format we upload.
+  static constexpr f64 STATS_WINDOW_MS    = 1000.0;
+
+  struct Buffer_Copy {
+    VkBuffer buffer;
+    VkBufferCopy region;
+  };
+
+  struct Image_Copy {
+    VkImage image;
+    VkBufferImageCopy region;
+    VkImageLayout final_layout;
+  };
+
+  struct Batch {
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    u64 value;    // timeline value it signals, the ticket of everything in it.
+    u64 ring_end; // staging head when it was submitted, the tail moves there once it's done.
+    u64 bytes;
+    u64 submit_ticks;
+    Buffer_Copy buffer_copies[MAX_COPIES];
+    u32 buffer_copy_count;
+    Image_Copy image_copies[MAX_COPIES];
+    u32 image_copy_count;
+  } batches[MAX_BATCHES]; // value v lives in slot v % MAX_BATCHES.
+
+  VkQueue queue;
+  u32 queue_family;
+  u32 graphics_family;
+  Timeline_Semaphore timeline;
+  bool batch_open; // uploads go to the batch of value `timeline.submitted + 1`.
+  u64 retired;     // batches up to this value are done and their staging is free again.
+  u64 acquired;    // and up to this one usable by graphics.
+
+  VkBuffer staging;
+  VmaAllocation staging_allocation;
+  u8* staging_data;
+  VkDeviceSize staging_size;
+  u64 head; // both only grow, the staging offset is modulo `staging_size`.
+  u64 tail;
+
+  // ownership acquires of the retired batches, only used when the families differ.
+  VkBufferMemoryBarrier2 buffer_acquires[MAX_ACQUIRES];
+  u32 buffer_acquire_count;
+  VkImageMemoryBarrier2 image_acquires[MAX_ACQUIRES];
+  u32 image_acquire_count;
+
+  Upload_Stats stats;
+};
+
+void create_upload_manager(const Device& device, Upload_Manager& uploads, VkDeviceSize staging_size);
+/// Waits for everything in flight.
+void destroy_upload_manager(const Device& device, Upload_Manager& uploads);
+
+/// `data` is copied right away. Returns the ticket, 0 when the upload was dropped: only MAX_BATCHES flushes fit
+/// between two `upload_acquire`.
+u64 upload_buffer(
+    const Device& device,
+    Upload_Manager& uploads,
+    VkBuffer buffer,
+    VkDeviceSize offset,
+    const void* data,
+    VkDeviceSize size);
+/// Fills mip 0 of layer 0 from tightly packed texels, the previous contents are discarded. Returns the ticket
+/// or 0, like `upload_buffer`.
+u64 upload_image(
+    const Device& device,
+    Upload_Manager& uploads,
+    VkImage image,
+    VkImageAspectFlags aspect,
+    VkExtent3D extent,
+    const void* data,
+    VkDeviceSize size,
+    VkImageLayout final_layout);
+
+/// Submits what was uploaded since the last flush, returns its ticket or 0 if there was nothing.
+u64 upload_flush(const Device& device, Upload_Manager& uploads);
+
+/// Call once per frame at the start of `cmd`, a graphics command buffer. Records the ownership acquires of the
+/// uploads that finished and returns the timeline value its submission has to wait on, 0 if none. It's already
+/// signaled, the wait only orders the uploads' writes before the frame.
+u64 upload_acquire(const Device& device, Upload_Manager& uploads, VkCommandBuffer cmd);
+
+bool upload_is_complete(const Upload_Manager& uploads, u64 ticket);
+
+void upload_draw_imgui(const Upload_Manager& uploads, bool* open);
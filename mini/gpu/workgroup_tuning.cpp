@@ -0,0 +1,186 @@
+#include "workgroup_tuning.hpp"
+#include "core/common.hpp"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include <cstdio>
+#include <cstring>
+
+struct Workgroup_Cache_Header {
+  u32 magic;
+  u32 version;
+  u64 device_hash;
+  u32 count;
+  u32 pad;
+};
+
+// timed after the preferred size, those the device can't run or that end in a partial subgroup are left out.
+static constexpr Workgroup_Size WORKGROUP_CANDIDATES[] = {
+  { 8, 8 }, { 16, 8 }, { 8, 16 }, { 16, 16 }, { 32, 8 }, { 32, 4 }, { 64, 4 }, { 32, 16 },
+};
+
+static bool workgroup_fits(Workgroup_Size size, const VkPhysicalDeviceLimits& limits) {
+  return size.x <= limits.maxComputeWorkGroupSize[0] && size.y <= limits.maxComputeWorkGroupSize[1] &&
+      size.x * size.y <= limits.maxComputeWorkGroupInvocations;
+}
+
+// as square as powers of two allow, wider than tall since rows are what's contiguous in memory.
+static Workgroup_Size workgroup_preferred(u32 invocations, const VkPhysicalDeviceLimits& limits) {
+  Workgroup_Size size = { 1, 1 };
+  while (size.x * size.x < invocations) size.x *= 2;
+  size.y = invocations / size.x;
+  while (size.x > limits.maxComputeWorkGroupSize[0]) size.x /= 2;
+  while (size.y > limits.maxComputeWorkGroupSize[1]) size.y /= 2;
+  while (size.x * size.y > limits.maxComputeWorkGroupInvocations) {
+    if (size.x >= size.y) size.x /= 2;
+    else
+      size.y /= 2;
+  }
+  return size;
+}
+
+static void workgroup_cache_path(const Workgroup_Tuning& tuning, char* path, u64 size) {
+  snprintf(path, size, "workgroup_sizes_%04x_%04x.bin", tuning.vendor_id, tuning.device_id);
+}
+
+static const Workgroup_Tuning::Tuned* workgroup_find(const Workgroup_Tuning& tuning, const char* shader_path) {
+  const u64 kernel_hash = hash_bytes(shader_path, strlen(shader_path));
+  for (u32 i = 0; i < tuning.tuned_count; ++i) {
+    if (tuning.tuned[i].kernel_hash == kernel_hash) return &tuning.tuned[i];
+  }
+  return nullptr;
+}
+
+static void load_workgroup_cache(Workgroup_Tuning& tuning, const VkPhysicalDeviceLimits& limits) {
+  char path[64];
+  workgroup_cache_path(tuning, path, sizeof(path));
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, path, "rb");
+  if (!fp) return;
+  defer { fclose(fp); };
+
+  Workgroup_Cache_Header header = {};
+  if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != Workgroup_Tuning::MAGIC ||
+      header.version != Workgroup_Tuning::VERSION || header.count > Workgroup_Tuning::MAX_TUNED) {
+    log_warn("[workgroups] discarding %s, not a cache we wrote", path);
+    return;
+  }
+  if (header.device_hash != tuning.device_hash) {
+    log_info("[workgroups] discarding %s, tuned with another driver", path);
+    return;
+  }
+  if (fread(tuning.tuned, sizeof(Workgroup_Tuning::Tuned), header.count, fp) != header.count) {
+    log_warn("[workgroups] discarding %s, truncated", path);
+    return;
+  }
+
+  // the limits could only have changed with the driver, but a bad entry would fail pipeline creation.
+  for (u32 i = 0; i < header.count; ++i) {
+    if (workgroup_fits(tuning.tuned[i].size, limits)) tuning.tuned[tuning.tuned_count++] = tuning.tuned[i];
+  }
+  log_info("[workgroups] loaded %u tuned kernels from %s", tuning.tuned_count, path);
+}
+
+static void save_workgroup_cache(const Workgroup_Tuning& tuning) {
+  char path[64];
+  char temp_path[72];
+  workgroup_cache_path(tuning, path, sizeof(path));
+  snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+  Workgroup_Cache_Header header = {};
+  header.magic                  = Workgroup_Tuning::MAGIC;
+  header.version                = Workgroup_Tuning::VERSION;
+  header.device_hash            = tuning.device_hash;
+  header.count                  = tuning.tuned_count;
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, temp_path, "wb");
+  if (!fp) {
+    log_error("[workgroups] unable to open %s for writing", temp_path);
+    return;
+  }
+  const u32 count    = tuning.tuned_count;
+  const bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+      fwrite(tuning.tuned, sizeof(Workgroup_Tuning::Tuned), count, fp) == count;
+  const bool flushed = fflush(fp) == 0;
+  fclose(fp);
+
+  if (!written || !flushed || !os_replace_file(temp_path, path)) {
+    log_error("[workgroups] failed to write %s", path);
+    remove(temp_path);
+    return;
+  }
+  log_info("[workgroups] saved %u tuned kernels to %s", tuning.tuned_count, path);
+}
+
+void create_workgroup_tuning(const Device& device, Workgroup_Tuning& tuning) {
+  memset(&tuning, 0, sizeof(tuning));
+
+  VkPhysicalDeviceSubgroupProperties subgroup_properties = {};
+  subgroup_properties.sType                              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties = {};
+  properties.sType                       = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext                       = &subgroup_properties;
+  vkGetPhysicalDeviceProperties2(device.physical, &properties);
+  const VkPhysicalDeviceLimits& limits = properties.properties.limits;
+
+  tuning.subgroup_size = subgroup_properties.subgroupSize ? subgroup_properties.subgroupSize : 32;
+  tuning.vendor_id     = properties.properties.vendorID;
+  tuning.device_id     = properties.properties.deviceID;
+  tuning.device_hash   = hash_bytes(&tuning.vendor_id, sizeof(u32));
+  tuning.device_hash   = hash_bytes(&tuning.device_id, sizeof(u32), tuning.device_hash);
+  tuning.device_hash   = hash_bytes(&properties.properties.driverVersion, sizeof(u32), tuning.device_hash);
+  tuning.device_hash   = hash_bytes(properties.properties.pipelineCacheUUID, VK_UUID_SIZE, tuning.device_hash);
+
+  // four subgroups, but never below 64 invocations so tiny subgroups (software rasterizers, some mobile parts)
+  // still amortize the workgroup setup, and never above 256 so small images keep every compute unit busy.
+  u32 invocations = 1;
+  while (invocations < tuning.subgroup_size * 4) invocations *= 2;
+  tuning.preferred = workgroup_preferred(clamp(invocations, 64u, 256u), limits);
+
+  tuning.candidates[tuning.candidate_count++] = tuning.preferred;
+  for (Workgroup_Size size : WORKGROUP_CANDIDATES) {
+    if (tuning.candidate_count == Workgroup_Tuning::MAX_CANDIDATES) break;
+    if (!workgroup_fits(size, limits) || (size.x * size.y) % tuning.subgroup_size) continue;
+    if (size.x == tuning.preferred.x && size.y == tuning.preferred.y) continue;
+    tuning.candidates[tuning.candidate_count++] = size;
+  }
+
+  load_workgroup_cache(tuning, limits);
+  log_info(
+      "[workgroups] subgroup size %u, %ux%u unless tuned",
+      tuning.subgroup_size,
+      tuning.preferred.x,
+      tuning.preferred.y);
+}
+
+void destroy_workgroup_tuning(Workgroup_Tuning& tuning) {
+  if (tuning.dirty) save_workgroup_cache(tuning);
+  tuning = {};
+}
+
+Workgroup_Size workgroup_size_for(const Workgroup_Tuning& tuning, const char* shader_path) {
+  const Workgroup_Tuning::Tuned* tuned = workgroup_find(tuning, shader_path);
+  return tuned ? tuned->size : tuning.preferred;
+}
+
+bool workgroup_is_tuned(const Workgroup_Tuning& tuning, const char* shader_path) {
+  return workgroup_find(tuning, shader_path) != nullptr;
+}
+
+void workgroup_set_tuned(Workgroup_Tuning& tuning, const char* shader_path, Workgroup_Size size, f32 ms) {
+  auto tuned = (Workgroup_Tuning::Tuned*)workgroup_find(tuning, shader_path);
+  if (!tuned) {
+    if (tuning.tuned_count == Workgroup_Tuning::MAX_TUNED) {
+      log_warn("[workgroups] no room to keep the size of %s", shader_path);
+      return;
+    }
+    tuned              = &tuning.tuned[tuning.tuned_count++];
+    tuned->kernel_hash = hash_bytes(shader_path, strlen(shader_path));
+  }
+  tuned->size  = size;
+  tuned->ms    = ms;
+  tuning.dirty = true;
+  log_info("[workgroups] %s runs best at %ux%u, %.3fms", shader_path, size.x, size.y, ms);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "common.hpp"
+#include "device.hpp"
+#include "pipeline_registry.hpp"
+
+/// Picks the local size of 2d image kernels per device. The default is derived from the subgroup size and limits:
+/// enough whole subgroups per workgroup to hide latency without starving the device of workgroups. Kernels that were
+/// timed on this device (`kernel_bench_tune`) use the winner instead, those are cached on disk per device and driver.
+struct Workgroup_Tuning {
+  static constexpr u32 MAX_CANDIDATES = 8;
+  static constexpr u32 MAX_TUNED      = 32;
+  static constexpr u32 MAGIC          = 0x5347574d; // "MWGS"
+  static constexpr u32 VERSION        = 1;
+
+  u32 subgroup_size;
+  Workgroup_Size preferred;
+
+  // sizes worth timing, all within the device limits and made of whole subgroups.
+  Workgroup_Size candidates[MAX_CANDIDATES];
+  u32 candidate_count;
+
+  // vendor, device, driver and pipeline cache uuid, a winner on one driver says little about the next one.
+  u64 device_hash;
+  u32 vendor_id;
+  u32 device_id;
+
+  struct Tuned {
+    u64 kernel_hash; // of the shader path.
+    Workgroup_Size size;
+    f32 ms;
+  } tuned[MAX_TUNED];
+  u32 tuned_count;
+  bool dirty; // written back by `destroy_workgroup_tuning`.
+};
+
+/// Loads the cached winners of this device.
+void create_workgroup_tuning(const Device& device, Workgroup_Tuning& tuning);
+void destroy_workgroup_tuning(Workgroup_Tuning& tuning);
+
+/// The tuned size of the kernel when there is one, `preferred` otherwise.
+Workgroup_Size workgroup_size_for(const Workgroup_Tuning& tuning, const char* shader_path);
+bool workgroup_is_tuned(const Workgroup_Tuning& tuning, const char* shader_path);
+void workgroup_set_tuned(Workgroup_Tuning& tuning, const char* shader_path, Workgroup_Size size, f32 ms);
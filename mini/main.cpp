@@ -10,17 +10,38 @@
 
 #include "embed/roboto.font"
 
+#include "bench/kernel_bench.hpp"
+#include "core/common.hpp"
+#include "gpu/bindless.hpp"
 #include "gpu/common.hpp"
 #include "gpu/device.hpp"
+#include "gpu/dynamic_resolution.hpp"
+#include "gpu/frame_pacer.hpp"
+#include "gpu/pass_cache.hpp"
+#include "gpu/pipeline_registry.hpp"
+#include "gpu/readback.hpp"
+#include "gpu/render_graph.hpp"
+#include "gpu/shader_compiler.hpp"
 #include "gpu/surface.hpp"
+#include "gpu/sync.hpp"
+#include "gpu/transient_heap.hpp"
+#include "gpu/upload.hpp"
+#include "gpu/workgroup_tuning.hpp"
 
 #include "log.hpp"
+#include "os/os_common.hpp"
+#include "profile/frame_stats.hpp"
+#include "profile/gpu_profiler.hpp"
+#include "profile/profiler.hpp"
+#include "profile/sampling_profiler.hpp"
 #include <vulkan/vulkan.h>
 
 #include "embed/color.frag"
 #include "embed/color.vert"
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <glm.hpp>
 
 static void glfw_error_callback(int error, const char* description) {
@@ -35,11 +56,11 @@ static void begin_command(VkCommandBuffer command_buffer, VkCommandBufferUsageFl
   VK_CHECK(vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info));
 }
 
-static VkCommandPool create_command_pool(Device* device, bool one_time_use) {
+static VkCommandPool create_command_pool(Device* device, u32 queue_family, bool one_time_use) {
   VkCommandPoolCreateInfo command_pool_create_info = {};
   command_pool_create_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   command_pool_create_info.flags                   = one_time_use ? VK_COMMAND_POOL_CREATE_TRANSIENT_BIT : 0;
-  command_pool_create_info.queueFamilyIndex        = device->queue_family;
+  command_pool_create_info.queueFamilyIndex        = queue_family;
 
   VkCommandPool command_pool;
   VK_CHECK(vkCreateCommandPool(device->logical, &command_pool_create_info, device->allocator_callbacks, &command_pool));
@@ -58,32 +79,14 @@ static VkCommandBuffer allocate_command_buffer(Device* device, VkCommandPool com
   return command_buffer;
 }
 
-static VkFence create_fence(Device* device, bool should_signal) {
-  VkFenceCreateInfo fence_create_info = {};
-  fence_create_info.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_create_info.pNext             = nullptr;
-  fence_create_info.flags             = should_signal ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
+static VkSemaphore create_semaphore(Device* device) {
+  VkSemaphoreCreateInfo semaphore_create_info = {};
+  semaphore_create_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_create_info.pNext                 = nullptr;
 
-  VkFence fence;
-  VK_CHECK(vkCreateFence(device->logical, &fence_create_info, device->allocator_callbacks, &fence));
-  return fence;
-}
-
-static u64 read_file(Linear_Allocator& arena, char** buffer, const char* file_name) {
-  assert(buffer);
-  FILE* fp = nullptr;
-  fopen_s(&fp, file_name, "rb");
-  defer { fclose(fp); };
-
-  if (!fp) return 0;
-
-  fseek(fp, 0L, SEEK_END);
-  u64 sz = ftell(fp);
-  // fseek(fp, 0L, SEEK_SET);
-  rewind(fp);
-  *buffer = arena.push_array_no_init<char>(sz);
-  sz      = fread(*buffer, 1, sz, fp);
-  return sz;
+  VkSemaphore semaphore;
+  VK_CHECK(vkCreateSemaphore(device->logical, &semaphore_create_info, device->allocator_callbacks, &semaphore));
+  return semaphore;
 }
 
 static void copy_image_to_image(
@@ -92,6 +95,7 @@ static void copy_image_to_image(
     VkImage destination,
     VkExtent2D src_size,
     VkExtent2D dst_size) {
+  PROFILE_FUNCTION();
   VkImageBlit2 blit_region = {};
   blit_region.sType        = VK_STRUCTURE_TYPE_IMAGE_BLIT_2;
   blit_region.pNext        = nullptr;
@@ -128,43 +132,48 @@ static void copy_image_to_image(
   vkCmdBlitImage2(cmd, &blit_info);
 }
 
-static void transition_image(
-    VkCommandBuffer command_buffer,
-    VkImage image,
-    VkImageLayout old_layout,
-    VkImageLayout new_layout) {
-  VkImageMemoryBarrier2 image_barrier = {};
-  image_barrier.sType                 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
-  image_barrier.pNext                 = nullptr;
-
-  image_barrier.srcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-  image_barrier.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT;
-  image_barrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
-  image_barrier.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT;
-
-  image_barrier.oldLayout = old_layout;
-  image_barrier.newLayout = new_layout;
-
-  VkImageAspectFlags aspectMask = (image_barrier.newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL)
-      ? VK_IMAGE_ASPECT_DEPTH_BIT
-      : VK_IMAGE_ASPECT_COLOR_BIT;
-
-  VkImageSubresourceRange sub_image = {};
-  sub_image.aspectMask              = aspectMask;
-  sub_image.baseMipLevel            = 0;
-  sub_image.levelCount              = VK_REMAINING_MIP_LEVELS;
-  sub_image.baseArrayLayer          = 0;
-  sub_image.layerCount              = VK_REMAINING_ARRAY_LAYERS;
-  image_barrier.subresourceRange    = sub_image;
-  image_barrier.image               = image;
-
-  VkDependencyInfo dependency_info = {};
-  dependency_info.sType            = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-  dependency_info.pNext            = nullptr;
-
-  dependency_info.imageMemoryBarrierCount = 1;
-  dependency_info.pImageMemoryBarriers    = &image_barrier;
-  vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+// the render target of a frame slot, it outlives the slot's graphs so a frame can show what an earlier one drew.
+static Image create_render_target(const Device& device, const Transient_Image_Desc& desc) {
+  Image image  = {};
+  image.extent = desc.extent;
+  image.format = desc.format;
+
+  VkImageCreateInfo image_info = {};
+  image_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType         = VK_IMAGE_TYPE_2D;
+  image_info.format            = desc.format;
+  image_info.extent            = desc.extent;
+  image_info.mipLevels         = 1;
+  image_info.arrayLayers       = 1;
+  image_info.samples           = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling            = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage             = desc.usage;
+  image_info.sharingMode       = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo allocation_info = {};
+  allocation_info.usage                   = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+  VK_CHECK(vmaCreateImage(device.allocator, &image_info, &allocation_info, &image.image, &image.allocation, nullptr));
+
+  VkImageViewCreateInfo view_info           = {};
+  view_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image                           = image.image;
+  view_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format                          = desc.format;
+  view_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel   = 0;
+  view_info.subresourceRange.levelCount     = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount     = 1;
+  VK_CHECK(vkCreateImageView(device.logical, &view_info, device.allocator_callbacks, &image.view));
+  return image;
+}
+
+static void destroy_render_target(const Device& device, Image& image) {
+  if (image.image == VK_NULL_HANDLE) return;
+  vkDestroyImageView(device.logical, image.view, device.allocator_callbacks);
+  vmaDestroyImage(device.allocator, image.image, image.allocation);
+  image = {};
 }
 
 struct Compute_Push_Constants {
@@ -172,32 +181,396 @@ struct Compute_Push_Constants {
   glm::vec4 data2;
   glm::vec4 data3;
   glm::vec4 data4;
+  u32 target_index; // bindless storage image the kernel writes to.
+  u32 width;        // of the part of it to draw, dynamic resolution only uses the top left corner.
+  u32 height;
+  u32 pad;
+};
+
+static_assert(sizeof(Compute_Push_Constants) <= Bindless_Heap::PUSH_CONSTANT_SIZE, "push constants are too big");
+
+// everything the frame's passes record with, they run from inside `render_graph_execute`.
+struct Frame_Passes {
+  VkPipeline background_pipeline;
+  Workgroup_Size background_local_size; // of the pipeline actually bound, a fallback may differ.
+  VkPipelineLayout pipeline_layout;
+  const Compute_Push_Constants* push_constants;
+  VkImage render_target;
+  VkExtent2D render_extent;
+  VkImage swapchain_image;
+  VkImageView swapchain_view;
+  VkExtent2D surface_extent;
+  ImDrawData* draw_data;
+};
+
+static void background_pass(VkCommandBuffer cmd, void* user_data) {
+  auto& frame = *(Frame_Passes*)user_data;
+  // nothing to draw with until the first pipeline of the effect (or its fallback) finished compiling.
+  if (frame.background_pipeline == VK_NULL_HANDLE) return;
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, frame.background_pipeline);
+  // the kernel finds the draw image in the bindless heap through the push constants.
+  vkCmdPushConstants(
+      cmd,
+      frame.pipeline_layout,
+      VK_SHADER_STAGE_ALL,
+      0,
+      sizeof(Compute_Push_Constants),
+      frame.push_constants);
+
+  const Workgroup_Size local_size = frame.background_local_size;
+  vkCmdDispatch(
+      cmd,
+      workgroup_count(frame.render_extent.width, local_size.x),
+      workgroup_count(frame.render_extent.height, local_size.y),
+      1);
+}
+
+// secondary command buffers start without the heap bound, cached passes get it through this.
+static void bind_bindless_pass(VkCommandBuffer cmd, void* user_data) {
+  bindless_bind(*(const Bindless_Heap*)user_data, cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+}
+
+static void blit_pass(VkCommandBuffer cmd, void* user_data) {
+  auto& frame = *(Frame_Passes*)user_data;
+  copy_image_to_image(cmd, frame.render_target, frame.swapchain_image, frame.render_extent, frame.surface_extent);
+}
+
+static void imgui_pass(VkCommandBuffer cmd, void* user_data) {
+  auto& frame = *(Frame_Passes*)user_data;
+
+  VkRenderingAttachmentInfo color_attachment = {};
+  color_attachment.sType                     = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+  color_attachment.imageView                 = frame.swapchain_view;
+  color_attachment.imageLayout               = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  color_attachment.loadOp                    = VK_ATTACHMENT_LOAD_OP_LOAD;
+  color_attachment.storeOp                   = VK_ATTACHMENT_STORE_OP_STORE;
+
+  VkRenderingInfo render_info      = {};
+  render_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO;
+  render_info.colorAttachmentCount = 1;
+  render_info.pColorAttachments    = &color_attachment;
+  render_info.layerCount           = 1;
+  render_info.renderArea.extent    = frame.surface_extent;
+
+  vkCmdBeginRendering(cmd, &render_info);
+  ImGui_ImplVulkan_RenderDrawData(frame.draw_data, cmd);
+  vkCmdEndRendering(cmd);
+}
+
+// copies a graph image into a readback slot, the image is looked up once the graph is compiled.
+struct Capture_Pass {
+  const Render_Graph* graph;
+  const Readback_Manager* readbacks;
+  Graph_Image source;
+  u32 slot;
+};
+
+static void capture_pass(VkCommandBuffer cmd, void* user_data) {
+  auto& capture = *(Capture_Pass*)user_data;
+  readback_record_copy(*capture.readbacks, capture.slot, cmd, render_graph_image(*capture.graph, capture.source));
+}
+
+static void add_capture_pass(Render_Graph& graph, Capture_Pass& capture, const char* name) {
+  Graph_Buffer buffer = render_graph_import_buffer(
+      graph,
+      name,
+      readback_buffer(*capture.readbacks, capture.slot),
+      0,
+      readback_size(*capture.readbacks, capture.slot),
+      Buffer_Usage::none,
+      Buffer_Usage::host_read);
+  u32 pass = render_graph_add_pass(graph, name, capture_pass, &capture, true);
+  render_graph_use_image(graph, pass, capture.source, Image_Usage::transfer_src);
+  render_graph_use_buffer(graph, pass, buffer, Buffer_Usage::transfer_dst);
+}
+
+// what the next frames capture, files are numbered in the working directory.
+struct Capture_Settings {
+  Readback_Encoding encoding;
+  bool swapchain;     // once, on the next frame.
+  bool render_target; // same.
+  bool record;        // the swapchain every frame, frames that find no free slot are skipped.
+  u32 counter;
+};
+
+static void capture_draw_imgui(Capture_Settings& capture, const Surface& surface, bool* open) {
+  if (!ImGui::Begin("capture", open)) {
+    ImGui::End();
+    return;
+  }
+  const char* encodings[(u32)Readback_Encoding::count];
+  for (u32 i = 0; i < (u32)Readback_Encoding::count; ++i) encodings[i] = readback_encoding_name((Readback_Encoding)i);
+  int encoding = (int)capture.encoding;
+  if (ImGui::Combo("encoding", &encoding, encodings, (int)Readback_Encoding::count))
+    capture.encoding = (Readback_Encoding)encoding;
+
+  const bool swapchain_readable = surface.readable && readback_supports_format(surface.format.format);
+  ImGui::BeginDisabled(!swapchain_readable);
+  if (ImGui::Button("swapchain")) capture.swapchain = true;
+  ImGui::SameLine();
+  ImGui::Checkbox("record", &capture.record);
+  ImGui::EndDisabled();
+  if (ImGui::Button("render target")) capture.render_target = true;
+  if (!swapchain_readable) ImGui::Text("the swapchain can't be copied from");
+  ImGui::Text("%u captured", capture.counter);
+  ImGui::End();
+}
+
+static const char* capture_extension(Readback_Encoding encoding) {
+  return encoding == Readback_Encoding::raw ? "bin" : readback_encoding_name(encoding);
+}
+
+// what `main` was started with, everything but the window is for ci and benchmark runs.
+struct Launch_Options {
+  bool headless;
+  u64 frames; // headless runs stop after this many, windowed ones when the window closes.
+  s32 width;
+  s32 height;
+  const char* readback_path; // headless, the last frame goes there, encoded by its extension (.png, .ppm or raw).
+  bool tune_workgroups;      // times the kernels that weren't tuned on this device yet, the winners are cached.
+};
+
+static Launch_Options parse_launch_options(int argc, char** argv) {
+  Launch_Options options = {};
+  options.frames         = 300;
+  options.width          = 1280;
+  options.height         = 720;
+
+  for (int i = 1; i < argc; ++i) {
+    const char* arg   = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!strcmp(arg, "--headless")) {
+      options.headless = true;
+    } else if (!strcmp(arg, "--frames") && value) {
+      options.frames = strtoull(value, nullptr, 10);
+      ++i;
+    } else if (!strcmp(arg, "--size") && value) {
+      s32 width = 0, height = 0;
+      if (sscanf(value, "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+        options.width  = width;
+        options.height = height;
+      } else {
+        log_warn("[options] --size takes WIDTHxHEIGHT, got %s", value);
+      }
+      ++i;
+    } else if (!strcmp(arg, "--tune-workgroups")) {
+      options.tune_workgroups = true;
+    } else if (!strcmp(arg, "--readback") && value) {
+      options.readback_path = value;
+      ++i;
+    } else {
+      log_warn("[options] ignoring %s", arg);
+    }
+  }
+  if (options.readback_path && !options.headless) log_warn("[options] --readback only works with --headless");
+  return options;
+}
+
+// keeps the copy queue busy with generated data to see what the upload path sustains next to the frame.
+struct Upload_Stream_Test {
+  static constexpr VkDeviceSize CHUNK_SIZE  = mega_bytes(2);
+  static constexpr VkDeviceSize BUFFER_SIZE = mega_bytes(16);
+
+  VkBuffer buffer; // device local, nothing ever reads it.
+  VmaAllocation allocation;
+  const u8* chunk; // CHUNK_SIZE bytes uploaded over and over.
+  VkDeviceSize next_offset;
+  s32 mib_per_frame;
+  bool running;
+  u64 last_ticket;
+};
+
+static void upload_stream_test_update(const Device& device, Upload_Manager& uploads, Upload_Stream_Test& test) {
+  if (!test.running) return;
+  const VkDeviceSize chunks = mega_bytes((VkDeviceSize)test.mib_per_frame) / Upload_Stream_Test::CHUNK_SIZE;
+  for (VkDeviceSize i = 0; i < chunks; ++i) {
+    const VkDeviceSize offset = test.next_offset;
+    test.next_offset          = (offset + Upload_Stream_Test::CHUNK_SIZE) % Upload_Stream_Test::BUFFER_SIZE;
+
+    test.last_ticket = upload_buffer(device, uploads, test.buffer, offset, test.chunk, Upload_Stream_Test::CHUNK_SIZE);
+  }
+}
+
+static void upload_stream_test_draw_imgui(Upload_Stream_Test& test, const Upload_Manager& uploads, bool* open) {
+  if (!ImGui::Begin("upload stream test", open)) {
+    ImGui::End();
+    return;
+  }
+  ImGui::Checkbox("stream", &test.running);
+  ImGui::SliderInt("MiB per frame", &test.mib_per_frame, 2, 32);
+  if (test.last_ticket) {
+    const bool done = upload_is_complete(uploads, test.last_ticket);
+    ImGui::Text("last upload %llu %s", (unsigned long long)test.last_ticket, done ? "done" : "in flight");
+  }
+  ImGui::End();
+}
+
+// A/B of the background on the graphics queue against async compute, timed with the gpu profilers' frame spans, so
+// it works without MINI_PROFILE. each run throws away its first frames, they were recorded before the switch.
+struct Async_Compute_Bench {
+  static constexpr u32 WARMUP_FRAMES = 16;
+  static constexpr u32 FRAMES        = 256;
+
+  bool running;
+  u32 run; // 0 with everything on graphics, 1 with the background on async compute.
+  u32 frame;
+  struct Result {
+    f64 span_ms;     // first to last timestamp of a frame over both queues.
+    f64 graphics_ms; // how long the graphics queue was busy with it.
+    u32 samples;
+  } results[2];
 };
 
-int main(int, char**) {
+// begin to end of the newest frame read back, over both queues when `compute` ran part of it. the frame span
+// timestamps are written in every build, not only with MINI_PROFILE.
+static f64 gpu_frame_ms(const GPU_Profiler& graphics, const GPU_Profiler* compute) {
+  if (graphics.last_end_ticks == 0) return 0.0;
+  u64 begin = graphics.last_begin_ticks;
+  u64 end   = graphics.last_end_ticks;
+  if (compute && compute->last_end_ticks != 0) {
+    if (compute->last_begin_ticks < begin) begin = compute->last_begin_ticks;
+    if (compute->last_end_ticks > end) end = compute->last_end_ticks;
+  }
+  return os_ticks_to_ms(end - begin);
+}
+
+// call once both profilers read back the frame slot.
+static void async_compute_bench_sample(
+    Async_Compute_Bench& bench,
+    const GPU_Profiler& graphics,
+    const GPU_Profiler& compute) {
+  if (!bench.running) return;
+
+  auto& result = bench.results[bench.run];
+  if (bench.frame++ >= Async_Compute_Bench::WARMUP_FRAMES && graphics.last_end_ticks != 0) {
+    result.span_ms += gpu_frame_ms(graphics, bench.run == 1 ? &compute : nullptr);
+    result.graphics_ms += gpu_frame_ms(graphics, nullptr);
+    result.samples++;
+  }
+  if (bench.frame < Async_Compute_Bench::WARMUP_FRAMES + Async_Compute_Bench::FRAMES) return;
+
+  bench.frame = 0;
+  if (bench.run++ == 0) return;
+  bench.running = false;
+
+  const auto& a = bench.results[0];
+  const auto& b = bench.results[1];
+  if (a.samples == 0 || b.samples == 0) {
+    log_warn("[async compute] no frame was timed, the comparison has no results");
+    return;
+  }
+  log_info(
+      "[async compute] graphics queue %.3f -> %.3f ms, frame span %.3f -> %.3f ms over %u frames",
+      a.graphics_ms / a.samples,
+      b.graphics_ms / b.samples,
+      a.span_ms / a.samples,
+      b.span_ms / b.samples,
+      Async_Compute_Bench::FRAMES);
+}
+
+static void async_compute_draw_imgui(
+    const Device& device,
+    const GPU_Profiler& graphics,
+    const GPU_Profiler& compute,
+    Async_Compute_Bench& bench,
+    bool& use_async_compute,
+    bool* open) {
+  if (!ImGui::Begin("async compute", open)) {
+    ImGui::End();
+    return;
+  }
+  if (!device.async_compute) {
+    ImGui::Text("no queue to spare, everything runs on graphics.");
+    ImGui::End();
+    return;
+  }
+
+  ImGui::Text("compute queue family %u, graphics %u", device.compute_queue_family, device.queue_family);
+  ImGui::BeginDisabled(bench.running);
+  ImGui::Checkbox("background on async compute", &use_async_compute);
+  ImGui::EndDisabled();
+  // both queues have to write timestamps to time the frames.
+  const bool timed = graphics.enabled && compute.enabled;
+  ImGui::BeginDisabled(bench.running || !timed);
+  if (ImGui::Button("run A/B")) {
+    bench         = {};
+    bench.running = true;
+  }
+  ImGui::EndDisabled();
+  if (!timed) {
+    ImGui::SameLine();
+    ImGui::Text("needs timestamps on both queues.");
+  } else if (bench.running) {
+    ImGui::SameLine();
+    ImGui::Text("%s, frame %u", bench.run == 0 ? "graphics only" : "async compute", bench.frame);
+  }
+
+  if (ImGui::BeginTable("results", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("background on");
+    ImGui::TableSetupColumn("graphics queue ms");
+    ImGui::TableSetupColumn("frame span ms");
+    ImGui::TableHeadersRow();
+    for (u32 i = 0; i < 2; ++i) {
+      const auto& result = bench.results[i];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%s", i == 0 ? "graphics" : "async compute");
+      ImGui::TableNextColumn();
+      if (result.samples) ImGui::Text("%.3f", result.graphics_ms / result.samples);
+      ImGui::TableNextColumn();
+      if (result.samples) ImGui::Text("%.3f", result.span_ms / result.samples);
+    }
+    ImGui::EndTable();
+  }
+  ImGui::End();
+}
+
+// how many frames the cpu may record ahead of the gpu, independent of the swapchain image count. more hides
+// hitches better, fewer keeps input latency down.
+static constexpr u32 FRAMES_IN_FLIGHT = 2;
+
+int main(int argc, char** argv) {
   log_info("Hello world from %s!!", "Mini Engine");
+  os_init_clock();
+  log_info("clock: %s", os_clock_uses_tsc() ? "invariant tsc" : "os monotonic clock");
+
+  profiler_init();
+  defer { profiler_shutdown(); };
+  sampling_profiler_register_thread("main");
+  defer { sampling_profiler_stop(); };
+
+  // the benchmark brings its own device and options, it shares the clock and the profiler.
+  if (argc > 1 && !strcmp(argv[1], "--bench-kernels")) return kernel_bench_main(argc, argv);
+  const Launch_Options options = parse_launch_options(argc, argv);
 
   // put some allocators here
   Linear_Allocator frame_allocator = { mega_bytes(20) };
   Linear_Allocator temp_allocator  = { mega_bytes(20) };
 
-  glfwSetErrorCallback(glfw_error_callback);
-  if (!glfwInit()) return 1;
-  defer { glfwTerminate(); };
+  // headless runs never touch glfw, there may be no display to connect to.
+  GLFWwindow* window = nullptr;
+  if (!options.headless) {
+    glfwSetErrorCallback(glfw_error_callback);
+    if (!glfwInit()) return 1;
 
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
 
-  constexpr auto window_name = "Place holder window name";
-  GLFWwindow* window         = glfwCreateWindow(1280, 720, window_name, nullptr, nullptr);
-  defer { glfwDestroyWindow(window); };
+    constexpr auto window_name = "Place holder window name";
+    window                     = glfwCreateWindow(options.width, options.height, window_name, nullptr, nullptr);
+  }
+  defer {
+    if (window) glfwDestroyWindow(window);
+    if (!options.headless) glfwTerminate();
+  };
 
-  if (!glfwVulkanSupported()) {
+  if (!options.headless && !glfwVulkanSupported()) {
     log_error("GLFW: Vulkan not supported");
     return EXIT_FAILURE;
   }
 
-  init_gpu_instance(temp_allocator);
+  init_gpu_instance(temp_allocator, options.headless);
   defer { cleanup_gpu_instance(); };
 
   IMGUI_CHECKVERSION();
@@ -218,15 +591,39 @@ int main(int, char**) {
     style.Colors[ImGuiCol_WindowBg].w = 1.0f;
   }
 
-  int w = -1, h = -1;
-  glfwGetFramebufferSize(window, &w, &h);
+  int w = options.width, h = options.height;
+  if (window) glfwGetFramebufferSize(window, &w, &h);
 
-  auto device = create_device(temp_allocator);
+  auto device = create_device(temp_allocator, options.headless);
+  if (device.logical == VK_NULL_HANDLE) return EXIT_FAILURE;
   defer { destroy_device(device); };
 
-  auto surface = create_surface(temp_allocator, device, window, w, h);
+  auto surface = options.headless ? create_headless_surface(device, w, h)
+                                  : create_surface(temp_allocator, device, window, w, h);
   defer { destroy_surface(device, surface); };
 
+  Readback_Manager readbacks;
+  create_readback_manager(readbacks);
+  defer { destroy_readback_manager(device, readbacks); };
+
+  Capture_Settings capture = {};
+  capture.encoding         = Readback_Encoding::png;
+  // headless runs pick the encoding from the file name.
+  const bool readback_last_frame      = options.headless && options.readback_path;
+  Readback_Encoding readback_encoding = Readback_Encoding::raw;
+  if (readback_last_frame) {
+    const char* extension = strrchr(options.readback_path, '.');
+    if (extension && !strcmp(extension, ".png")) readback_encoding = Readback_Encoding::png;
+    if (extension && !strcmp(extension, ".ppm")) readback_encoding = Readback_Encoding::ppm;
+  }
+
+  // resources replaced while frames may still use them, tagged with the graphics timeline value after which they're
+  // unused.
+  auto retired = frame_allocator.push_no_init<Delay_Queue>();
+  create_delay_queue(device, *retired);
+  defer { destroy_delay_queue(*retired); };
+  bool swapchain_dirty = false;
+
   // Load Fonts
   ImFontConfig font_config{};
   font_config.FontDataOwnedByAtlas = false;
@@ -238,93 +635,14 @@ int main(int, char**) {
   log_debug("debug");
   log_warn("warn");
 
-  char* gradient_comp_shader_buffer = nullptr;
-  u64 gradient_comp_buffer_size = read_file(temp_allocator, &gradient_comp_shader_buffer, "kernel/gradient.comp.spv");
-  assert(gradient_comp_shader_buffer != 0);
-
-  VkShaderModuleCreateInfo gradient_shader_create_info = {};
-  gradient_shader_create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  gradient_shader_create_info.pNext                    = nullptr;
-  gradient_shader_create_info.codeSize                 = gradient_comp_buffer_size;
-  gradient_shader_create_info.pCode                    = (u32*)gradient_comp_shader_buffer;
-
-  VkShaderModule gradient_comp_shader_module = { 0 };
-  VK_CHECK(vkCreateShaderModule(
-      device.logical,
-      &gradient_shader_create_info,
-      device.allocator_callbacks,
-      &gradient_comp_shader_module));
-  defer { vkDestroyShaderModule(device.logical, gradient_comp_shader_module, device.allocator_callbacks); };
-  temp_allocator.clear();
-
-  char* sky_comp_shader_buffer = nullptr;
-  u64 sky_comp_buffer_size     = read_file(temp_allocator, &sky_comp_shader_buffer, "kernel/sky.comp.spv");
-  assert(sky_comp_shader_buffer != 0);
-
-  VkShaderModuleCreateInfo sky_shader_create_info = {};
-  sky_shader_create_info.sType                    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  sky_shader_create_info.pNext                    = nullptr;
-  sky_shader_create_info.codeSize                 = sky_comp_buffer_size;
-  sky_shader_create_info.pCode                    = (u32*)sky_comp_shader_buffer;
-
-  VkShaderModule sky_comp_shader_module = { 0 };
-  VK_CHECK(vkCreateShaderModule(
-      device.logical,
-      &sky_shader_create_info,
-      device.allocator_callbacks,
-      &sky_comp_shader_module));
-  defer { vkDestroyShaderModule(device.logical, sky_comp_shader_module, device.allocator_callbacks); };
-
-  temp_allocator.clear();
-
-  const u32 num_bindings = 1;
-  VkDescriptorSetLayoutBinding binding[num_bindings];
-  binding[0].binding         = 0;
-  binding[0].descriptorCount = 1;
-  binding[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  binding[0].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
-
-  VkDescriptorSetLayoutCreateInfo layout_create_info = {};
-  layout_create_info.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-  layout_create_info.pNext                           = nullptr;
-  layout_create_info.pBindings                       = binding;
-  layout_create_info.bindingCount                    = ARRAY_SIZE(binding);
-  layout_create_info.flags                           = 0;
-  VkDescriptorSetLayout layout                       = VK_NULL_HANDLE;
-  VK_CHECK(vkCreateDescriptorSetLayout(device.logical, &layout_create_info, device.allocator_callbacks, &layout));
-  defer { vkDestroyDescriptorSetLayout(device.logical, layout, device.allocator_callbacks); };
-
-  VkDescriptorPoolSize descriptor_pool_size[1];
-  descriptor_pool_size[0].descriptorCount = 1;
-  descriptor_pool_size[0].type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-  VkDescriptorPoolCreateInfo pool_info    = {};
-  pool_info.sType                         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-  pool_info.flags                         = 0;
-  pool_info.maxSets                       = 10;
-  pool_info.poolSizeCount                 = ARRAY_SIZE(descriptor_pool_size);
-  pool_info.pPoolSizes                    = descriptor_pool_size;
-
-  VkDescriptorPool pool;
-  VK_CHECK(vkCreateDescriptorPool(device.logical, &pool_info, device.allocator_callbacks, &pool));
-  defer { vkDestroyDescriptorPool(device.logical, pool, device.allocator_callbacks); };
-  // vkResetDescriptorPool(device.logical, pool, 0);
-
-  VkDescriptorPoolSize imgui_pool_sizes[] = { { VK_DESCRIPTOR_TYPE_SAMPLER, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 },
-                                              { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 } };
+  // the imgui backend frees its texture sets one by one, so it keeps a single FREE-able pool sized for the font
+  // and the handful of textures we hand it.
+  VkDescriptorPoolSize imgui_pool_sizes[] = { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16 } };
 
   VkDescriptorPoolCreateInfo imgui_pool_info = {};
   imgui_pool_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
   imgui_pool_info.flags                      = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-  imgui_pool_info.maxSets                    = 1000;
+  imgui_pool_info.maxSets                    = 16;
   imgui_pool_info.poolSizeCount              = ARRAY_SIZE(imgui_pool_sizes);
   imgui_pool_info.pPoolSizes                 = imgui_pool_sizes;
 
@@ -332,203 +650,200 @@ int main(int, char**) {
   VK_CHECK(vkCreateDescriptorPool(device.logical, &imgui_pool_info, device.allocator_callbacks, &imgui_pool));
   defer { vkDestroyDescriptorPool(device.logical, imgui_pool, device.allocator_callbacks); };
 
-  // VkPipeline pipeline;
-  VkPipelineLayoutCreateInfo compute_layout_create_info{};
-  compute_layout_create_info.sType          = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  compute_layout_create_info.pNext          = nullptr;
-  compute_layout_create_info.pSetLayouts    = &layout;
-  compute_layout_create_info.setLayoutCount = 1;
-
-  VkPushConstantRange push_constant_range{};
-  push_constant_range.offset     = 0;
-  push_constant_range.size       = sizeof(Compute_Push_Constants);
-  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-  compute_layout_create_info.pPushConstantRanges    = &push_constant_range;
-  compute_layout_create_info.pushConstantRangeCount = 1;
-
-  VkPipelineLayout compute_layout;
-  VK_CHECK(
-      vkCreatePipelineLayout(device.logical, &compute_layout_create_info, device.allocator_callbacks, &compute_layout));
-  defer { vkDestroyPipelineLayout(device.logical, compute_layout, device.allocator_callbacks); };
-
-  VkPipelineShaderStageCreateInfo gradient_pipeline_stage_info{};
-  gradient_pipeline_stage_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  gradient_pipeline_stage_info.pNext  = nullptr;
-  gradient_pipeline_stage_info.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
-  gradient_pipeline_stage_info.module = gradient_comp_shader_module;
-  gradient_pipeline_stage_info.pName  = "main";
-
-  VkComputePipelineCreateInfo gradient_compute_pipeline_create_info{};
-  gradient_compute_pipeline_create_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  gradient_compute_pipeline_create_info.pNext  = nullptr;
-  gradient_compute_pipeline_create_info.layout = compute_layout;
-  gradient_compute_pipeline_create_info.stage  = gradient_pipeline_stage_info;
-
-  VkPipeline gradient_compute_pipeline;
-  VK_CHECK(vkCreateComputePipelines(
-      device.logical,
-      VK_NULL_HANDLE,
-      1,
-      &gradient_compute_pipeline_create_info,
-      nullptr,
-      &gradient_compute_pipeline));
-  defer { vkDestroyPipeline(device.logical, gradient_compute_pipeline, device.allocator_callbacks); };
-
-  VkPipelineShaderStageCreateInfo sky_pipeline_stage_info{};
-  sky_pipeline_stage_info.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-  sky_pipeline_stage_info.pNext  = nullptr;
-  sky_pipeline_stage_info.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
-  sky_pipeline_stage_info.module = sky_comp_shader_module;
-  sky_pipeline_stage_info.pName  = "main";
-
-  VkComputePipelineCreateInfo sky_compute_pipeline_create_info{};
-  sky_compute_pipeline_create_info.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  sky_compute_pipeline_create_info.pNext  = nullptr;
-  sky_compute_pipeline_create_info.layout = compute_layout;
-  sky_compute_pipeline_create_info.stage  = sky_pipeline_stage_info;
-
-  VkPipeline sky_compute_pipeline;
-  VK_CHECK(vkCreateComputePipelines(
-      device.logical,
-      VK_NULL_HANDLE,
-      1,
-      &sky_compute_pipeline_create_info,
-      nullptr,
-      &sky_compute_pipeline));
-  defer { vkDestroyPipeline(device.logical, sky_compute_pipeline, device.allocator_callbacks); };
+  auto bindless = frame_allocator.push_no_init<Bindless_Heap>();
+  create_bindless_heap(frame_allocator, device, *bindless, FRAMES_IN_FLIGHT);
+  defer { destroy_bindless_heap(device, *bindless); };
+
+  auto uploads = frame_allocator.push_no_init<Upload_Manager>();
+  create_upload_manager(device, *uploads, mega_bytes(64));
+  defer { destroy_upload_manager(device, *uploads); };
+
+  Upload_Stream_Test stream_test = {};
+  stream_test.mib_per_frame      = 8;
+  {
+    VkBufferCreateInfo buffer_info = {};
+    buffer_info.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size               = Upload_Stream_Test::BUFFER_SIZE;
+    buffer_info.usage              = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo allocation_info = {};
+    allocation_info.usage                   = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    VK_CHECK(vmaCreateBuffer(
+        device.allocator,
+        &buffer_info,
+        &allocation_info,
+        &stream_test.buffer,
+        &stream_test.allocation,
+        nullptr));
+
+    u8* chunk = frame_allocator.push_array_no_init<u8>(Upload_Stream_Test::CHUNK_SIZE);
+    for (VkDeviceSize i = 0; i < Upload_Stream_Test::CHUNK_SIZE; ++i) chunk[i] = (u8)(i * 31);
+    stream_test.chunk = chunk;
+  }
+  defer { vmaDestroyBuffer(device.allocator, stream_test.buffer, stream_test.allocation); };
+
+  // sources under extra/kernel are built when they change, release builds load what was cached or built offline.
+  Shader_Compiler shaders;
+  create_shader_compiler(shaders, "shader_cache", "kernel");
+  defer { destroy_shader_compiler(shaders); };
+
+  Pipeline_Registry pipeline_registry;
+  create_pipeline_registry(pipeline_registry, device, &shaders);
+  defer { destroy_pipeline_registry(pipeline_registry); };
+
+  // the background kernels run with what suits the device, or with what was measured fastest on it.
+  Workgroup_Tuning workgroups;
+  create_workgroup_tuning(device, workgroups);
+  defer { destroy_workgroup_tuning(workgroups); };
+
+  const char* background_kernels[] = { "../extra/kernel/gradient.comp", "../extra/kernel/sky.comp" };
+  if (options.tune_workgroups) {
+    for (const char* kernel : background_kernels) {
+      if (workgroup_is_tuned(workgroups, kernel)) continue;
+      const VkExtent2D extent = { (u32)w, (u32)h };
+      const VkFormat format   = VK_FORMAT_R16G16B16A16_SFLOAT;
+      kernel_bench_tune(temp_allocator, device, *bindless, workgroups, &shaders, kernel, extent, format);
+    }
+  }
+
+  Compute_Pipeline_Desc gradient_desc = {};
+  gradient_desc.shader_path           = background_kernels[0];
+  gradient_desc.layout                = bindless->pipeline_layout;
+  gradient_desc.local_size            = workgroup_size_for(workgroups, gradient_desc.shader_path);
+  Pipeline_Handle gradient_pipeline   = pipeline_registry_add(pipeline_registry, gradient_desc);
+
+  // draw the gradient until the sky is ready.
+  Compute_Pipeline_Desc sky_desc = {};
+  sky_desc.shader_path           = background_kernels[1];
+  sky_desc.layout                = bindless->pipeline_layout;
+  sky_desc.local_size            = workgroup_size_for(workgroups, sky_desc.shader_path);
+  Pipeline_Handle sky_pipeline   = pipeline_registry_add(pipeline_registry, sky_desc, gradient_pipeline);
+
+  pipeline_registry_compile(pipeline_registry);
 
   struct Compute_Effect {
     const char* name;
-    VkPipeline pipeline;
-    VkPipelineLayout layout;
+    Pipeline_Handle pipeline;
     Compute_Push_Constants data;
+    bool time_varying; // dispatched every frame, the others only when their inputs changed.
   } background_effects[2];
 
-  background_effects[0].layout     = compute_layout;
-  background_effects[0].pipeline   = gradient_compute_pipeline;
-  background_effects[0].name       = "Gradient";
-  background_effects[0].data       = {};
-  background_effects[0].data.data1 = glm::vec4(1, 0, 0, 1);
-  background_effects[0].data.data2 = glm::vec4(0, 0, 1, 1);
+  background_effects[0].pipeline     = gradient_pipeline;
+  background_effects[0].name         = "Gradient";
+  background_effects[0].data         = {};
+  background_effects[0].data.data1   = glm::vec4(1, 0, 0, 1);
+  background_effects[0].data.data2   = glm::vec4(0, 0, 1, 1);
+  background_effects[0].time_varying = false;
+
+  background_effects[1].pipeline     = sky_pipeline;
+  background_effects[1].name         = "Sky";
+  background_effects[1].data         = {};
+  background_effects[1].data.data1   = glm::vec4(0.1, 0.2, 0.4, 0.97);
+  background_effects[1].time_varying = false;
 
-  background_effects[1].layout     = compute_layout;
-  background_effects[1].pipeline   = sky_compute_pipeline;
-  background_effects[1].name       = "Sky";
-  background_effects[1].data       = {};
-  background_effects[1].data.data1 = glm::vec4(0.1, 0.2, 0.4, 0.97);
+  // each queue signals its timeline once per frame, a frame slot is free again once its values are reached.
+  Timeline_Semaphore graphics_timeline;
+  create_timeline_semaphore(device, graphics_timeline);
+  defer { destroy_timeline_semaphore(device, graphics_timeline); };
+
+  Timeline_Semaphore compute_timeline;
+  create_timeline_semaphore(device, compute_timeline);
+  defer { destroy_timeline_semaphore(device, compute_timeline); };
 
   struct Frame_Data {
     VkCommandPool command_pool;
-    VkFence fence;
+    u64 timeline_value; // signaled when the gpu is done with the slot's last frame, 0 before the first one.
+    VkSemaphore image_acquired;
     VkCommandBuffer command_buffer;
+    VkCommandPool compute_command_pool; // async compute, only submitted when the graph has work there.
+    VkCommandBuffer compute_command_buffer;
+    u64 compute_timeline_value;
     VkFramebuffer framebuffer;
-    Image render_target;
-    VkDescriptorSet set;
+    Transient_Heap transients; // memory of the graph's intermediate images.
+    Image render_target;       // kept across frames, the background is only drawn again when its inputs change.
+    u32 render_target_index;
+    u64 background_hash; // of the inputs `render_target` was last drawn with, 0 when it holds nothing.
+    Pass_Cache pass_cache; // the passes recording the same commands as in the slot's earlier frames.
   };
 
-  u64 acc = 0;
+  u64 frame_number          = 0;
+  u64 background_dispatches = 0; // frames that drew the background, the others showed an earlier frame's.
 
   // initialize_frame_data
-  const auto num_images = surface.num_images; // used to test if something changed.
-  auto frame_data       = frame_allocator.push_array_no_init<Frame_Data>(surface.num_images);
+  auto frame_data = frame_allocator.push_array_no_init<Frame_Data>(FRAMES_IN_FLIGHT);
 
-  VkFormat rt_format               = VK_FORMAT_R16G16B16A16_SFLOAT;
-  VkExtent3D rt_extent             = { (u32)surface.width, (u32)surface.height, 1 };
-  VkImageUsageFlags rt_usage_flags = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+  Transient_Image_Desc rt_desc = {};
+  rt_desc.format               = VK_FORMAT_R16G16B16A16_SFLOAT;
+  rt_desc.extent               = { (u32)surface.width, (u32)surface.height, 1 };
+  rt_desc.usage                = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
       VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  VkImageCreateInfo rt_create_info = {};
-  rt_create_info.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-  rt_create_info.pNext             = nullptr;
-  rt_create_info.imageType         = VK_IMAGE_TYPE_2D;
-  rt_create_info.format            = rt_format;
-  rt_create_info.extent            = rt_extent;
-  rt_create_info.mipLevels         = 1;
-  rt_create_info.arrayLayers       = 1;
-  // for MSAA. we will not be using it by default, so default it to 1 sample per pixel.
-  rt_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
-  // optimal tiling, which means the image is stored on the best gpu format
-  rt_create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
-  rt_create_info.usage  = rt_usage_flags;
-
-  VmaAllocationCreateInfo rt_alloc_info = {};
-  rt_alloc_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
-  rt_alloc_info.requiredFlags           = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-  VmaAllocationInfo alloc_info = {};
-
-  for (auto i = 0; i < num_images; ++i) {
-    frame_data[i].command_pool   = create_command_pool(&device, false);
+  for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+    frame_data[i].command_pool   = create_command_pool(&device, device.queue_family, false);
     frame_data[i].command_buffer = allocate_command_buffer(&device, frame_data[i].command_pool, true);
-    frame_data[i].fence          = create_fence(&device, true);
-
-    VK_CHECK(vmaCreateImage(
-        device.allocator,
-        &rt_create_info,
-        &rt_alloc_info,
-        &frame_data[i].render_target.image,
-        &frame_data[i].render_target.allocation,
-        &alloc_info));
-    // print alloc_info out here.
-
-    VkImageViewCreateInfo rt_view_create_info = {};
-    rt_view_create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    rt_view_create_info.pNext                 = nullptr;
-
-    rt_view_create_info.viewType                        = VK_IMAGE_VIEW_TYPE_2D;
-    rt_view_create_info.image                           = frame_data[i].render_target.image;
-    rt_view_create_info.format                          = rt_format;
-    rt_view_create_info.subresourceRange.baseMipLevel   = 0;
-    rt_view_create_info.subresourceRange.levelCount     = 1;
-    rt_view_create_info.subresourceRange.baseArrayLayer = 0;
-    rt_view_create_info.subresourceRange.layerCount     = 1;
-    rt_view_create_info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-    VK_CHECK(vkCreateImageView(
-        device.logical,
-        &rt_view_create_info,
-        device.allocator_callbacks,
-        &frame_data[i].render_target.view));
-    frame_data[i].render_target.extent = rt_extent;
-    frame_data[i].render_target.format = rt_format;
-
-    VkDescriptorSetAllocateInfo set_alloc_info = {};
-    set_alloc_info.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    set_alloc_info.pNext                       = nullptr;
-    set_alloc_info.descriptorPool              = pool;
-    set_alloc_info.descriptorSetCount          = 1;
-    set_alloc_info.pSetLayouts                 = &layout;
-    VK_CHECK(vkAllocateDescriptorSets(device.logical, &set_alloc_info, &frame_data[i].set));
-
-    VkDescriptorImageInfo image_info{};
-    image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-    image_info.imageView   = frame_data[i].render_target.view;
-
-    VkWriteDescriptorSet draw_image_write = {};
-    draw_image_write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    draw_image_write.pNext                = nullptr;
-
-    draw_image_write.dstBinding      = 0;
-    draw_image_write.dstSet          = frame_data[i].set;
-    draw_image_write.descriptorCount = 1;
-    draw_image_write.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    draw_image_write.pImageInfo      = &image_info;
-    vkUpdateDescriptorSets(device.logical, 1, &draw_image_write, 0, nullptr);
+    frame_data[i].timeline_value = 0;
+    frame_data[i].image_acquired = create_semaphore(&device);
+
+    frame_data[i].compute_command_pool   = create_command_pool(&device, device.compute_queue_family, false);
+    frame_data[i].compute_command_buffer = allocate_command_buffer(&device, frame_data[i].compute_command_pool, true);
+    frame_data[i].compute_timeline_value = 0;
+
+    create_transient_heap(frame_data[i].transients);
+    frame_data[i].render_target       = {};
+    frame_data[i].render_target_index = (u32)-1;
+    frame_data[i].background_hash     = 0;
+    create_pass_cache(device, frame_data[i].pass_cache, bind_bindless_pass, bindless);
   }
 
   defer {
-    for (auto i = 0; i < num_images; ++i) {
+    for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
       vkDestroyCommandPool(device.logical, frame_data[i].command_pool, device.allocator_callbacks);
-      vkDestroyImageView(device.logical, frame_data[i].render_target.view, device.allocator_callbacks);
-      vmaDestroyImage(device.allocator, frame_data[i].render_target.image, frame_data[i].render_target.allocation);
-      vkDestroyFence(device.logical, frame_data[i].fence, device.allocator_callbacks);
+      vkDestroyCommandPool(device.logical, frame_data[i].compute_command_pool, device.allocator_callbacks);
+      destroy_transient_heap(device, frame_data[i].transients);
+      destroy_render_target(device, frame_data[i].render_target);
+      destroy_pass_cache(frame_data[i].pass_cache);
+      vkDestroySemaphore(device.logical, frame_data[i].image_acquired, device.allocator_callbacks);
     }
   };
 
-  u8 sync_idx = 0;
+  auto gpu_profiler =
+      create_gpu_profiler(temp_allocator, device, FRAMES_IN_FLIGHT, device.queue, device.queue_family, "gpu");
+  defer { destroy_gpu_profiler(device, gpu_profiler); };
+
+  auto compute_profiler = create_gpu_profiler(
+      temp_allocator,
+      device,
+      FRAMES_IN_FLIGHT,
+      device.compute_queue,
+      device.compute_queue_family,
+      "gpu async compute");
+  defer { destroy_gpu_profiler(device, compute_profiler); };
+
+  Async_Compute_Bench async_bench = {};
+
+  auto render_graph = frame_allocator.push_no_init<Render_Graph>();
+  render_graph_reset(*render_graph);
+
+  auto frame_stats = frame_allocator.push_no_init<Frame_Stats>();
+  frame_stats_init(*frame_stats);
+  defer { frame_stats_write_csv(*frame_stats, "frame_stats.csv"); };
+
+  u64 last_frame_ticks   = os_now_ticks();
+  u64 last_present_ticks = 0;
+
+  Frame_Pacer frame_pacer;
+  create_frame_pacer(device, frame_pacer);
 
-  ImGui_ImplGlfw_InitForVulkan(window, true);
-  defer { ImGui_ImplGlfw_Shutdown(); };
+  // a 60hz frame with some room to spare. headless runs keep the full size, their readbacks are compared.
+  Dynamic_Resolution resolution;
+  create_dynamic_resolution(resolution, 14.0f);
+  resolution.enabled = !surface.headless;
+
+  if (window) ImGui_ImplGlfw_InitForVulkan(window, true);
+  defer {
+    if (window) ImGui_ImplGlfw_Shutdown();
+  };
 
   VkPipelineRenderingCreateInfoKHR dynamic_rendering_create_info = {};
   dynamic_rendering_create_info.sType                            = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
@@ -544,9 +859,11 @@ int main(int, char**) {
   init_info.Queue                       = device.queue;
   init_info.DescriptorPool              = imgui_pool;
   init_info.MinImageCount               = surface.num_images;
-  init_info.ImageCount                  = surface.num_images;
+  // imgui rotates its vertex buffers through this many frames, it has to cover every frame in flight.
+  init_info.ImageCount = FRAMES_IN_FLIGHT > (u32)surface.num_images ? FRAMES_IN_FLIGHT : surface.num_images;
   init_info.UseDynamicRendering         = true;
   init_info.Allocator                   = device.allocator_callbacks;
+  init_info.PipelineCache               = device.pipeline_cache;
   init_info.PipelineRenderingCreateInfo = dynamic_rendering_create_info;
   ImGui_ImplVulkan_Init(&init_info);
   defer { ImGui_ImplVulkan_Shutdown(); };
@@ -554,10 +871,38 @@ int main(int, char**) {
   ImGui_ImplVulkan_CreateFontsTexture();
 
   // main loop
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
+  pipeline_registry_wait(pipeline_registry, gradient_pipeline);
+  while (options.headless ? frame_number < options.frames : !glfwWindowShouldClose(window)) {
+    PROFILE_FRAME_MARK();
+    PROFILE_SCOPE("frame");
+
+    Frame_Sample frame_sample = {};
+    {
+      u64 now                                     = os_now_ticks();
+      frame_sample.ms[(u32)Frame_Stat::cpu_frame] = (f32)os_ticks_to_ms(now - last_frame_ticks);
+      last_frame_ticks                            = now;
+    }
+
+    // as late as possible before the input is sampled.
+    frame_pacer_begin(device, frame_pacer, surface, graphics_timeline);
+    frame_sample.ms[(u32)Frame_Stat::pacing] = frame_pacer.wait_ms;
+
+    {
+      PROFILE_SCOPE("poll events");
+      if (window) glfwPollEvents();
+    }
+
+    {
+      PROFILE_SCOPE("imgui new frame");
+      if (window) {
+        ImGui_ImplGlfw_NewFrame();
+      } else {
+        // nothing feeds imgui without a window, a fixed step keeps headless runs reproducible.
+        io.DisplaySize = ImVec2((f32)surface.width, (f32)surface.height);
+        io.DeltaTime   = 1.0f / 60.0f;
+      }
+      ImGui::NewFrame();
+    }
 
     // 1. Show the big demo window (Most of the sample code is in ImGui::ShowDemoWindow()! You can browse its code
     // to learn more about Dear ImGui!).
@@ -567,12 +912,80 @@ int main(int, char**) {
     static bool show_metric_window = true;
     if (show_metric_window) ImGui::ShowMetricsWindow(&show_metric_window);
 
+    static bool show_profiler_window = true;
+    if (show_profiler_window) profiler_draw_imgui(&show_profiler_window);
+
+    static bool show_gpu_profiler_window = true;
+    if (show_gpu_profiler_window) gpu_profiler_draw_imgui(gpu_profiler, &show_gpu_profiler_window);
+
+    static bool show_sampling_profiler_window = true;
+    if (show_sampling_profiler_window) sampling_profiler_draw_imgui(&show_sampling_profiler_window);
+
+    static bool show_render_graph_window = true;
+    if (show_render_graph_window) render_graph_draw_imgui(*render_graph, &show_render_graph_window);
+
+    static bool show_frame_stats_window = true;
+    if (show_frame_stats_window) frame_stats_draw_imgui(*frame_stats, &show_frame_stats_window);
+
+    static bool show_compute_profiler_window = true;
+    if (show_compute_profiler_window && device.async_compute)
+      gpu_profiler_draw_imgui(compute_profiler, &show_compute_profiler_window);
+
+    static bool show_async_compute_window = true;
+    static bool use_async_compute         = true;
+    if (show_async_compute_window)
+      async_compute_draw_imgui(
+          device,
+          gpu_profiler,
+          compute_profiler,
+          async_bench,
+          use_async_compute,
+          &show_async_compute_window);
+
+    static bool show_frame_pacer_window = true;
+    if (show_frame_pacer_window && frame_pacer_draw_imgui(frame_pacer, surface, &show_frame_pacer_window))
+      swapchain_dirty = true;
+
+    static bool show_resolution_window = true;
+    if (show_resolution_window) {
+      const VkExtent2D max_extent = { rt_desc.extent.width, rt_desc.extent.height };
+      dynamic_resolution_draw_imgui(resolution, max_extent, &show_resolution_window);
+    }
+
+    static bool show_readbacks_window = true;
+    if (show_readbacks_window) readback_draw_imgui(readbacks, &show_readbacks_window);
+
+    static bool show_capture_window = true;
+    if (show_capture_window) capture_draw_imgui(capture, surface, &show_capture_window);
+
+    static bool show_uploads_window = true;
+    if (show_uploads_window) upload_draw_imgui(*uploads, &show_uploads_window);
+
+    static bool show_upload_stream_test_window = true;
+    if (show_upload_stream_test_window)
+      upload_stream_test_draw_imgui(stream_test, *uploads, &show_upload_stream_test_window);
+
     static bool show_background_window   = true;
     static int current_background_effect = 0;
     if (show_background_window && ImGui::Begin("background", &show_background_window)) {
       Compute_Effect& selected = background_effects[current_background_effect];
       ImGui::Text("Selected effect: %s", selected.name);
+      if (!pipeline_registry_is_ready(pipeline_registry, selected.pipeline)) ImGui::Text("(compiling, using fallback)");
+      const Pipeline_Handle bound = pipeline_registry_resolve(pipeline_registry, selected.pipeline);
+      if (pipeline_registry_get(pipeline_registry, bound)) {
+        const Workgroup_Size local_size = pipeline_registry_local_size(pipeline_registry, bound);
+        ImGui::Text("workgroup %ux%u, subgroup size %u", local_size.x, local_size.y, workgroups.subgroup_size);
+      }
+      const auto dispatches = (unsigned long long)background_dispatches;
+      ImGui::Text("dispatched on %llu of %llu frames", dispatches, (unsigned long long)frame_number);
+      unsigned long long recorded = 0, reused = 0;
+      for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) {
+        recorded += frame_data[i].pass_cache.recorded;
+        reused += frame_data[i].pass_cache.reused;
+      }
+      ImGui::Text("cached passes recorded %llu times, reused %llu times", recorded, reused);
       ImGui::SliderInt("Effect Index", &current_background_effect, 0, ARRAY_SIZE(background_effects) - 1);
+      ImGui::Checkbox("time varying", &selected.time_varying);
       ImGui::SliderFloat4("data1", (float*)&selected.data.data1, 0.0, 1.0);
       ImGui::SliderFloat4("data2", (float*)&selected.data.data2, 0.0, 1.0);
       ImGui::SliderFloat4("data3", (float*)&selected.data.data3, 0.0, 1.0);
@@ -580,147 +993,314 @@ int main(int, char**) {
       ImGui::End();
     }
 
-    ImGui::Render();
+    {
+      PROFILE_SCOPE("imgui render");
+      ImGui::Render();
+    }
 
     auto main_draw_data          = ImGui::GetDrawData();
     const bool main_is_minimized = (main_draw_data->DisplaySize.x <= 0.0f || main_draw_data->DisplaySize.y <= 0.0f);
     if (main_is_minimized) continue;
 
-    auto& current_frame = frame_data[surface.frame_idx];
-    VK_CHECK(vkWaitForFences(device.logical, 1, &current_frame.fence, true, UINT64_MAX));
-    VK_CHECK(vkResetFences(device.logical, 1, &current_frame.fence));
-
-    VkResult result = vkAcquireNextImageKHR(
-        device.logical,
-        surface.swapchain,
-        UINT64_MAX,
-        surface.image_avail[sync_idx],
-        nullptr,
-        &surface.frame_idx);
-    if (result != VK_SUCCESS) {
-      // may need to resize here.
+    const u32 frame_slot = (u32)(frame_number % FRAMES_IN_FLIGHT);
+    auto& current_frame  = frame_data[frame_slot];
+    {
+      PROFILE_SCOPE("wait for frame slot");
+      u64 begin = os_now_ticks();
+      timeline_wait(device, graphics_timeline, current_frame.timeline_value);
+      timeline_wait(device, compute_timeline, current_frame.compute_timeline_value);
+      frame_sample.ms[(u32)Frame_Stat::frame_wait] = (f32)os_ticks_to_ms(os_now_ticks() - begin);
+    }
+    delay_queue_flush(*retired, graphics_timeline.completed);
+    readback_update(device, readbacks, graphics_timeline.completed);
+
+    // headless images have a fixed size and no present mode.
+    if (!surface.headless) {
+      s32 framebuffer_width = 0, framebuffer_height = 0;
+      glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+      if (framebuffer_width != surface.width || framebuffer_height != surface.height) swapchain_dirty = true;
+
+      // no wait on the gpu: the next frame is the first one that can't touch the old swapchain, it's destroyed
+      // once that frame is done. the render targets follow, each frame slot replaces its own once it is idle.
+      if (swapchain_dirty) {
+        const u64 retire_value = graphics_timeline.submitted + 1;
+        if (!resize_surface(
+                temp_allocator,
+                device,
+                surface,
+                framebuffer_width,
+                framebuffer_height,
+                *retired,
+                retire_value))
+          continue;
+        swapchain_dirty = false;
+        rt_desc.extent  = { (u32)surface.width, (u32)surface.height, 1 };
+        frame_pacer_swapchain_recreated(frame_pacer);
+        // recorded with the old swapchain images, the new ones may come back with the same handles.
+        for (u32 i = 0; i < FRAMES_IN_FLIGHT; ++i) pass_cache_invalidate(frame_data[i].pass_cache);
+      }
+    }
+    VkResult result = VK_SUCCESS;
+    if (surface.headless) {
+      // each image was last rendered num_images frames back, before the frame whose slot was just waited for.
+      static_assert(FRAMES_IN_FLIGHT < Surface::MAX_IMAGES, "headless images would be reused while in flight");
+      surface.frame_idx = (u32)(frame_number % surface.num_images);
+    } else {
+      PROFILE_SCOPE("acquire image");
+      u64 begin = os_now_ticks();
+      result    = vkAcquireNextImageKHR(
+          device.logical,
+          surface.swapchain,
+          UINT64_MAX,
+          current_frame.image_acquired,
+          nullptr,
+          &surface.frame_idx);
+      frame_sample.ms[(u32)Frame_Stat::acquire] = (f32)os_ticks_to_ms(os_now_ticks() - begin);
+    }
+    // suboptimal still signals the semaphore and hands out an image, so the frame has to go through and the
+    // swapchain is recreated next frame. out of date doesn't, there's nothing to render to.
+    if (result == VK_SUBOPTIMAL_KHR) swapchain_dirty = true;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      swapchain_dirty = true;
       continue;
     }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      VK_CHECK(result);
+      continue;
+    }
+    // only once the frame is certain to be submitted, the bindless heap counts frames to know what is idle.
+    bindless_begin_frame(*bindless);
 
-    vkResetCommandPool(device.logical, current_frame.command_pool, 0);
+    auto& selected_background_effect = background_effects[current_background_effect];
 
-    begin_command(current_frame.command_buffer, 0);
+    // the effect's fallback is drawn while it compiles, the dispatch has to follow whichever one is bound.
+    const Pipeline_Handle background_handle =
+        pipeline_registry_resolve(pipeline_registry, selected_background_effect.pipeline);
+
+    Frame_Passes passes        = {};
+    passes.background_pipeline = pipeline_registry_get(pipeline_registry, background_handle);
+    passes.pipeline_layout     = bindless->pipeline_layout;
+    passes.push_constants      = &selected_background_effect.data;
+    passes.render_extent       = dynamic_resolution_extent(resolution, { rt_desc.extent.width, rt_desc.extent.height });
+    passes.swapchain_image     = surface.images[surface.frame_idx];
+    passes.swapchain_view      = surface.image_views[surface.frame_idx];
+    passes.surface_extent      = { (u32)surface.width, (u32)surface.height };
+    passes.draw_data           = main_draw_data;
+    if (passes.background_pipeline)
+      passes.background_local_size = pipeline_registry_local_size(pipeline_registry, background_handle);
+
+    // the slot is idle, its render target can be replaced. the kernels find it through the slot's bindless index.
+    const VkExtent3D rt_extent = current_frame.render_target.extent;
+    if (rt_extent.width != rt_desc.extent.width || rt_extent.height != rt_desc.extent.height) {
+      destroy_render_target(device, current_frame.render_target);
+      current_frame.render_target   = create_render_target(device, rt_desc);
+      current_frame.background_hash = 0;
+      pass_cache_invalidate(current_frame.pass_cache);
+
+      const VkImageView view = current_frame.render_target.view;
+      if (current_frame.render_target_index == (u32)-1)
+        current_frame.render_target_index = bindless_add_storage_image(device, *bindless, view);
+      else
+        bindless_update_storage_image(device, *bindless, current_frame.render_target_index, view);
+    }
+    selected_background_effect.data.target_index = current_frame.render_target_index;
+    selected_background_effect.data.width        = passes.render_extent.width;
+    selected_background_effect.data.height       = passes.render_extent.height;
+
+    // the render target still holds what the slot drew last time, drawing the same again would only cost bandwidth.
+    // everything the kernel reads is in the hash: the pipeline, its push constants (target, extent and the effect's
+    // parameters) and the image itself.
+    u64 background_hash = 0;
+    if (passes.background_pipeline) {
+      background_hash = hash_bytes(&passes.background_pipeline, sizeof(VkPipeline));
+      background_hash = hash_bytes(&passes.background_local_size, sizeof(Workgroup_Size), background_hash);
+      background_hash = hash_bytes(passes.push_constants, sizeof(Compute_Push_Constants), background_hash);
+      background_hash = hash_bytes(&current_frame.render_target.image, sizeof(VkImage), background_hash);
+    }
+    // the async compute comparison has to time the dispatch.
+    const bool draw_background = selected_background_effect.time_varying || async_bench.running ||
+        background_hash == 0 || background_hash != current_frame.background_hash;
+    current_frame.background_hash = background_hash;
+    if (draw_background && passes.background_pipeline) background_dispatches++;
+
+    Capture_Pass captures[2] = {};
+    u32 capture_count        = 0;
+
+    bool background_on_async = use_async_compute;
+    if (async_bench.running) background_on_async = async_bench.run == 1;
+    const Render_Queue background_queue = background_on_async ? Render_Queue::async_compute : Render_Queue::graphics;
+
+    {
+      PROFILE_SCOPE("build render graph");
+      render_graph_reset(*render_graph);
+      // left ready for the next blit, which may be all the slot's next frame does with it.
+      Graph_Image render_target = render_graph_import_image(
+          *render_graph,
+          "render target",
+          current_frame.render_target.image,
+          VK_IMAGE_ASPECT_COLOR_BIT,
+          draw_background ? Image_Usage::undefined : Image_Usage::transfer_src,
+          Image_Usage::transfer_src);
+      // headless images start over each frame and stay readable afterwards.
+      Graph_Image swapchain = render_graph_import_image(
+          *render_graph,
+          "swapchain",
+          passes.swapchain_image,
+          VK_IMAGE_ASPECT_COLOR_BIT,
+          surface.headless ? Image_Usage::undefined : Image_Usage::acquired,
+          surface.headless ? Image_Usage::transfer_src : Image_Usage::present);
+
+      if (draw_background) {
+        u32 background =
+            render_graph_add_pass(*render_graph, "background", background_pass, &passes, false, background_queue);
+        render_graph_use_image(*render_graph, background, render_target, Image_Usage::compute_write);
+        // the same inputs as the skip above, only time varying effects get here without them changing.
+        if (background_hash) render_graph_cache_pass(*render_graph, background, background_hash);
+      }
+
+      u32 blit = render_graph_add_pass(*render_graph, "blit", blit_pass, &passes);
+      render_graph_use_image(*render_graph, blit, render_target, Image_Usage::transfer_src);
+      render_graph_use_image(*render_graph, blit, swapchain, Image_Usage::transfer_dst);
+      {
+        u64 blit_hash = hash_bytes(&current_frame.render_target.image, sizeof(VkImage));
+        blit_hash     = hash_bytes(&passes.swapchain_image, sizeof(VkImage), blit_hash);
+        blit_hash     = hash_bytes(&passes.render_extent, sizeof(VkExtent2D), blit_hash);
+        blit_hash     = hash_bytes(&passes.surface_extent, sizeof(VkExtent2D), blit_hash);
+        render_graph_cache_pass(*render_graph, blit, blit_hash);
+      }
+
+      u32 imgui = render_graph_add_pass(*render_graph, "imgui", imgui_pass, &passes);
+      render_graph_use_image(*render_graph, imgui, swapchain, Image_Usage::color_attachment_load);
+
+      // the copies land a few frames later, nothing here waits for them.
+      const bool capture_swapchain = capture.swapchain || capture.record;
+      if (readback_last_frame && frame_number + 1 == options.frames) {
+        u32 slot = readback_request(
+            device,
+            readbacks,
+            surface.width,
+            surface.height,
+            surface.format.format,
+            frame_number,
+            readback_encoding,
+            options.readback_path);
+        if (slot != (u32)-1) {
+          captures[capture_count] = { render_graph, &readbacks, swapchain, slot };
+          add_capture_pass(*render_graph, captures[capture_count++], "readback");
+        }
+      } else if (capture_swapchain && surface.readable && readback_supports_format(surface.format.format)) {
+        char path[Readback_Manager::PATH_SIZE];
+        snprintf(path, sizeof(path), "capture_%05u.%s", capture.counter, capture_extension(capture.encoding));
+        u32 slot = readback_request(
+            device,
+            readbacks,
+            surface.width,
+            surface.height,
+            surface.format.format,
+            frame_number,
+            capture.encoding,
+            path);
+        if (slot != (u32)-1) {
+          captures[capture_count] = { render_graph, &readbacks, swapchain, slot };
+          add_capture_pass(*render_graph, captures[capture_count++], "capture swapchain");
+          capture.counter++;
+        }
+      }
+      if (capture.render_target) {
+        char path[Readback_Manager::PATH_SIZE];
+        snprintf(path, sizeof(path), "capture_rt_%05u.%s", capture.counter, capture_extension(capture.encoding));
+        u32 slot = readback_request(
+            device,
+            readbacks,
+            passes.render_extent.width,
+            passes.render_extent.height,
+            rt_desc.format,
+            frame_number,
+            capture.encoding,
+            path);
+        if (slot != (u32)-1) {
+          captures[capture_count] = { render_graph, &readbacks, render_target, slot };
+          add_capture_pass(*render_graph, captures[capture_count++], "capture render target");
+          capture.counter++;
+        }
+      }
+      capture.swapchain     = false;
+      capture.render_target = false;
+
+      render_graph_compile(device, *render_graph, current_frame.transients);
+      passes.render_target = render_graph_image(*render_graph, render_target);
+    }
 
-    transition_image(
-        current_frame.command_buffer,
-        current_frame.render_target.image,
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_GENERAL);
+    {
+      PROFILE_SCOPE("uploads");
+      upload_stream_test_update(device, *uploads, stream_test);
+      upload_flush(device, *uploads);
+    }
 
-    auto& selected_background_effect = background_effects[current_background_effect];
-    vkCmdBindPipeline(
-        current_frame.command_buffer,
-        VK_PIPELINE_BIND_POINT_COMPUTE,
-        selected_background_effect.pipeline);
-
-    // bind the descriptor set containing the draw image for the compute pipeline
-
-    vkCmdBindDescriptorSets(
-        current_frame.command_buffer,
-        VK_PIPELINE_BIND_POINT_COMPUTE,
-        selected_background_effect.layout,
-        0,
-        1,
-        &current_frame.set,
-        0,
-        nullptr);
-    
-    vkCmdPushConstants(
-        current_frame.command_buffer,
-        selected_background_effect.layout,
-        VK_SHADER_STAGE_COMPUTE_BIT,
-        0,
-        sizeof(Compute_Push_Constants),
-        &selected_background_effect.data);
-
-    // execute the compute pipeline dispatch. We are using 16x16 workgroup size so we need to divide by it
-    vkCmdDispatch(
-        current_frame.command_buffer,
-        (u32)ceil(current_frame.render_target.extent.width / 16.0),
-        (u32)ceil(current_frame.render_target.extent.height / 16.0),
-        1);
-
-    // // make a clear-color from frame number. This will flash with a 120 frame period.
-    // VkClearColorValue clear_value = { { 0.0f, 0.0f, (float)fabs(sin(acc / 120.f)), 1.0f } };
-
-    // VkImageSubresourceRange clear_range = {};
-    // clear_range.aspectMask              = VK_IMAGE_ASPECT_COLOR_BIT;
-    // clear_range.baseMipLevel            = 0;
-    // clear_range.levelCount              = VK_REMAINING_MIP_LEVELS;
-    // clear_range.baseArrayLayer          = 0;
-    // clear_range.layerCount              = VK_REMAINING_ARRAY_LAYERS;
-
-    // // clear image
-    // vkCmdClearColorImage(
-    //     current_frame.command_buffer,
-    //     current_frame.render_target.image,
-    //     VK_IMAGE_LAYOUT_GENERAL,
-    //     &clear_value,
-    //     1,
-    //     &clear_range);
-
-    transition_image(
-        current_frame.command_buffer,
-        current_frame.render_target.image,
-        VK_IMAGE_LAYOUT_GENERAL,
-        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    transition_image(
-        current_frame.command_buffer,
-        surface.images[surface.frame_idx],
-        VK_IMAGE_LAYOUT_UNDEFINED,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    VkExtent2D render_extent = { current_frame.render_target.extent.width, current_frame.render_target.extent.height };
-
-    VkExtent2D surface_extent = { (u32)surface.width, (u32)surface.height };
-    copy_image_to_image(
-        current_frame.command_buffer,
-        current_frame.render_target.image,
-        surface.images[surface.frame_idx],
-        render_extent,
-        surface_extent);
-
-    transition_image(
-        current_frame.command_buffer,
-        surface.images[surface.frame_idx],
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-
-    VkRenderingAttachmentInfo color_attachment = {};
-    color_attachment.sType                     = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-    color_attachment.pNext                     = nullptr;
-    color_attachment.imageView                 = surface.image_views[surface.frame_idx];
-    color_attachment.imageLayout               = VK_IMAGE_LAYOUT_GENERAL;
-    color_attachment.loadOp =
-        VK_ATTACHMENT_LOAD_OP_LOAD; // clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-    color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    // if (clear)  color_attachment.clearValue = *clear;
-    VkRenderingInfo render_info      = {}; // vkinit::rendering_info(_swapchainExtent, &colorAttachment, nullptr);
-    render_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO;
-    render_info.pNext                = nullptr;
-    render_info.colorAttachmentCount = 1;
-    render_info.pColorAttachments    = &color_attachment;
-    render_info.layerCount           = 1;
-    VkRect2D rect                    = {};
-    rect.extent                      = surface_extent;
-    render_info.renderArea           = rect;
-
-    vkCmdBeginRendering(current_frame.command_buffer, &render_info);
-
-    ImGui_ImplVulkan_RenderDrawData(main_draw_data, current_frame.command_buffer);
-    vkCmdEndRendering(current_frame.command_buffer);
-
-    transition_image(
-        current_frame.command_buffer,
-        surface.images[surface.frame_idx],
-        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    PROFILE_SCOPE("record commands");
+
+    // async compute is submitted first so it can start while the gpu still works on the previous frame's graphics.
+    const bool async_work = render_graph_has_work(*render_graph, Render_Queue::async_compute);
+    if (async_work) {
+      VkCommandBuffer cmd = current_frame.compute_command_buffer;
+      vkResetCommandPool(device.logical, current_frame.compute_command_pool, 0);
+
+      begin_command(cmd, 0);
+      bindless_bind(*bindless, cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+      gpu_profiler_begin_frame(device, compute_profiler, frame_slot, cmd);
+      {
+        GPU_PROFILE_SCOPE(compute_profiler, cmd, "frame");
+        render_graph_execute(
+            *render_graph,
+            Render_Queue::async_compute,
+            cmd,
+            &compute_profiler,
+            &current_frame.pass_cache);
+      }
+      gpu_profiler_end_frame(compute_profiler, cmd);
+      VK_CHECK(vkEndCommandBuffer(cmd));
+
+      current_frame.compute_timeline_value = timeline_next_value(compute_timeline);
+
+      VkCommandBufferSubmitInfo compute_command_buffer_info = {};
+      compute_command_buffer_info.sType                     = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+      compute_command_buffer_info.commandBuffer             = cmd;
+
+      VkSemaphoreSubmitInfo compute_signal_info = {};
+      compute_signal_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      compute_signal_info.semaphore             = compute_timeline.semaphore;
+      compute_signal_info.value                 = current_frame.compute_timeline_value;
+      compute_signal_info.stageMask             = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+      VkSubmitInfo2 compute_submit_info            = {};
+      compute_submit_info.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+      compute_submit_info.commandBufferInfoCount   = 1;
+      compute_submit_info.pCommandBufferInfos      = &compute_command_buffer_info;
+      compute_submit_info.signalSemaphoreInfoCount = 1;
+      compute_submit_info.pSignalSemaphoreInfos    = &compute_signal_info;
+
+      PROFILE_SCOPE("submit async compute");
+      VK_CHECK(vkQueueSubmit2(device.compute_queue, 1, &compute_submit_info, VK_NULL_HANDLE));
+    }
 
+    vkResetCommandPool(device.logical, current_frame.command_pool, 0);
+
+    begin_command(current_frame.command_buffer, 0);
+    bindless_bind(*bindless, current_frame.command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+    gpu_profiler_begin_frame(device, gpu_profiler, frame_slot, current_frame.command_buffer);
+    async_compute_bench_sample(async_bench, gpu_profiler, compute_profiler);
+    dynamic_resolution_update(resolution, gpu_frame_ms(gpu_profiler, use_async_compute ? &compute_profiler : nullptr));
+    const u64 upload_wait_value = upload_acquire(device, *uploads, current_frame.command_buffer);
+    {
+      GPU_PROFILE_SCOPE(gpu_profiler, current_frame.command_buffer, "frame");
+      render_graph_execute(
+          *render_graph,
+          Render_Queue::graphics,
+          current_frame.command_buffer,
+          &gpu_profiler,
+          &current_frame.pass_cache);
+    }
+    gpu_profiler_end_frame(gpu_profiler, current_frame.command_buffer);
     VK_CHECK(vkEndCommandBuffer(current_frame.command_buffer));
 
     if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
@@ -734,45 +1314,120 @@ int main(int, char**) {
     command_buffer_submit_info.deviceMask                = 0;
     command_buffer_submit_info.pNext                     = nullptr;
 
-    VkSemaphoreSubmitInfo wait_semaphore_submit_info = {};
-    wait_semaphore_submit_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-    wait_semaphore_submit_info.semaphore             = surface.image_avail[sync_idx];
-    wait_semaphore_submit_info.deviceIndex           = 0;
-    wait_semaphore_submit_info.value                 = 1;
-    wait_semaphore_submit_info.stageMask             = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+    VkSemaphoreSubmitInfo wait_semaphore_submit_infos[3] = {};
+    u32 wait_semaphore_count                             = 0;
+    if (!surface.headless) {
+      auto& wait_info       = wait_semaphore_submit_infos[wait_semaphore_count++];
+      wait_info.sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      wait_info.semaphore   = current_frame.image_acquired;
+      wait_info.deviceIndex = 0;
+      wait_info.value       = 1;
+      wait_info.stageMask   = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+    }
 
-    VkSemaphoreSubmitInfo signal_semaphore_submit_info = {};
-    signal_semaphore_submit_info.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-    signal_semaphore_submit_info.semaphore             = surface.render_done[sync_idx];
-    signal_semaphore_submit_info.deviceIndex           = 0;
-    signal_semaphore_submit_info.value                 = 1;
-    signal_semaphore_submit_info.stageMask             = VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT;
+    if (async_work) {
+      // only the passes consuming async compute results wait, the rest of the frame goes ahead.
+      const VkPipelineStageFlags2 wait_stages = render_graph->async_wait_stages;
+
+      auto& wait_info     = wait_semaphore_submit_infos[wait_semaphore_count++];
+      wait_info.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      wait_info.semaphore = compute_timeline.semaphore;
+      wait_info.value     = current_frame.compute_timeline_value;
+      wait_info.stageMask = wait_stages ? wait_stages : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
+    if (upload_wait_value) {
+      // already signaled, orders the finished uploads before anything in the frame.
+      auto& wait_info     = wait_semaphore_submit_infos[wait_semaphore_count++];
+      wait_info.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      wait_info.semaphore = uploads->timeline.semaphore;
+      wait_info.value     = upload_wait_value;
+      wait_info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
+
+    // the graph's last barrier moves the swapchain image to present without a destination stage, the signals have
+    // to wait on everything for that transition to be ordered before present.
+    current_frame.timeline_value = timeline_next_value(graphics_timeline);
+
+    VkSemaphoreSubmitInfo signal_semaphore_submit_infos[2] = {};
+    signal_semaphore_submit_infos[0].sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signal_semaphore_submit_infos[0].semaphore             = graphics_timeline.semaphore;
+    signal_semaphore_submit_infos[0].deviceIndex           = 0;
+    signal_semaphore_submit_infos[0].value                 = current_frame.timeline_value;
+    signal_semaphore_submit_infos[0].stageMask             = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    u32 signal_semaphore_count                             = 1;
+    if (!surface.headless) {
+      auto& signal_info       = signal_semaphore_submit_infos[signal_semaphore_count++];
+      signal_info.sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+      signal_info.semaphore   = surface.render_done[surface.frame_idx];
+      signal_info.deviceIndex = 0;
+      signal_info.value       = 1;
+      signal_info.stageMask   = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    }
 
     VkSubmitInfo2 submit_info            = {};
     submit_info.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
     submit_info.commandBufferInfoCount   = 1;
     submit_info.pCommandBufferInfos      = &command_buffer_submit_info;
-    submit_info.pWaitSemaphoreInfos      = &wait_semaphore_submit_info;
-    submit_info.waitSemaphoreInfoCount   = 1;
-    submit_info.pSignalSemaphoreInfos    = &signal_semaphore_submit_info;
-    submit_info.signalSemaphoreInfoCount = 1;
-    VK_CHECK(vkQueueSubmit2(device.queue, 1, &submit_info, current_frame.fence));
-
-    VkPresentInfoKHR present_info   = {};
-    present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.pImageIndices      = &surface.frame_idx;
-    present_info.pSwapchains        = &surface.swapchain;
-    present_info.swapchainCount     = 1;
-    present_info.waitSemaphoreCount = 1;
-    present_info.pWaitSemaphores    = &surface.render_done[sync_idx];
-    VK_CHECK(vkQueuePresentKHR(device.queue, &present_info));
-
-    // acquire after present
-    // there's a chance that this will have to wait somehow.
-    sync_idx = (sync_idx + 1) % surface.num_images;
-    acc++;
+    submit_info.pWaitSemaphoreInfos      = wait_semaphore_submit_infos;
+    submit_info.waitSemaphoreInfoCount   = wait_semaphore_count;
+    submit_info.pSignalSemaphoreInfos    = signal_semaphore_submit_infos;
+    submit_info.signalSemaphoreInfoCount = signal_semaphore_count;
+    {
+      PROFILE_SCOPE("submit");
+      VK_CHECK(vkQueueSubmit2(device.queue, 1, &submit_info, VK_NULL_HANDLE));
+    }
+    readback_submitted(readbacks, current_frame.timeline_value);
+
+    // headless frames are done once submitted, the pacer only tracks them on the timeline.
+    u64 present_id = 0;
+    if (!surface.headless) {
+      VkPresentInfoKHR present_info   = {};
+      present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+      present_info.pImageIndices      = &surface.frame_idx;
+      present_info.pSwapchains        = &surface.swapchain;
+      present_info.swapchainCount     = 1;
+      present_info.waitSemaphoreCount = 1;
+      present_info.pWaitSemaphores    = &surface.render_done[surface.frame_idx];
+
+      // lets the pacer wait for this frame to be on screen.
+      present_id                 = frame_pacer_next_present_id(frame_pacer);
+      VkPresentIdKHR present_ids = {};
+      if (present_id) {
+        present_ids.sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        present_ids.swapchainCount = 1;
+        present_ids.pPresentIds    = &present_id;
+        present_info.pNext         = &present_ids;
+      }
+      {
+        PROFILE_SCOPE("present");
+        result = vkQueuePresentKHR(device.queue, &present_info);
+      }
+      if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        swapchain_dirty = true;
+      } else {
+        VK_CHECK(result);
+      }
+    }
+    frame_pacer_presented(frame_pacer, present_id, current_frame.timeline_value);
+
+    {
+      u64 now = os_now_ticks();
+      if (last_present_ticks != 0)
+        frame_sample.ms[(u32)Frame_Stat::present_interval] = (f32)os_ticks_to_ms(now - last_present_ticks);
+      last_present_ticks                        = now;
+      frame_sample.ms[(u32)Frame_Stat::latency] = frame_pacer.latency_ms;
+      frame_stats_push(*frame_stats, frame_sample);
+    }
+
+    frame_number++;
   }
 
   vkDeviceWaitIdle(device.logical);
+
+  // the last frames' copies are done, they still have to be written.
+  timeline_wait(device, graphics_timeline, graphics_timeline.submitted);
+  readback_update(device, readbacks, graphics_timeline.completed);
+  readback_wait_idle(readbacks);
+  if (readback_last_frame && (readbacks.stats.completed == 0 || readbacks.stats.failed != 0)) return EXIT_FAILURE;
   return EXIT_SUCCESS;
 }
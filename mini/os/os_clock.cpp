@@ -0,0 +1,107 @@
+#include "os_common.hpp"
+#include <cassert>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+#define OS_CLOCK_HAS_TSC 1
+#else
+#define OS_CLOCK_HAS_TSC 0
+#endif
+
+// below this we stop trusting the os scheduler and spin.
+#if defined(_WIN32)
+static constexpr u64 OS_SPIN_THRESHOLD_NS = 1500000;
+#else
+static constexpr u64 OS_SPIN_THRESHOLD_NS = 200000;
+#endif
+
+static bool os_clock_tsc         = false;
+static f64 os_clock_ns_per_tick  = 1.0;
+static bool os_clock_initialized = false;
+
+static bool os_tsc_is_invariant() {
+#if OS_CLOCK_HAS_TSC
+  u32 regs[4] = {};
+#if defined(_MSC_VER)
+  __cpuid((int*)regs, 0x80000000);
+  if (regs[0] < 0x80000007) return false;
+  __cpuid((int*)regs, 0x80000007);
+#else
+  if (!__get_cpuid(0x80000000, &regs[0], &regs[1], &regs[2], &regs[3])) return false;
+  if (regs[0] < 0x80000007) return false;
+  __get_cpuid(0x80000007, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+  return (regs[3] & (1 << 8)) != 0; // edx bit 8: invariant tsc.
+#else
+  return false;
+#endif
+}
+
+static inline u64 os_read_tsc() {
+#if OS_CLOCK_HAS_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static inline void os_spin_pause() {
+#if OS_CLOCK_HAS_TSC
+  _mm_pause();
+#endif
+}
+
+void os_init_clock() {
+  if (os_clock_initialized) return;
+  os_clock_initialized = true;
+
+  if (!os_tsc_is_invariant()) {
+    // the tsc might change rate with power states, use the os clock directly.
+    os_clock_tsc         = false;
+    os_clock_ns_per_tick = 1.0;
+    return;
+  }
+
+  // calibrate against the raw monotonic clock, 10ms keeps the error well under 0.01%.
+  u64 ns_then    = os_monotonic_raw_ns();
+  u64 ticks_then = os_read_tsc();
+  u64 ns_now     = ns_then;
+  while (ns_now - ns_then < 10000000) ns_now = os_monotonic_raw_ns();
+  u64 ticks_now = os_read_tsc();
+
+  os_clock_tsc         = ticks_now > ticks_then;
+  os_clock_ns_per_tick = os_clock_tsc ? (f64)(ns_now - ns_then) / (f64)(ticks_now - ticks_then) : 1.0;
+}
+
+u64 os_now_ticks() {
+  assert(os_clock_initialized);
+  return os_clock_tsc ? os_read_tsc() : os_monotonic_raw_ns();
+}
+
+bool os_clock_uses_tsc() { return os_clock_tsc; }
+
+f64 os_ticks_to_ns(u64 ticks) { return (f64)ticks * os_clock_ns_per_tick; }
+f64 os_ticks_to_ms(u64 ticks) { return os_ticks_to_ns(ticks) / 1000000.0; }
+u64 os_ns_to_ticks(f64 ns) { return (u64)(ns / os_clock_ns_per_tick); }
+
+void os_sleep_precise(u64 ns) { os_wait_until(os_now_ticks() + os_ns_to_ticks((f64)ns)); }
+
+void os_wait_until(u64 deadline_ticks) {
+  for (;;) {
+    u64 now = os_now_ticks();
+    if (now >= deadline_ticks) return;
+
+    u64 remaining_ns = (u64)os_ticks_to_ns(deadline_ticks - now);
+    if (remaining_ns > OS_SPIN_THRESHOLD_NS) os_sleep_coarse(remaining_ns - OS_SPIN_THRESHOLD_NS);
+    else
+      os_spin_pause();
+  }
+}
+
+#undef OS_CLOCK_HAS_TSC
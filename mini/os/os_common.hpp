@@ -1,4 +1,42 @@
 #pragma once
 #include "core/common.hpp"
+#include <cstdio>
 
-Time os_get_current_local_time();
\ No newline at end of file
+Time os_get_current_local_time();
+
+// --- clock ---
+// `os_now_ticks` reads the tsc when it is invariant and falls back to the platform monotonic clock otherwise.
+// Ticks are only comparable to other ticks, use the conversions below for anything user facing.
+void os_init_clock();
+u64 os_now_ticks();
+bool os_clock_uses_tsc();
+
+f64 os_ticks_to_ns(u64 ticks);
+f64 os_ticks_to_ms(u64 ticks);
+u64 os_ns_to_ticks(f64 ns);
+
+/// Sleeps with the os for most of the time and spins for the rest, so wakeups land within a few microseconds.
+void os_sleep_precise(u64 ns);
+void os_wait_until(u64 deadline_ticks);
+
+// implemented per platform.
+u64 os_monotonic_raw_ns();
+/// A reading of the clock behind `os_monotonic_raw_ns` in its native unit (CLOCK_MONOTONIC_RAW ns, performance
+/// counter ticks), like the host time domains of VK_EXT_calibrated_timestamps report it.
+u64 os_monotonic_raw_to_ns(u64 value);
+void os_sleep_coarse(u64 ns);
+
+// --- files ---
+/// Atomically moves `from` over `to`, replacing it if it exists. Readers see either the old or the new file.
+bool os_replace_file(const char* from, const char* to);
+/// Returns true when the directory exists afterwards, parents have to exist already.
+bool os_create_directory(const char* path);
+
+#if !defined(_MSC_VER)
+#include <cerrno>
+// msvc only, kept so that callers look the same on every platform.
+inline int fopen_s(FILE** fp, const char* file_name, const char* mode) {
+  *fp = fopen(file_name, mode);
+  return *fp ? 0 : errno;
+}
+#endif
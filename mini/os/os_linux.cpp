@@ -0,0 +1,45 @@
+#if defined(__linux__)
+#include "os_common.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <sys/stat.h>
+
+// --- os_common ---
+Time os_get_current_local_time() {
+  timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  tm local;
+  localtime_r(&ts.tv_sec, &local);
+
+  Time time;
+  time.year         = local.tm_year + 1900;
+  time.month        = local.tm_mon + 1;
+  time.day          = local.tm_mday;
+  time.hour         = local.tm_hour;
+  time.minute       = local.tm_min;
+  time.second       = local.tm_sec;
+  time.milli_second = (u32)(ts.tv_nsec / 1000000);
+  return time;
+}
+
+u64 os_monotonic_raw_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+u64 os_monotonic_raw_to_ns(u64 ns) { return ns; }
+
+void os_sleep_coarse(u64 ns) {
+  timespec request;
+  request.tv_sec  = (time_t)(ns / 1000000000ull);
+  request.tv_nsec = (long)(ns % 1000000000ull);
+  while (clock_nanosleep(CLOCK_MONOTONIC, 0, &request, &request) == EINTR) {}
+}
+
+bool os_replace_file(const char* from, const char* to) { return rename(from, to) == 0; }
+
+bool os_create_directory(const char* path) { return mkdir(path, 0755) == 0 || errno == EEXIST; }
+
+#endif
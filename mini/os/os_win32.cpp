@@ -415,6 +415,55 @@ Time os_get_current_local_time() {
   return time;
 }
 
+u64 os_monotonic_raw_ns() {
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return os_monotonic_raw_to_ns((u64)counter.QuadPart);
+}
+
+u64 os_monotonic_raw_to_ns(u64 counter) {
+  static LARGE_INTEGER frequency = {};
+  if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+  // split to avoid overflowing for counters that run for a long time.
+  u64 seconds   = counter / (u64)frequency.QuadPart;
+  u64 remainder = counter % (u64)frequency.QuadPart;
+  return seconds * 1000000000ull + remainder * 1000000000ull / (u64)frequency.QuadPart;
+}
+
+#if !defined(CREATE_WAITABLE_TIMER_HIGH_RESOLUTION)
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// one per thread, sleeping threads sharing a timer would re-arm it under each other. closed as the thread exits.
+struct Win32_Sleep_Timer {
+  // high resolution timers are available from windows 10 1803, fall back to Sleep when they are not.
+  HANDLE handle = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  ~Win32_Sleep_Timer() {
+    if (handle) CloseHandle(handle);
+  }
+};
+
+void os_sleep_coarse(u64 ns) {
+  static thread_local Win32_Sleep_Timer timer;
+  if (!timer.handle) {
+    Sleep((DWORD)(ns / 1000000));
+    return;
+  }
+
+  LARGE_INTEGER due_time;
+  due_time.QuadPart = -(LONGLONG)(ns / 100); // relative, in 100ns units.
+  SetWaitableTimer(timer.handle, &due_time, 0, nullptr, nullptr, FALSE);
+  WaitForSingleObject(timer.handle, INFINITE);
+}
+
+bool os_replace_file(const char* from, const char* to) {
+  return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+bool os_create_directory(const char* path) {
+  return CreateDirectoryA(path, nullptr) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
 // --- win32 ---
 void win32_convert_time_to_system_time(const Time* time, SYSTEMTIME* system_time) {
   system_time->wYear         = time->year;
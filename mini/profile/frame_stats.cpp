@@ -0,0 +1,219 @@
+#include "frame_stats.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static const f32 frame_stats_quantiles[Frame_Stats_Series::num_quantiles] = { 0.50f, 0.95f, 0.99f, 1.0f };
+
+static u32 frame_stats_bucket(f32 ms) {
+  if (ms <= 0.0f) return 0;
+  u32 bucket = (u32)(ms / Frame_Stats_Series::BUCKET_WIDTH_MS);
+  return bucket < Frame_Stats_Series::NUM_BUCKETS ? bucket : Frame_Stats_Series::NUM_BUCKETS - 1;
+}
+
+// moves the cursor until it sits on the bucket containing `rank` (1 based).
+static void frame_stats_seek(Frame_Stats_Series& series, Frame_Stats_Cursor& cursor, u32 rank) {
+  while (cursor.below + series.histogram[cursor.bucket] < rank &&
+         cursor.bucket + 1 < Frame_Stats_Series::NUM_BUCKETS) {
+    cursor.below += series.histogram[cursor.bucket];
+    cursor.bucket++;
+  }
+  while (cursor.below >= rank && cursor.bucket > 0) {
+    cursor.bucket--;
+    cursor.below -= series.histogram[cursor.bucket];
+  }
+}
+
+static void frame_stats_series_update(Frame_Stats_Series& series, u32 bucket, s32 delta) {
+  series.histogram[bucket] = (u16)(series.histogram[bucket] + delta);
+  for (u32 i = 0; i < Frame_Stats_Series::num_quantiles; ++i) {
+    if (bucket < series.cursors[i].bucket) series.cursors[i].below += delta;
+  }
+}
+
+void frame_stats_init(Frame_Stats& stats) {
+  memset(&stats, 0, sizeof(stats));
+  stats.hitch_factor = 2.0f;
+}
+
+void frame_stats_push(Frame_Stats& stats, const Frame_Sample& sample) {
+  const u32 slot  = (u32)(stats.frame_count % Frame_Stats::MAX_FRAMES);
+  const bool full = stats.frame_count >= Frame_Stats::MAX_FRAMES;
+
+  for (u32 i = 0; i < (u32)Frame_Stat::count; ++i) {
+    Frame_Stats_Series& series = stats.series[i];
+
+    // evict the sample that falls out of the window.
+    if (full) {
+      frame_stats_series_update(series, frame_stats_bucket(stats.samples[slot].ms[i]), -1);
+      if (stats.hitches[slot][i]) series.hitch_count--;
+    }
+
+    const f32 median       = series.quantiles[Frame_Stats_Series::p50];
+    const bool hitch       = median > 0.0f && sample.ms[i] > median * stats.hitch_factor;
+    stats.hitches[slot][i] = hitch;
+    if (hitch) series.hitch_count++;
+
+    frame_stats_series_update(series, frame_stats_bucket(sample.ms[i]), +1);
+  }
+
+  stats.samples[slot] = sample;
+  stats.frame_count++;
+
+  const u32 count = full ? Frame_Stats::MAX_FRAMES : (u32)stats.frame_count;
+  for (u32 i = 0; i < (u32)Frame_Stat::count; ++i) {
+    Frame_Stats_Series& series = stats.series[i];
+    for (u32 q = 0; q < Frame_Stats_Series::num_quantiles; ++q) {
+      u32 rank = (u32)ceilf(frame_stats_quantiles[q] * count);
+      if (rank == 0) rank = 1;
+      frame_stats_seek(series, series.cursors[q], rank);
+      series.quantiles[q] = (series.cursors[q].bucket + 0.5f) * Frame_Stats_Series::BUCKET_WIDTH_MS;
+    }
+  }
+}
+
+const char* frame_stat_name(Frame_Stat stat) {
+  switch (stat) {
+    case Frame_Stat::cpu_frame: return "cpu frame";
+    case Frame_Stat::frame_wait: return "frame wait";
+    case Frame_Stat::acquire: return "acquire";
+    case Frame_Stat::present_interval: return "present interval";
+    case Frame_Stat::pacing: return "pacing";
+    case Frame_Stat::latency: return "latency";
+    case Frame_Stat::count: break;
+  }
+  return "UNKNOWN_STAT";
+}
+
+const Frame_Stats_Series& frame_stats_series(const Frame_Stats& stats, Frame_Stat stat) {
+  assert(stat != Frame_Stat::count);
+  return stats.series[(u32)stat];
+}
+
+bool frame_stats_write_csv(const Frame_Stats& stats, const char* file_path) {
+  FILE* fp = nullptr;
+  fopen_s(&fp, file_path, "wb");
+  if (!fp) {
+    log_error("[frame stats] unable to open %s for writing", file_path);
+    return false;
+  }
+  defer { fclose(fp); };
+
+  fprintf(fp, "frame");
+  for (u32 i = 0; i < (u32)Frame_Stat::count; ++i) fprintf(fp, ",%s ms", frame_stat_name((Frame_Stat)i));
+  fprintf(fp, "\n");
+
+  // oldest to newest.
+  const u64 count = stats.frame_count < Frame_Stats::MAX_FRAMES ? stats.frame_count : Frame_Stats::MAX_FRAMES;
+  for (u64 frame = stats.frame_count - count; frame < stats.frame_count; ++frame) {
+    const Frame_Sample& sample = stats.samples[frame % Frame_Stats::MAX_FRAMES];
+    fprintf(fp, "%llu", (unsigned long long)frame);
+    for (u32 i = 0; i < (u32)Frame_Stat::count; ++i) fprintf(fp, ",%.4f", sample.ms[i]);
+    fprintf(fp, "\n");
+  }
+
+  for (u32 i = 0; i < (u32)Frame_Stat::count; ++i) {
+    const Frame_Stats_Series& series = stats.series[i];
+    log_info(
+        "[frame stats] %-16s p50 %.3fms p95 %.3fms p99 %.3fms max %.3fms hitches %u",
+        frame_stat_name((Frame_Stat)i),
+        series.quantiles[Frame_Stats_Series::p50],
+        series.quantiles[Frame_Stats_Series::p95],
+        series.quantiles[Frame_Stats_Series::p99],
+        series.quantiles[Frame_Stats_Series::max],
+        series.hitch_count);
+  }
+  return true;
+}
+
+struct Frame_Stats_Plot {
+  const Frame_Stats* stats;
+  u32 stat;
+  u32 count;
+};
+
+static float frame_stats_plot_getter(void* data, int idx) {
+  auto plot = (Frame_Stats_Plot*)data;
+  u64 frame = plot->stats->frame_count - plot->count + idx;
+  return plot->stats->samples[frame % Frame_Stats::MAX_FRAMES].ms[plot->stat];
+}
+
+void frame_stats_draw_imgui(Frame_Stats& stats, bool* open) {
+  if (!ImGui::Begin("frame stats", open)) {
+    ImGui::End();
+    return;
+  }
+
+  static s32 selected     = 0;
+  static s32 graph_frames = 300;
+  static f32 graph_max_ms = 33.3f;
+
+  const u32 window = stats.frame_count < Frame_Stats::MAX_FRAMES ? (u32)stats.frame_count : Frame_Stats::MAX_FRAMES;
+  ImGui::Text("%u frames in window, %llu total", window, (unsigned long long)stats.frame_count);
+  ImGui::SliderFloat("hitch factor", &stats.hitch_factor, 1.1f, 5.0f);
+
+  if (ImGui::BeginTable("stats", 6, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("ms");
+    ImGui::TableSetupColumn("p50");
+    ImGui::TableSetupColumn("p95");
+    ImGui::TableSetupColumn("p99");
+    ImGui::TableSetupColumn("max");
+    ImGui::TableSetupColumn("hitches");
+    ImGui::TableHeadersRow();
+    for (u32 i = 0; i < (u32)Frame_Stat::count; ++i) {
+      const Frame_Stats_Series& series = stats.series[i];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      if (ImGui::Selectable(frame_stat_name((Frame_Stat)i), selected == (s32)i)) selected = (s32)i;
+      for (u32 q = 0; q < Frame_Stats_Series::num_quantiles; ++q) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", series.quantiles[q]);
+      }
+      ImGui::TableNextColumn();
+      ImGui::Text("%u", series.hitch_count);
+    }
+    ImGui::EndTable();
+  }
+
+  if (window == 0) {
+    ImGui::End();
+    return;
+  }
+
+  ImGui::SliderInt("graph frames", &graph_frames, 16, 2000);
+  ImGui::SliderFloat("graph max ms", &graph_max_ms, 1.0f, 100.0f);
+
+  Frame_Stats_Plot plot = {};
+  plot.stats            = &stats;
+  plot.stat             = (u32)selected;
+  plot.count            = (u32)graph_frames < window ? (u32)graph_frames : window;
+  ImGui::PlotLines(
+      "##graph",
+      frame_stats_plot_getter,
+      &plot,
+      (int)plot.count,
+      0,
+      frame_stat_name((Frame_Stat)selected),
+      0.0f,
+      graph_max_ms,
+      ImVec2(0, 80));
+
+  // collapse the fine histogram into a few wide bars, only up to the current max.
+  constexpr u32 num_bars           = 64;
+  f32 bars[num_bars]               = {};
+  const Frame_Stats_Series& series = stats.series[selected];
+  const u32 last_bucket            = series.cursors[Frame_Stats_Series::max].bucket + 1;
+  const u32 buckets_per_bar        = (last_bucket + num_bars - 1) / num_bars;
+  for (u32 b = 0; b < last_bucket; ++b) bars[b / buckets_per_bar] += series.histogram[b];
+
+  char overlay[64];
+  snprintf(overlay, sizeof(overlay), "0 - %.2f ms", last_bucket * Frame_Stats_Series::BUCKET_WIDTH_MS);
+  ImGui::PlotHistogram("##histogram", bars, num_bars, 0, overlay, 0.0f, FLT_MAX, ImVec2(0, 80));
+
+  ImGui::End();
+}
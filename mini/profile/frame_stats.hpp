@@ -0,0 +1,58 @@
+#pragma once
+#include "defs.hpp"
+
+enum struct Frame_Stat {
+  cpu_frame,        // mark to mark time on the main thread.
+  frame_wait,       // time blocked until the gpu is done with the frame slot about to be reused.
+  acquire,          // time blocked in vkAcquireNextImageKHR.
+  present_interval, // time between two vkQueuePresentKHR calls.
+  pacing,           // time the frame pacer held the frame back before it sampled input.
+  latency,          // input to on screen of the newest frame that got there, to gpu done without present wait.
+  count
+};
+
+struct Frame_Sample {
+  f32 ms[(u32)Frame_Stat::count];
+};
+
+/// Tracks the bucket holding a given rank, nudged by a few buckets whenever a sample enters or leaves.
+struct Frame_Stats_Cursor {
+  u32 bucket;
+  u32 below; // number of samples in buckets before `bucket`.
+};
+
+/// Rolling window of the last MAX_FRAMES frames. Percentiles come from a fixed bucket histogram that is kept up to
+/// date as samples enter and leave the window, so querying them never sorts anything.
+struct Frame_Stats_Series {
+  static constexpr u32 NUM_BUCKETS     = 8000;
+  static constexpr f32 BUCKET_WIDTH_MS = 0.025f; // anything past 200ms lands in the last bucket.
+
+  enum { p50, p95, p99, max, num_quantiles };
+
+  u16 histogram[NUM_BUCKETS];
+  Frame_Stats_Cursor cursors[num_quantiles];
+  f32 quantiles[num_quantiles];
+  u32 hitch_count;
+};
+
+struct Frame_Stats {
+  static constexpr u32 MAX_FRAMES = 10000;
+
+  Frame_Sample samples[MAX_FRAMES];
+  bool hitches[MAX_FRAMES][(u32)Frame_Stat::count];
+  Frame_Stats_Series series[(u32)Frame_Stat::count];
+
+  u64 frame_count;
+
+  // a sample is a hitch when it is this many times slower than the current median.
+  f32 hitch_factor;
+};
+
+void frame_stats_init(Frame_Stats& stats);
+void frame_stats_push(Frame_Stats& stats, const Frame_Sample& sample);
+
+const char* frame_stat_name(Frame_Stat stat);
+const Frame_Stats_Series& frame_stats_series(const Frame_Stats& stats, Frame_Stat stat);
+
+bool frame_stats_write_csv(const Frame_Stats& stats, const char* file_path);
+void frame_stats_draw_imgui(Frame_Stats& stats, bool* open);
@@ -0,0 +1,357 @@
+#include "gpu_profiler.hpp"
+#include "gpu/common.hpp"
+#include "gpu/device.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include <cassert>
+
+static constexpr u32 GPU_PROFILER_INVALID_SCOPE = (u32)-1;
+
+// the host domain `os_monotonic_raw_ns` reads.
+#if defined(_WIN32)
+static constexpr VkTimeDomainEXT GPU_PROFILER_HOST_DOMAIN = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+static constexpr VkTimeDomainEXT GPU_PROFILER_HOST_DOMAIN = VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_EXT;
+#endif
+
+// a calibration this much worse than the one in use is noise from a preempted call, the old one stays. drivers may
+// report no deviation at all, anything within the floor is as good as profiling needs.
+static constexpr u64 GPU_PROFILER_DEVIATION_SLACK    = 2;
+static constexpr u64 GPU_PROFILER_DEVIATION_FLOOR_NS = 1000;
+
+// both domains are sampled by the driver in one call, `max_deviation` bounds how far apart the two readings are.
+// only replaces a calibration when the new one deviates at most `slack` times as much.
+static bool gpu_profiler_calibrate_with_extension(Device& device, GPU_Profiler& profiler, u64 slack) {
+  VkCalibratedTimestampInfoEXT infos[2] = {};
+  infos[0].sType                        = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[0].timeDomain                   = VK_TIME_DOMAIN_DEVICE_EXT;
+  infos[1].sType                        = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[1].timeDomain                   = GPU_PROFILER_HOST_DOMAIN;
+
+  u64 timestamps[2] = {};
+  u64 max_deviation = 0;
+  VkResult result   = profiler.get_calibrated_timestamps(device.logical, 2, infos, timestamps, &max_deviation);
+  if (result != VK_SUCCESS) return false;
+  u64 accepted = profiler.calibration_deviation * slack;
+  if (accepted < GPU_PROFILER_DEVIATION_FLOOR_NS) accepted = GPU_PROFILER_DEVIATION_FLOOR_NS;
+  if (profiler.calibration_cpu && max_deviation > accepted) return false;
+
+  // the host reading is in the raw monotonic clock, our ticks may be the tsc. both cpu clocks are read back to back,
+  // that gap is far below what the driver call takes.
+  const u64 now_ticks = os_now_ticks();
+  const u64 now_ns    = os_monotonic_raw_ns();
+  const u64 host_ns   = os_monotonic_raw_to_ns(timestamps[1]);
+
+  profiler.calibration_gpu       = timestamps[0] & profiler.valid_mask;
+  profiler.calibration_cpu       = now_ticks - os_ns_to_ticks((f64)(now_ns - host_ns));
+  profiler.calibration_deviation = max_deviation;
+  return true;
+}
+
+static bool gpu_profiler_supports_calibration(Device& device) {
+  if (!device.calibrated_timestamps) return false;
+  auto get_time_domains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT)vkGetInstanceProcAddr(
+      device.instance,
+      "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+  if (!get_time_domains) return false;
+
+  VkTimeDomainEXT domains[8];
+  u32 domain_count = ARRAY_SIZE(domains);
+  if (get_time_domains(device.physical, &domain_count, domains) < 0) return false;
+
+  bool has_device = false;
+  bool has_host   = false;
+  for (u32 i = 0; i < domain_count; ++i) {
+    has_device |= domains[i] == VK_TIME_DOMAIN_DEVICE_EXT;
+    has_host |= domains[i] == GPU_PROFILER_HOST_DOMAIN;
+  }
+  return has_device && has_host;
+}
+
+// without VK_EXT_calibrated_timestamps we write a single timestamp and wait for it, only done once at startup.
+static void gpu_profiler_calibrate_with_submit(Device& device, GPU_Profiler& profiler) {
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex        = profiler.queue_family;
+
+  VkCommandPool command_pool = VK_NULL_HANDLE;
+  VK_CHECK(vkCreateCommandPool(device.logical, &pool_info, device.allocator_callbacks, &command_pool));
+  defer { vkDestroyCommandPool(device.logical, command_pool, device.allocator_callbacks); };
+
+  VkCommandBufferAllocateInfo allocate_info = {};
+  allocate_info.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.commandPool                 = command_pool;
+  allocate_info.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandBufferCount          = 1;
+
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  VK_CHECK(vkAllocateCommandBuffers(device.logical, &allocate_info, &command_buffer));
+
+  VkQueryPool query_pool = profiler.frames[0].query_pool;
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  VK_CHECK(vkBeginCommandBuffer(command_buffer, &begin_info));
+  vkCmdResetQueryPool(command_buffer, query_pool, 0, 1);
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, query_pool, 0);
+  VK_CHECK(vkEndCommandBuffer(command_buffer));
+
+  VkCommandBufferSubmitInfo command_buffer_info = {};
+  command_buffer_info.sType                     = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+  command_buffer_info.commandBuffer             = command_buffer;
+
+  VkSubmitInfo2 submit_info          = {};
+  submit_info.sType                  = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+  submit_info.commandBufferInfoCount = 1;
+  submit_info.pCommandBufferInfos    = &command_buffer_info;
+
+  u64 cpu_before = os_now_ticks();
+  VK_CHECK(vkQueueSubmit2(profiler.queue, 1, &submit_info, VK_NULL_HANDLE));
+  VK_CHECK(vkQueueWaitIdle(profiler.queue));
+  u64 cpu_after = os_now_ticks();
+
+  u64 gpu_ticks = 0;
+  VK_CHECK(vkGetQueryPoolResults(
+      device.logical,
+      query_pool,
+      0,
+      1,
+      sizeof(gpu_ticks),
+      &gpu_ticks,
+      sizeof(gpu_ticks),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+  profiler.calibration_gpu       = gpu_ticks & profiler.valid_mask;
+  profiler.calibration_cpu       = cpu_before + (cpu_after - cpu_before) / 2;
+  profiler.calibration_deviation = (u64)(os_ticks_to_ns(cpu_after - cpu_before) / 2);
+}
+
+static u64 gpu_profiler_to_cpu_ticks(GPU_Profiler& profiler, u64 gpu_ticks) {
+  f64 delta_ns = ((f64)gpu_ticks - (f64)profiler.calibration_gpu) * profiler.ns_per_tick;
+  if (delta_ns < 0) return profiler.calibration_cpu - os_ns_to_ticks(-delta_ns);
+  return profiler.calibration_cpu + os_ns_to_ticks(delta_ns);
+}
+
+GPU_Profiler create_gpu_profiler(
+    Temp_Linear_Allocator arena,
+    Device& device,
+    u32 num_frames,
+    VkQueue queue,
+    u32 queue_family,
+    const char* name) {
+  assert(num_frames <= GPU_Profiler::MAX_FRAMES);
+  GPU_Profiler profiler = {};
+  profiler.num_frames   = num_frames;
+  profiler.name         = name;
+  profiler.queue        = queue;
+  profiler.queue_family = queue_family;
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device.physical, &properties);
+
+  u32 queue_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device.physical, &queue_count, nullptr);
+  auto queues = arena.push_array_no_init<VkQueueFamilyProperties>(queue_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(device.physical, &queue_count, queues);
+  const u32 valid_bits = queues[queue_family].timestampValidBits;
+  arena.clear();
+
+  if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f) {
+    log_warn("[gpu profiler] queue family %u does not support timestamps, %s profiling disabled", queue_family, name);
+    return profiler;
+  }
+
+  profiler.enabled     = true;
+  profiler.valid_mask  = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+  profiler.ns_per_tick = properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo query_pool_info = {};
+  query_pool_info.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_info.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+  query_pool_info.queryCount            = GPU_Profile_Frame::QUERY_COUNT;
+
+  for (u32 i = 0; i < num_frames; ++i) {
+    VK_CHECK(vkCreateQueryPool(
+        device.logical,
+        &query_pool_info,
+        device.allocator_callbacks,
+        &profiler.frames[i].query_pool));
+  }
+
+  if (gpu_profiler_supports_calibration(device)) {
+    profiler.get_calibrated_timestamps =
+        (PFN_vkGetCalibratedTimestampsEXT)vkGetDeviceProcAddr(device.logical, "vkGetCalibratedTimestampsEXT");
+  }
+
+  // the first call sets the deviation later ones are held to, keep the tightest of a few.
+  bool calibrated = false;
+  for (u32 i = 0; profiler.get_calibrated_timestamps && i < 4; ++i)
+    calibrated |= gpu_profiler_calibrate_with_extension(device, profiler, 1);
+  if (!calibrated) {
+    profiler.get_calibrated_timestamps = nullptr;
+    gpu_profiler_calibrate_with_submit(device, profiler);
+  }
+
+  profiler.track = profiler_create_track(name);
+  log_info(
+      "[gpu profiler] %s: %.3f ns per tick, %u valid bits, %s calibration (%llu ns deviation)",
+      name,
+      profiler.ns_per_tick,
+      valid_bits,
+      profiler.get_calibrated_timestamps ? "calibrated timestamps" : "one shot",
+      (unsigned long long)profiler.calibration_deviation);
+  return profiler;
+}
+
+void destroy_gpu_profiler(Device& device, GPU_Profiler& profiler) {
+  for (u32 i = 0; i < profiler.num_frames; ++i) {
+    if (profiler.frames[i].query_pool == VK_NULL_HANDLE) continue;
+    vkDestroyQueryPool(device.logical, profiler.frames[i].query_pool, device.allocator_callbacks);
+  }
+  profiler = {};
+}
+
+static void gpu_profiler_read_back(Device& device, GPU_Profiler& profiler, GPU_Profile_Frame& frame) {
+  if (!frame.span_ended && frame.scope_count == 0) return;
+
+  if (profiler.get_calibrated_timestamps)
+    gpu_profiler_calibrate_with_extension(device, profiler, GPU_PROFILER_DEVIATION_SLACK);
+
+  if (frame.span_ended) {
+    u64 span[2];
+    VkResult result = vkGetQueryPoolResults(
+        device.logical,
+        frame.query_pool,
+        GPU_Profile_Frame::SPAN_QUERY,
+        2,
+        sizeof(span),
+        span,
+        sizeof(u64),
+        VK_QUERY_RESULT_64_BIT);
+    if (result == VK_NOT_READY) return;
+    VK_CHECK(result);
+
+    u64 begin = span[0] & profiler.valid_mask;
+    u64 end   = span[1] & profiler.valid_mask;
+    if (end < begin) end = begin;
+    profiler.last_begin_ticks = gpu_profiler_to_cpu_ticks(profiler, begin);
+    profiler.last_end_ticks   = gpu_profiler_to_cpu_ticks(profiler, end);
+  }
+  if (frame.scope_count == 0) return;
+
+  u64 timestamps[GPU_Profile_Frame::MAX_SCOPES * 2];
+  VkResult result = vkGetQueryPoolResults(
+      device.logical,
+      frame.query_pool,
+      0,
+      frame.scope_count * 2,
+      sizeof(timestamps),
+      timestamps,
+      sizeof(u64),
+      VK_QUERY_RESULT_64_BIT);
+  // the frame was waited on so this should never happen, but we would rather drop a frame than wait.
+  if (result == VK_NOT_READY) return;
+  VK_CHECK(result);
+
+  // keep the averages when the set of scopes did not change between frames.
+  const bool same_scopes = profiler.result_count == frame.scope_count;
+  profiler.result_count  = frame.scope_count;
+
+  for (u32 i = 0; i < frame.scope_count; ++i) {
+    u64 begin = timestamps[i * 2] & profiler.valid_mask;
+    u64 end   = timestamps[i * 2 + 1] & profiler.valid_mask;
+    if (end < begin) end = begin; // wrapped around, rare enough to drop.
+
+    GPU_Profile_Result& r = profiler.results[i];
+    f64 ms                = (f64)(end - begin) * profiler.ns_per_tick / 1000000.0;
+    r.avg_ms              = same_scopes && r.name == frame.names[i] ? r.avg_ms * 0.95 + ms * 0.05 : ms;
+    r.ms                  = ms;
+    r.name                = frame.names[i];
+    r.depth               = frame.depth[i];
+
+    const u64 begin_ticks = gpu_profiler_to_cpu_ticks(profiler, begin);
+    const u64 end_ticks   = gpu_profiler_to_cpu_ticks(profiler, end);
+    profiler_push_event(profiler.track, frame.names[i], begin_ticks, end_ticks, frame.depth[i]);
+  }
+}
+
+void gpu_profiler_begin_frame(Device& device, GPU_Profiler& profiler, u32 frame_idx, VkCommandBuffer command_buffer) {
+  if (!profiler.enabled) return;
+  assert(frame_idx < profiler.num_frames);
+
+  profiler.current         = frame_idx;
+  GPU_Profile_Frame& frame = profiler.frames[frame_idx];
+  profiler.last_begin_ticks = 0;
+  profiler.last_end_ticks   = 0;
+  if (frame.pending) gpu_profiler_read_back(device, profiler, frame);
+
+  frame.scope_count = 0;
+  frame.open_depth  = 0;
+  frame.pending     = true;
+  frame.span_ended  = false;
+  vkCmdResetQueryPool(command_buffer, frame.query_pool, 0, GPU_Profile_Frame::QUERY_COUNT);
+  const u32 span = GPU_Profile_Frame::SPAN_QUERY;
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, span);
+}
+
+void gpu_profiler_end_frame(GPU_Profiler& profiler, VkCommandBuffer command_buffer) {
+  if (!profiler.enabled) return;
+  GPU_Profile_Frame& frame = profiler.frames[profiler.current];
+  frame.span_ended         = true;
+  const u32 span           = GPU_Profile_Frame::SPAN_QUERY;
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, span + 1);
+}
+
+u32 gpu_profiler_begin_scope(GPU_Profiler& profiler, VkCommandBuffer command_buffer, const char* name) {
+  if (!profiler.enabled) return GPU_PROFILER_INVALID_SCOPE;
+  GPU_Profile_Frame& frame = profiler.frames[profiler.current];
+  if (frame.scope_count >= GPU_Profile_Frame::MAX_SCOPES) return GPU_PROFILER_INVALID_SCOPE;
+
+  u32 scope          = frame.scope_count++;
+  frame.names[scope] = name;
+  frame.depth[scope] = frame.open_depth++;
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, scope * 2);
+  return scope;
+}
+
+void gpu_profiler_end_scope(GPU_Profiler& profiler, VkCommandBuffer command_buffer, u32 scope) {
+  if (scope == GPU_PROFILER_INVALID_SCOPE) return;
+  GPU_Profile_Frame& frame = profiler.frames[profiler.current];
+  frame.open_depth--;
+  vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.query_pool, scope * 2 + 1);
+}
+
+void gpu_profiler_draw_imgui(GPU_Profiler& profiler, bool* open) {
+  if (!ImGui::Begin(profiler.name, open)) {
+    ImGui::End();
+    return;
+  }
+
+  if (!profiler.enabled) {
+    ImGui::Text("timestamps are not supported on this queue.");
+    ImGui::End();
+    return;
+  }
+
+  if (ImGui::BeginTable("passes", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+    ImGui::TableSetupColumn("pass");
+    ImGui::TableSetupColumn("ms");
+    ImGui::TableSetupColumn("avg ms");
+    ImGui::TableHeadersRow();
+    for (u32 i = 0; i < profiler.result_count; ++i) {
+      const GPU_Profile_Result& r = profiler.results[i];
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%*s%s", (int)r.depth * 2, "", r.name);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", r.ms);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.3f", r.avg_ms);
+    }
+    ImGui::EndTable();
+  }
+
+  ImGui::End();
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "core/memory.hpp"
+#include "defs.hpp"
+#include "profiler.hpp"
+#include <vulkan/vulkan.h>
+
+struct Device;
+
+struct GPU_Profile_Frame {
+  static constexpr u32 MAX_SCOPES  = 64;
+  static constexpr u32 SPAN_QUERY  = MAX_SCOPES * 2; // begin and end of the whole frame, written even without scopes.
+  static constexpr u32 QUERY_COUNT = SPAN_QUERY + 2;
+
+  VkQueryPool query_pool = VK_NULL_HANDLE;
+
+  // timestamp 2 * i is the beginning of scope i, 2 * i + 1 is its end.
+  const char* names[MAX_SCOPES];
+  u32 depth[MAX_SCOPES];
+  u32 scope_count = 0;
+  u32 open_depth  = 0;
+  bool pending    = false; // written this frame and not read back yet.
+  bool span_ended = false; // `gpu_profiler_end_frame` was called, the frame's span can be read back.
+};
+
+struct GPU_Profile_Result {
+  const char* name;
+  u32 depth;
+  f64 ms;
+  f64 avg_ms;
+};
+
+struct GPU_Profiler {
+  static constexpr u32 MAX_FRAMES = 4;
+
+  // one profiler per queue, its timestamps have to be written by command buffers submitted there.
+  const char* name = "gpu";
+  VkQueue queue    = VK_NULL_HANDLE;
+  u32 queue_family = (u32)-1;
+
+  GPU_Profile_Frame frames[MAX_FRAMES];
+  u32 num_frames  = 0;
+  u32 current     = 0;
+  bool enabled    = false; // the queue might not support timestamps at all.
+  u64 valid_mask  = 0;
+  f64 ns_per_tick = 1.0; // gpu ticks, from timestampPeriod.
+
+  // maps gpu ticks onto the cpu profiler clock.
+  u64 calibration_gpu       = 0;
+  u64 calibration_cpu       = 0;
+  u64 calibration_deviation = 0; // ns, as reported by the driver. the bracketing wait for one shot calibrations.
+  PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps = nullptr;
+
+  GPU_Profile_Result results[GPU_Profile_Frame::MAX_SCOPES];
+  u32 result_count = 0;
+
+  // begin and end of the frame read back last, in cpu profiler ticks so queues compare. 0 without one. these don't
+  // depend on MINI_PROFILE, dynamic resolution and the async compute comparison run on them in release builds.
+  u64 last_begin_ticks = 0;
+  u64 last_end_ticks   = 0;
+
+  Profile_Thread* track = nullptr;
+};
+
+/// `name` titles the window and the profiler track.
+GPU_Profiler create_gpu_profiler(
+    Temp_Linear_Allocator arena,
+    Device& device,
+    u32 num_frames,
+    VkQueue queue,
+    u32 queue_family,
+    const char* name);
+void destroy_gpu_profiler(Device& device, GPU_Profiler& profiler);
+
+/// Call once the gpu is done with the last frame recorded in `frame_idx` and before anything else is recorded into
+/// `command_buffer`.
+/// Reads back the timings recorded the last time this frame slot was used so it never waits on the gpu.
+void gpu_profiler_begin_frame(Device& device, GPU_Profiler& profiler, u32 frame_idx, VkCommandBuffer command_buffer);
+/// Closes the frame's span, call after the last command of the frame was recorded into `command_buffer`.
+void gpu_profiler_end_frame(GPU_Profiler& profiler, VkCommandBuffer command_buffer);
+
+u32 gpu_profiler_begin_scope(GPU_Profiler& profiler, VkCommandBuffer command_buffer, const char* name);
+void gpu_profiler_end_scope(GPU_Profiler& profiler, VkCommandBuffer command_buffer, u32 scope);
+
+void gpu_profiler_draw_imgui(GPU_Profiler& profiler, bool* open);
+
+struct GPU_Profile_Scope {
+  GPU_Profile_Scope(GPU_Profiler& _profiler, VkCommandBuffer _command_buffer, const char* name) :
+      profiler(_profiler), command_buffer(_command_buffer) {
+    scope = gpu_profiler_begin_scope(profiler, command_buffer, name);
+  }
+  ~GPU_Profile_Scope() { gpu_profiler_end_scope(profiler, command_buffer, scope); }
+
+  GPU_Profile_Scope(const GPU_Profile_Scope&)            = delete;
+  GPU_Profile_Scope& operator=(const GPU_Profile_Scope&) = delete;
+
+private:
+  GPU_Profiler& profiler;
+  VkCommandBuffer command_buffer;
+  u32 scope;
+};
+
+#if MINI_PROFILE
+#define GPU_PROFILE_SCOPE(profiler, command_buffer, name)                                                              \
+  ::GPU_Profile_Scope ANONYMOUS_VARIABLE(GPU_PROFILE_SCOPE_)(profiler, command_buffer, name)
+#else
+#define GPU_PROFILE_SCOPE(profiler, command_buffer, name)
+#endif
@@ -0,0 +1,243 @@
+#include "profiler.hpp"
+#include "core/common.hpp"
+#include "core/memory.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+static constexpr u32 PROFILER_MAX_FRAMES      = 256; // power of two.
+static constexpr s32 PROFILER_MAX_VIEW_FRAMES = 32;
+
+// keep away from the slots the writer might be overwriting while we read.
+static constexpr u64 PROFILER_READ_MARGIN = 1024;
+
+static std::atomic<Profile_Thread*> profiler_threads = { nullptr };
+static std::atomic<u32> profiler_next_thread_id      = { 0 };
+static thread_local Profile_Thread* profiler_thread  = nullptr;
+
+static u64 profiler_start_ticks = 0;
+
+static u64 profiler_frames[PROFILER_MAX_FRAMES];
+static u64 profiler_frame_count = 0;
+
+static Profile_Thread* profiler_allocate_thread(const char* name) {
+  Allocator allocator;
+  auto allocation = allocator.allocate(sizeof(Profile_Thread), alignof(Profile_Thread));
+  assert(allocation.info == Allocation_Err::none);
+
+  auto thread       = (Profile_Thread*)allocation.memory;
+  thread->thread_id = profiler_next_thread_id.fetch_add(1, std::memory_order_relaxed);
+  thread->write_idx.store(0, std::memory_order_relaxed);
+  snprintf(thread->name, sizeof(thread->name), "%s", name);
+
+  // lock free push to the front of the list, readers only ever walk forward.
+  auto head = profiler_threads.load(std::memory_order_relaxed);
+  do {
+    thread->next = head;
+  } while (!profiler_threads.compare_exchange_weak(head, thread, std::memory_order_release, std::memory_order_relaxed));
+
+  return thread;
+}
+
+void profiler_init() {
+  profiler_start_ticks = os_now_ticks();
+  profiler_set_thread_name("main");
+}
+
+void profiler_shutdown() {
+  Allocator allocator;
+  auto thread = profiler_threads.exchange(nullptr);
+  while (thread) {
+    auto next = thread->next;
+    allocator.free(thread);
+    thread = next;
+  }
+  profiler_thread = nullptr;
+}
+
+Profile_Thread* profiler_get_thread() {
+  if (!profiler_thread) {
+    char name[32];
+    snprintf(name, sizeof(name), "thread %u", profiler_next_thread_id.load(std::memory_order_relaxed));
+    profiler_thread = profiler_allocate_thread(name);
+  }
+  return profiler_thread;
+}
+
+void profiler_set_thread_name(const char* name) {
+  auto thread = profiler_get_thread();
+  snprintf(thread->name, sizeof(thread->name), "%s", name);
+}
+
+Profile_Thread* profiler_create_track(const char* name) { return profiler_allocate_thread(name); }
+
+void profiler_frame_mark() { profiler_frames[profiler_frame_count++ & (PROFILER_MAX_FRAMES - 1)] = os_now_ticks(); }
+
+// returns the [first, last) range of events that are safe to read.
+static void profiler_readable_range(Profile_Thread* thread, u64* first, u64* last) {
+  *last  = thread->write_idx.load(std::memory_order_acquire);
+  *first = 0;
+  if (*last + PROFILER_READ_MARGIN > Profile_Thread::MAX_EVENTS)
+    *first = *last + PROFILER_READ_MARGIN - Profile_Thread::MAX_EVENTS;
+}
+
+static void profiler_write_json_string(FILE* fp, const char* str) {
+  fputc('"', fp);
+  for (; *str; ++str) {
+    if (*str == '"' || *str == '\\') fputc('\\', fp);
+    fputc(*str, fp);
+  }
+  fputc('"', fp);
+}
+
+bool profiler_export_chrome_trace(const char* file_path) {
+  FILE* fp = nullptr;
+  fopen_s(&fp, file_path, "wb");
+  if (!fp) {
+    log_error("[profiler] unable to open %s for writing", file_path);
+    return false;
+  }
+  defer { fclose(fp); };
+
+  fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first_event = true;
+  u64 num_events   = 0;
+
+  for (auto thread = profiler_threads.load(std::memory_order_acquire); thread; thread = thread->next) {
+    fprintf(
+        fp,
+        "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":",
+        first_event ? "" : ",\n",
+        thread->thread_id);
+    profiler_write_json_string(fp, thread->name);
+    fprintf(fp, "}}");
+    first_event = false;
+
+    u64 first = 0, last = 0;
+    profiler_readable_range(thread, &first, &last);
+    for (u64 i = first; i < last; ++i) {
+      const Profile_Event& evt = thread->events[i & (Profile_Thread::MAX_EVENTS - 1)];
+      if (evt.begin < profiler_start_ticks) continue;
+
+      fprintf(fp, ",\n{\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"name\":", thread->thread_id);
+      profiler_write_json_string(fp, evt.name);
+      fprintf(
+          fp,
+          ",\"ts\":%.3f,\"dur\":%.3f}",
+          os_ticks_to_ns(evt.begin - profiler_start_ticks) / 1000.0,
+          os_ticks_to_ns(evt.end - evt.begin) / 1000.0);
+      ++num_events;
+    }
+  }
+
+  fprintf(fp, "\n]}\n");
+  log_info("[profiler] exported %llu events to %s", (unsigned long long)num_events, file_path);
+  return true;
+}
+
+static ImU32 profiler_color_for(const char* name) {
+  u64 hash = hash_djb2(name);
+  return IM_COL32(90 + (hash & 0x7f), 90 + ((hash >> 8) & 0x7f), 90 + ((hash >> 16) & 0x7f), 255);
+}
+
+void profiler_draw_imgui(bool* open) {
+  if (!ImGui::Begin("profiler", open)) {
+    ImGui::End();
+    return;
+  }
+
+  static bool paused           = false;
+  static s32 view_frames       = 4;
+  static u64 view_begin        = 0;
+  static u64 view_end          = 0;
+  static f32 row_height        = 18.0f;
+  static char export_path[256] = "mini.trace.json";
+
+  ImGui::Checkbox("pause", &paused);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(120.0f);
+  ImGui::SliderInt("frames", &view_frames, 1, PROFILER_MAX_VIEW_FRAMES);
+  ImGui::SameLine();
+  if (ImGui::Button("export")) profiler_export_chrome_trace(export_path);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(200.0f);
+  ImGui::InputText("##export_path", export_path, sizeof(export_path));
+
+  if (!paused && profiler_frame_count > (u64)view_frames) {
+    u64 newest = profiler_frame_count - 1;
+    view_end   = profiler_frames[newest & (PROFILER_MAX_FRAMES - 1)];
+    view_begin = profiler_frames[(newest - view_frames) & (PROFILER_MAX_FRAMES - 1)];
+  }
+
+  if (view_end <= view_begin) {
+    ImGui::Text("waiting for frames...");
+    ImGui::End();
+    return;
+  }
+
+  const f64 view_ticks = (f64)(view_end - view_begin);
+  ImGui::Text(
+      "%.3f ms over %d frame(s), %.3f ms avg",
+      os_ticks_to_ms(view_end - view_begin),
+      view_frames,
+      os_ticks_to_ms(view_end - view_begin) / view_frames);
+
+  ImGui::BeginChild("timeline", ImVec2(0, 0), ImGuiChildFlags_Border, ImGuiWindowFlags_HorizontalScrollbar);
+  auto draw_list    = ImGui::GetWindowDrawList();
+  const f32 width   = ImGui::GetContentRegionAvail().x;
+  const ImVec2 base = ImGui::GetCursorScreenPos();
+  f32 y             = 0.0f;
+
+  // frame boundaries
+  for (u64 i = 0; i <= (u64)view_frames && i < profiler_frame_count; ++i) {
+    u64 mark = profiler_frames[(profiler_frame_count - 1 - i) & (PROFILER_MAX_FRAMES - 1)];
+    if (mark < view_begin || mark > view_end) continue;
+    f32 x = base.x + (f32)((mark - view_begin) / view_ticks) * width;
+    draw_list->AddLine(
+        ImVec2(x, base.y),
+        ImVec2(x, base.y + ImGui::GetContentRegionAvail().y),
+        IM_COL32(255, 255, 255, 60));
+  }
+
+  for (auto thread = profiler_threads.load(std::memory_order_acquire); thread; thread = thread->next) {
+    draw_list->AddText(ImVec2(base.x, base.y + y), IM_COL32(200, 200, 200, 255), thread->name);
+    y += row_height;
+
+    u64 first = 0, last = 0;
+    profiler_readable_range(thread, &first, &last);
+
+    u32 max_depth = 0;
+    for (u64 i = first; i < last; ++i) {
+      const Profile_Event& evt = thread->events[i & (Profile_Thread::MAX_EVENTS - 1)];
+      if (evt.end < view_begin || evt.begin > view_end) continue;
+
+      f32 x0 = (f32)(((f64)evt.begin - (f64)view_begin) / view_ticks) * width;
+      f32 x1 = (f32)(((f64)evt.end - (f64)view_begin) / view_ticks) * width;
+      x0     = clamp(x0, 0.0f, width);
+      x1     = clamp(x1, x0 + 1.0f, width);
+
+      ImVec2 min = ImVec2(base.x + x0, base.y + y + evt.depth * row_height);
+      ImVec2 max = ImVec2(base.x + x1, min.y + row_height - 1.0f);
+      draw_list->AddRectFilled(min, max, profiler_color_for(evt.name));
+      if (x1 - x0 > 24.0f) {
+        draw_list->PushClipRect(min, max, true);
+        draw_list->AddText(ImVec2(min.x + 2.0f, min.y + 1.0f), IM_COL32(0, 0, 0, 255), evt.name);
+        draw_list->PopClipRect();
+      }
+
+      if (ImGui::IsMouseHoveringRect(min, max)) {
+        ImGui::SetTooltip("%s\n%.3f ms", evt.name, os_ticks_to_ms(evt.end - evt.begin));
+      }
+
+      if (evt.depth > max_depth) max_depth = evt.depth;
+    }
+
+    y += (max_depth + 1) * row_height + 4.0f;
+  }
+
+  ImGui::Dummy(ImVec2(width, y));
+  ImGui::EndChild();
+  ImGui::End();
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "defs.hpp"
+#include "os/os_common.hpp"
+#include <atomic>
+
+// Instrumentation is on by default in debug builds, pass -DMINI_PROFILE=1 (`build profile`) to force it in release.
+#if !defined(MINI_PROFILE)
+#if defined(_DEBUG)
+#define MINI_PROFILE 1
+#else
+#define MINI_PROFILE 0
+#endif
+#endif
+
+struct Profile_Event {
+  const char* name; // must point to static storage (string literals, __FUNCTION__).
+  u64 begin;
+  u64 end;
+  u32 depth;
+  u32 pad;
+};
+
+/// Each thread owns one of these and is the only writer to it, readers only ever look at events
+/// older than `write_idx` so no locking is needed.
+struct Profile_Thread {
+  static constexpr u32 MAX_EVENTS = 1 << 16; // must be a power of two.
+
+  Profile_Event events[MAX_EVENTS];
+  std::atomic<u64> write_idx;
+
+  u32 depth;
+  u32 thread_id;
+  char name[32];
+
+  Profile_Thread* next;
+};
+
+void profiler_init();
+void profiler_shutdown();
+
+/// Lazily creates the calling thread's buffer.
+Profile_Thread* profiler_get_thread();
+void profiler_set_thread_name(const char* name);
+
+/// Used for zones whose timestamps did not come from this thread (e.g. the gpu). Timestamps are `os_now_ticks`.
+Profile_Thread* profiler_create_track(const char* name);
+
+inline void profiler_push_event(Profile_Thread* thread, const char* name, u64 begin, u64 end, u32 depth) {
+  u64 idx            = thread->write_idx.load(std::memory_order_relaxed);
+  Profile_Event& evt = thread->events[idx & (Profile_Thread::MAX_EVENTS - 1)];
+  evt.name           = name;
+  evt.begin          = begin;
+  evt.end            = end;
+  evt.depth          = depth;
+  thread->write_idx.store(idx + 1, std::memory_order_release);
+}
+
+void profiler_frame_mark();
+
+bool profiler_export_chrome_trace(const char* file_path);
+void profiler_draw_imgui(bool* open);
+
+struct Profile_Scope {
+  Profile_Scope(const char* _name) : name(_name), thread(profiler_get_thread()) {
+    depth = thread->depth++;
+    begin = os_now_ticks();
+  }
+
+  ~Profile_Scope() {
+    u64 end = os_now_ticks();
+    thread->depth--;
+    profiler_push_event(thread, name, begin, end, depth);
+  }
+
+  Profile_Scope(const Profile_Scope&)            = delete;
+  Profile_Scope& operator=(const Profile_Scope&) = delete;
+
+private:
+  const char* name;
+  Profile_Thread* thread;
+  u64 begin;
+  u32 depth;
+};
+
+#if MINI_PROFILE
+#define PROFILE_SCOPE(name) ::Profile_Scope ANONYMOUS_VARIABLE(PROFILE_SCOPE_)(name)
+#define PROFILE_FUNCTION()  PROFILE_SCOPE(__FUNCTION__)
+#define PROFILE_FRAME_MARK() profiler_frame_mark()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_FRAME_MARK()
+#endif
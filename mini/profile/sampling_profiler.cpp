@@ -0,0 +1,708 @@
+#include "sampling_profiler.hpp"
+#include "core/memory.hpp"
+#include "imgui.h"
+#include "log.hpp"
+#include "os/os_common.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__) && defined(__x86_64__)
+#define SAMPLING_SUPPORTED 1
+#include <cerrno>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#else
+#define SAMPLING_SUPPORTED 0
+#endif
+
+static constexpr u32 SAMPLING_MAX_DEPTH     = 48;
+static constexpr u32 SAMPLING_MAX_SAMPLES   = 1 << 15;
+static constexpr u32 SAMPLING_MAX_THREADS   = 32;
+static constexpr u32 SAMPLING_MAX_FUNCTIONS = 1 << 12;
+static constexpr u32 SAMPLING_ADDRESS_SLOTS = 1 << 14; // power of two, open addressing.
+
+struct Sampling_Sample {
+  std::atomic<u32> ready;
+  u32 thread;
+  u32 depth;
+  u32 pad;
+  u64 frames[SAMPLING_MAX_DEPTH]; // innermost first, return addresses after the first one.
+};
+
+struct Sampling_Thread {
+  std::atomic<bool> registered;
+  char name[32];
+
+#if SAMPLING_SUPPORTED
+  pid_t tid;
+  pthread_t handle;
+  uintptr_t stack_lo;
+  uintptr_t stack_hi;
+
+  // perf_event
+  int perf_fd;
+  u8* perf_ring;
+  u64 perf_ring_size;
+
+  // sigprof
+  timer_t timer;
+  bool has_timer;
+#endif
+};
+
+struct Sampling_Address {
+  u64 address;
+  u32 function; // index + 1, 0 means the slot is empty.
+};
+
+// everything is preallocated, signal handlers can't allocate. the samples are ~17MB, they're only allocated by the
+// first start and kept from then on, reports read them after stopping.
+static Sampling_Sample* sampling_samples             = nullptr;
+static u16 (*sampling_resolved)[SAMPLING_MAX_DEPTH] = nullptr;
+static std::atomic<u32> sampling_reserved = { 0 };
+static std::atomic<u64> sampling_dropped  = { 0 };
+static u32 sampling_processed             = 0;
+
+static Sampling_Thread sampling_threads[SAMPLING_MAX_THREADS];
+static std::atomic<u32> sampling_thread_count = { 0 };
+
+static Sampling_Function sampling_functions[SAMPLING_MAX_FUNCTIONS];
+static Sampling_Function sampling_sorted[SAMPLING_MAX_FUNCTIONS];
+static u32 sampling_function_count = 0;
+static Sampling_Address sampling_addresses[SAMPLING_ADDRESS_SLOTS];
+
+static std::atomic<bool> sampling_running = { false };
+static Sampling_Mode sampling_mode        = Sampling_Mode::none;
+static u32 sampling_frequency             = 0;
+
+// reserves a sample slot, safe to call from a signal handler.
+static Sampling_Sample* sampling_reserve() {
+  u32 idx = sampling_reserved.fetch_add(1, std::memory_order_relaxed);
+  if (idx >= SAMPLING_MAX_SAMPLES) {
+    sampling_dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  return sampling_samples + idx;
+}
+
+#if SAMPLING_SUPPORTED
+
+// serializes registration against start/stop so a thread can't slip between the two.
+static pthread_mutex_t sampling_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// holds the index + 1 of the calling thread, its destructor unregisters threads as they exit.
+static pthread_key_t sampling_thread_key;
+static pthread_once_t sampling_thread_key_once = PTHREAD_ONCE_INIT;
+
+static s32 sampling_find_thread(pid_t tid) {
+  u32 count = sampling_thread_count.load(std::memory_order_acquire);
+  for (u32 i = 0; i < count; ++i) {
+    if (sampling_threads[i].registered.load(std::memory_order_acquire) && sampling_threads[i].tid == tid) return (s32)i;
+  }
+  return -1;
+}
+
+// --- perf_event ---
+static constexpr u32 SAMPLING_PERF_DATA_PAGES = 8; // power of two.
+static pthread_t sampling_perf_reader;
+
+static bool sampling_perf_attach(Sampling_Thread& thread) {
+  perf_event_attr attr           = {};
+  attr.size                      = sizeof(attr);
+  attr.type                      = PERF_TYPE_SOFTWARE;
+  attr.config                    = PERF_COUNT_SW_TASK_CLOCK;
+  attr.freq                      = 1;
+  attr.sample_freq               = sampling_frequency;
+  attr.sample_type               = PERF_SAMPLE_TID | PERF_SAMPLE_CALLCHAIN;
+  attr.disabled                  = 1;
+  attr.exclude_kernel            = 1;
+  attr.exclude_hv                = 1;
+  attr.exclude_callchain_kernel  = 1;
+  attr.sample_max_stack          = SAMPLING_MAX_DEPTH;
+
+  int fd = (int)syscall(SYS_perf_event_open, &attr, thread.tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+  if (fd < 0) return false;
+
+  const u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+  const u64 size      = page_size * (1 + SAMPLING_PERF_DATA_PAGES);
+  void* ring          = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ring == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  thread.perf_fd        = fd;
+  thread.perf_ring      = (u8*)ring;
+  thread.perf_ring_size = size;
+  ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  return true;
+}
+
+static void sampling_perf_detach(Sampling_Thread& thread) {
+  if (!thread.perf_ring) return;
+  ioctl(thread.perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+  munmap(thread.perf_ring, thread.perf_ring_size);
+  close(thread.perf_fd);
+  thread.perf_ring = nullptr;
+  thread.perf_fd   = -1;
+}
+
+static void sampling_perf_drain(Sampling_Thread& thread) {
+  auto meta           = (perf_event_mmap_page*)thread.perf_ring;
+  const u64 page_size = (u64)sysconf(_SC_PAGESIZE);
+  const u64 data_size = page_size * SAMPLING_PERF_DATA_PAGES;
+  const u8* data      = thread.perf_ring + page_size;
+
+  u64 head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+  u64 tail = meta->data_tail;
+
+  u8 record[sizeof(perf_event_header) + 16 + 8 * (SAMPLING_MAX_DEPTH + 8)];
+  while (tail < head) {
+    perf_event_header header;
+    for (u32 i = 0; i < sizeof(header); ++i) ((u8*)&header)[i] = data[(tail + i) & (data_size - 1)];
+    if (header.size == 0) break;
+
+    if (header.type == PERF_RECORD_SAMPLE && header.size <= sizeof(record)) {
+      for (u32 i = 0; i < header.size; ++i) record[i] = data[(tail + i) & (data_size - 1)];
+
+      // layout follows sample_type: u32 pid, u32 tid, u64 nr, u64 ips[nr].
+      const u8* cursor = record + sizeof(perf_event_header);
+      u32 tid          = 0;
+      u64 nr           = 0;
+      memcpy(&tid, cursor + 4, sizeof(tid));
+      memcpy(&nr, cursor + 8, sizeof(nr));
+      const u64* ips = (const u64*)(cursor + 16);
+
+      s32 thread_idx = sampling_find_thread((pid_t)tid);
+      if (auto sample = thread_idx >= 0 ? sampling_reserve() : nullptr) {
+        u32 depth = 0;
+        for (u64 i = 0; i < nr && depth < SAMPLING_MAX_DEPTH; ++i) {
+          if (ips[i] >= (u64)PERF_CONTEXT_MAX) continue; // context markers.
+          sample->frames[depth++] = ips[i];
+        }
+        sample->thread = (u32)thread_idx;
+        sample->depth  = depth;
+        sample->ready.store(1, std::memory_order_release);
+      }
+    }
+
+    tail += header.size;
+  }
+
+  __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+static void* sampling_perf_reader_proc(void*) {
+  while (sampling_running.load(std::memory_order_acquire)) {
+    // exiting threads unmap their ring under the lock. stop holds it while joining us, so only try.
+    if (pthread_mutex_trylock(&sampling_lock) == 0) {
+      u32 count = sampling_thread_count.load(std::memory_order_acquire);
+      for (u32 i = 0; i < count; ++i) {
+        if (sampling_threads[i].registered.load(std::memory_order_acquire) && sampling_threads[i].perf_ring)
+          sampling_perf_drain(sampling_threads[i]);
+      }
+      pthread_mutex_unlock(&sampling_lock);
+    }
+    os_sleep_coarse(2000000);
+  }
+  return nullptr;
+}
+
+// --- sigprof ---
+static struct sigaction sampling_previous_action;
+
+static void sampling_signal_handler(int, siginfo_t*, void* context) {
+  const int saved_errno = errno;
+  defer { errno = saved_errno; };
+
+  s32 thread_idx = sampling_find_thread((pid_t)syscall(SYS_gettid));
+  if (thread_idx < 0) return;
+  const Sampling_Thread& thread = sampling_threads[thread_idx];
+
+  auto sample = sampling_reserve();
+  if (!sample) return;
+
+  auto uc           = (ucontext_t*)context;
+  sample->frames[0] = (u64)uc->uc_mcontext.gregs[REG_RIP];
+  uintptr_t fp      = (uintptr_t)uc->uc_mcontext.gregs[REG_RBP];
+
+  // walk the frame pointer chain, never leaving the thread's stack.
+  u32 depth = 1;
+  while (depth < SAMPLING_MAX_DEPTH && (fp & 7) == 0 && fp >= thread.stack_lo && fp + 16 <= thread.stack_hi) {
+    auto frame     = (const uintptr_t*)fp;
+    uintptr_t next = frame[0];
+    uintptr_t ret  = frame[1];
+    if (ret == 0) break;
+    sample->frames[depth++] = ret;
+    if (next <= fp) break;
+    fp = next;
+  }
+
+  sample->thread = (u32)thread_idx;
+  sample->depth  = depth;
+  sample->ready.store(1, std::memory_order_release);
+}
+
+static bool sampling_sigprof_attach(Sampling_Thread& thread) {
+  clockid_t clock;
+  if (pthread_getcpuclockid(thread.handle, &clock) != 0) return false;
+
+  sigevent event                = {};
+  event.sigev_notify            = SIGEV_THREAD_ID;
+  event.sigev_signo             = SIGPROF;
+  event._sigev_un._tid          = thread.tid;
+  if (timer_create(clock, &event, &thread.timer) != 0) return false;
+
+  const u64 interval_ns     = 1000000000ull / sampling_frequency;
+  itimerspec spec           = {};
+  spec.it_interval.tv_sec   = (time_t)(interval_ns / 1000000000ull);
+  spec.it_interval.tv_nsec  = (long)(interval_ns % 1000000000ull);
+  spec.it_value             = spec.it_interval;
+  timer_settime(thread.timer, 0, &spec, nullptr);
+  thread.has_timer = true;
+  return true;
+}
+
+static void sampling_sigprof_detach(Sampling_Thread& thread) {
+  if (!thread.has_timer) return;
+  timer_delete(thread.timer);
+  thread.has_timer = false;
+}
+
+static bool sampling_attach(Sampling_Thread& thread) {
+  if (sampling_mode == Sampling_Mode::perf_event) return sampling_perf_attach(thread);
+  if (sampling_mode == Sampling_Mode::sigprof) return sampling_sigprof_attach(thread);
+  return false;
+}
+
+static void sampling_detach(Sampling_Thread& thread) {
+  sampling_perf_detach(thread);
+  sampling_sigprof_detach(thread);
+}
+
+// runs as a registered thread exits, its tid and pthread_t mean nothing after that.
+static void sampling_unregister_thread(void* key_value) {
+  pthread_mutex_lock(&sampling_lock);
+  defer { pthread_mutex_unlock(&sampling_lock); };
+
+  Sampling_Thread& thread = sampling_threads[(uintptr_t)key_value - 1];
+  if (thread.perf_ring) sampling_perf_drain(thread);
+  sampling_detach(thread);
+  // the slot is not reused, samples taken so far still point at its name.
+  thread.registered.store(false, std::memory_order_release);
+}
+
+static void sampling_create_thread_key() {
+  pthread_key_create(&sampling_thread_key, sampling_unregister_thread);
+}
+
+void sampling_profiler_register_thread(const char* name) {
+  pthread_once(&sampling_thread_key_once, sampling_create_thread_key);
+  pthread_mutex_lock(&sampling_lock);
+  defer { pthread_mutex_unlock(&sampling_lock); };
+
+  const u32 idx = sampling_thread_count.load(std::memory_order_relaxed);
+  if (idx >= SAMPLING_MAX_THREADS) {
+    log_warn("[sampling] too many threads, %s will not be sampled", name);
+    return;
+  }
+
+  Sampling_Thread& thread = sampling_threads[idx];
+  snprintf(thread.name, sizeof(thread.name), "%s", name);
+  thread.tid     = (pid_t)syscall(SYS_gettid);
+  thread.handle  = pthread_self();
+  thread.perf_fd = -1;
+
+  pthread_attr_t attr;
+  if (pthread_getattr_np(thread.handle, &attr) == 0) {
+    void* stack_addr = nullptr;
+    size_t size      = 0;
+    pthread_attr_getstack(&attr, &stack_addr, &size);
+    pthread_attr_destroy(&attr);
+    thread.stack_lo = (uintptr_t)stack_addr;
+    thread.stack_hi = (uintptr_t)stack_addr + size;
+  }
+
+  thread.registered.store(true, std::memory_order_release);
+  sampling_thread_count.store(idx + 1, std::memory_order_release);
+  pthread_setspecific(sampling_thread_key, (void*)(uintptr_t)(idx + 1));
+  if (sampling_running.load(std::memory_order_acquire)) sampling_attach(thread);
+}
+
+bool sampling_profiler_start(u32 frequency_hz) {
+  pthread_mutex_lock(&sampling_lock);
+  defer { pthread_mutex_unlock(&sampling_lock); };
+
+  if (sampling_running.load()) return true;
+  assert(frequency_hz > 0);
+  sampling_frequency = frequency_hz;
+
+  if (!sampling_samples) {
+    Allocator allocator;
+    auto samples  = allocator.allocate(sizeof(Sampling_Sample) * SAMPLING_MAX_SAMPLES, alignof(Sampling_Sample));
+    auto resolved = allocator.allocate_no_zero(sizeof(u16) * SAMPLING_MAX_SAMPLES * SAMPLING_MAX_DEPTH, alignof(u16));
+    if (samples.info != Allocation_Err::none || resolved.info != Allocation_Err::none) {
+      log_error("[sampling] unable to allocate the sample buffer");
+      allocator.free(samples.memory);
+      allocator.free(resolved.memory);
+      return false;
+    }
+    sampling_samples  = (Sampling_Sample*)samples.memory;
+    sampling_resolved = (u16(*)[SAMPLING_MAX_DEPTH])resolved.memory;
+  }
+
+  const u32 count = sampling_thread_count.load(std::memory_order_acquire);
+
+  // try perf first, if the kernel refuses for any thread fall back to timers for everyone.
+  sampling_mode    = Sampling_Mode::perf_event;
+  bool attached    = true;
+  int attach_errno = 0;
+  for (u32 i = 0; i < count && attached; ++i) {
+    if (!sampling_threads[i].registered.load(std::memory_order_acquire)) continue;
+    attached = sampling_perf_attach(sampling_threads[i]);
+    // before the detaches below get a chance to overwrite it.
+    if (!attached) attach_errno = errno;
+  }
+
+  if (attached) {
+    sampling_running.store(true, std::memory_order_release);
+    pthread_create(&sampling_perf_reader, nullptr, sampling_perf_reader_proc, nullptr);
+  } else {
+    for (u32 i = 0; i < count; ++i) sampling_perf_detach(sampling_threads[i]);
+    log_info("[sampling] perf_event_open unavailable (%s), using SIGPROF timers", strerror(attach_errno));
+
+    struct sigaction action = {};
+    action.sa_sigaction     = sampling_signal_handler;
+    action.sa_flags         = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &sampling_previous_action);
+
+    sampling_mode = Sampling_Mode::sigprof;
+    sampling_running.store(true, std::memory_order_release);
+    for (u32 i = 0; i < count; ++i) {
+      if (!sampling_threads[i].registered.load(std::memory_order_acquire)) continue;
+      if (!sampling_sigprof_attach(sampling_threads[i]))
+        log_warn("[sampling] unable to create a timer for %s", sampling_threads[i].name);
+    }
+  }
+
+  log_info(
+      "[sampling] started at %uHz with %s",
+      frequency_hz,
+      sampling_mode == Sampling_Mode::perf_event ? "perf_event" : "SIGPROF");
+  return true;
+}
+
+void sampling_profiler_stop() {
+  pthread_mutex_lock(&sampling_lock);
+  defer { pthread_mutex_unlock(&sampling_lock); };
+
+  if (!sampling_running.load()) return;
+
+  const u32 count = sampling_thread_count.load(std::memory_order_acquire);
+  if (sampling_mode == Sampling_Mode::sigprof) {
+    for (u32 i = 0; i < count; ++i) sampling_detach(sampling_threads[i]);
+    sampling_running.store(false, std::memory_order_release);
+    // a deleted timer can leave its signal pending, and the previous action may well be the default one that
+    // terminates. ignoring SIGPROF discards whatever is still pending in every thread before restoring.
+    struct sigaction ignore = {};
+    ignore.sa_handler       = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPROF, &ignore, nullptr);
+    sigaction(SIGPROF, &sampling_previous_action, nullptr);
+  } else {
+    sampling_running.store(false, std::memory_order_release);
+    pthread_join(sampling_perf_reader, nullptr);
+    for (u32 i = 0; i < count; ++i) {
+      if (sampling_threads[i].perf_ring) sampling_perf_drain(sampling_threads[i]);
+      sampling_detach(sampling_threads[i]);
+    }
+  }
+  sampling_mode = Sampling_Mode::none;
+}
+
+// --- symbols ---
+static void sampling_symbolize(u64 address, u64* start, char* name, u64 name_size) {
+  Dl_info info = {};
+  if (dladdr((void*)address, &info) && info.dli_sname && info.dli_saddr) {
+    *start         = (u64)info.dli_saddr;
+    int status     = 0;
+    char* demangle = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    snprintf(name, name_size, "%s", status == 0 && demangle ? demangle : info.dli_sname);
+    free(demangle);
+  } else if (info.dli_fname) {
+    // not exported, link with -rdynamic to see the executable's own functions.
+    const char* module = strrchr(info.dli_fname, '/');
+    *start             = address;
+    snprintf(name, name_size, "%s+0x%llx", module ? module + 1 : info.dli_fname, (unsigned long long)(address - (u64)info.dli_fbase));
+  } else {
+    *start = address;
+    snprintf(name, name_size, "0x%llx", (unsigned long long)address);
+  }
+
+  // folded stacks use ';' as the separator.
+  for (char* c = name; *c; ++c) {
+    if (*c == ';') *c = ':';
+  }
+}
+
+#else
+
+void sampling_profiler_register_thread(const char*) {}
+bool sampling_profiler_start(u32) {
+  log_warn("[sampling] the sampling profiler is only implemented on linux x86_64");
+  return false;
+}
+void sampling_profiler_stop() {}
+
+static void sampling_symbolize(u64 address, u64* start, char* name, u64 name_size) {
+  *start = address;
+  snprintf(name, name_size, "0x%llx", (unsigned long long)address);
+}
+
+#endif // SAMPLING_SUPPORTED
+
+bool sampling_profiler_running() { return sampling_running.load(std::memory_order_acquire); }
+Sampling_Mode sampling_profiler_mode() { return sampling_mode; }
+
+static u32 sampling_resolve(u64 address) {
+  u64 hash = address * 0x9E3779B97F4A7C15ull;
+  for (u32 probe = 0; probe < SAMPLING_ADDRESS_SLOTS; ++probe) {
+    Sampling_Address& slot = sampling_addresses[(hash + probe) & (SAMPLING_ADDRESS_SLOTS - 1)];
+    if (slot.function != 0 && slot.address == address) return slot.function - 1;
+    if (slot.function != 0) continue;
+
+    u64 start = 0;
+    char name[sizeof(Sampling_Function::name)];
+    sampling_symbolize(address, &start, name, sizeof(name));
+
+    u32 function = 0;
+    while (function < sampling_function_count && sampling_functions[function].address != start) ++function;
+    if (function == sampling_function_count) {
+      if (sampling_function_count == SAMPLING_MAX_FUNCTIONS) return SAMPLING_MAX_FUNCTIONS - 1;
+      Sampling_Function& f = sampling_functions[sampling_function_count++];
+      f.address            = start;
+      f.self               = 0;
+      f.total              = 0;
+      memcpy(f.name, name, sizeof(name));
+    }
+
+    slot.address  = address;
+    slot.function = function + 1;
+    return function;
+  }
+  return SAMPLING_MAX_FUNCTIONS - 1;
+}
+
+// symbolizes and aggregates every sample that came in since the last call.
+static void sampling_process() {
+  u32 reserved = sampling_reserved.load(std::memory_order_acquire);
+  if (reserved > SAMPLING_MAX_SAMPLES) reserved = SAMPLING_MAX_SAMPLES;
+
+  for (; sampling_processed < reserved; ++sampling_processed) {
+    Sampling_Sample& sample = sampling_samples[sampling_processed];
+    if (!sample.ready.load(std::memory_order_acquire)) break; // still being written, pick it up next time.
+
+    u16* ids = sampling_resolved[sampling_processed];
+    for (u32 i = 0; i < sample.depth; ++i) {
+      // return addresses point past the call, step back into the calling function.
+      ids[i] = (u16)sampling_resolve(i == 0 ? sample.frames[i] : sample.frames[i] - 1);
+
+      bool seen = false;
+      for (u32 j = 0; j < i && !seen; ++j) seen = ids[j] == ids[i];
+      if (!seen) sampling_functions[ids[i]].total++;
+    }
+    if (sample.depth > 0) sampling_functions[ids[0]].self++;
+  }
+}
+
+static int sampling_compare_self(const void* a, const void* b) {
+  auto fa = (const Sampling_Function*)a;
+  auto fb = (const Sampling_Function*)b;
+  if (fa->self != fb->self) return fa->self > fb->self ? -1 : 1;
+  return fa->total > fb->total ? -1 : (fa->total < fb->total ? 1 : 0);
+}
+
+Sampling_Report sampling_profiler_report() {
+  sampling_process();
+  memcpy(sampling_sorted, sampling_functions, sizeof(Sampling_Function) * sampling_function_count);
+  qsort(sampling_sorted, sampling_function_count, sizeof(Sampling_Function), sampling_compare_self);
+
+  Sampling_Report report = {};
+  report.functions       = sampling_sorted;
+  report.function_count  = sampling_function_count;
+  report.sample_count    = sampling_processed;
+  report.dropped_count   = sampling_dropped.load(std::memory_order_relaxed);
+  return report;
+}
+
+void sampling_profiler_clear() {
+  // writers only ever touch samples past `sampling_reserved`, resetting it underneath them is not safe.
+  if (sampling_profiler_running()) return;
+  for (u32 i = 0; i < sampling_processed; ++i) sampling_samples[i].ready.store(0, std::memory_order_relaxed);
+  sampling_reserved.store(0);
+  sampling_dropped.store(0);
+  sampling_processed      = 0;
+  sampling_function_count = 0;
+  memset(sampling_addresses, 0, sizeof(sampling_addresses));
+}
+
+struct Sampling_Stack_Key {
+  u64 hash;
+  u32 sample;
+};
+
+static int sampling_compare_stack(const void* a, const void* b) {
+  auto ka = (const Sampling_Stack_Key*)a;
+  auto kb = (const Sampling_Stack_Key*)b;
+  if (ka->hash != kb->hash) return ka->hash < kb->hash ? -1 : 1;
+  return 0;
+}
+
+static bool sampling_same_stack(u32 a, u32 b) {
+  if (sampling_samples[a].depth != sampling_samples[b].depth) return false;
+  if (sampling_samples[a].thread != sampling_samples[b].thread) return false;
+  return memcmp(sampling_resolved[a], sampling_resolved[b], sampling_samples[a].depth * sizeof(u16)) == 0;
+}
+
+bool sampling_profiler_export_folded(const char* file_path) {
+  sampling_process();
+
+  FILE* fp = nullptr;
+  fopen_s(&fp, file_path, "wb");
+  if (!fp) {
+    log_error("[sampling] unable to open %s for writing", file_path);
+    return false;
+  }
+  defer { fclose(fp); };
+
+  Allocator allocator;
+  auto allocation = allocator.allocate_no_zero(sizeof(Sampling_Stack_Key) * (sampling_processed + 1), 8);
+  assert(allocation.info == Allocation_Err::none);
+  auto keys = (Sampling_Stack_Key*)allocation.memory;
+  defer { allocator.free(keys); };
+
+  // group identical stacks by sorting on their hash, then merge runs.
+  for (u32 i = 0; i < sampling_processed; ++i) {
+    u64 hash = 1469598103934665603ull ^ sampling_samples[i].thread;
+    for (u32 d = 0; d < sampling_samples[i].depth; ++d) hash = (hash ^ sampling_resolved[i][d]) * 1099511628211ull;
+    keys[i] = { hash, i };
+  }
+  qsort(keys, sampling_processed, sizeof(Sampling_Stack_Key), sampling_compare_stack);
+
+  u32 lines = 0;
+  for (u32 i = 0; i < sampling_processed;) {
+    const u32 sample = keys[i].sample;
+    u32 count        = 0;
+    u32 j            = i;
+    for (; j < sampling_processed && keys[j].hash == keys[i].hash; ++j) {
+      if (sampling_same_stack(sample, keys[j].sample)) count++;
+    }
+
+    const Sampling_Sample& s = sampling_samples[sample];
+    if (s.depth > 0) {
+      fprintf(fp, "%s", sampling_threads[s.thread].name);
+      for (u32 d = s.depth; d > 0; --d) fprintf(fp, ";%s", sampling_functions[sampling_resolved[sample][d - 1]].name);
+      fprintf(fp, " %u\n", count);
+      lines++;
+    }
+
+    // hash collisions with a different stack are rare enough that we just emit them one at a time.
+    if (count == j - i) i = j;
+    else {
+      for (u32 k = i + 1; k < j; ++k) {
+        if (sampling_same_stack(sample, keys[k].sample)) continue;
+        const Sampling_Sample& other = sampling_samples[keys[k].sample];
+        fprintf(fp, "%s", sampling_threads[other.thread].name);
+        for (u32 d = other.depth; d > 0; --d)
+          fprintf(fp, ";%s", sampling_functions[sampling_resolved[keys[k].sample][d - 1]].name);
+        fprintf(fp, " 1\n");
+        lines++;
+      }
+      i = j;
+    }
+  }
+
+  log_info("[sampling] exported %u stacks from %u samples to %s", lines, sampling_processed, file_path);
+  return true;
+}
+
+void sampling_profiler_draw_imgui(bool* open) {
+  if (!ImGui::Begin("sampling profiler", open)) {
+    ImGui::End();
+    return;
+  }
+
+#if SAMPLING_SUPPORTED
+  static s32 frequency         = 1000;
+  static char export_path[256] = "mini.folded";
+
+  const bool running = sampling_profiler_running();
+  if (running) {
+    if (ImGui::Button("stop")) sampling_profiler_stop();
+    ImGui::SameLine();
+    ImGui::Text("%s at %dHz", sampling_mode == Sampling_Mode::perf_event ? "perf_event" : "SIGPROF", frequency);
+  } else {
+    if (ImGui::Button("start")) sampling_profiler_start((u32)frequency);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(150.0f);
+    ImGui::SliderInt("hz", &frequency, 10, 10000, "%d", ImGuiSliderFlags_Logarithmic);
+    ImGui::SameLine();
+    if (ImGui::Button("clear")) sampling_profiler_clear();
+  }
+
+  if (ImGui::Button("export folded")) sampling_profiler_export_folded(export_path);
+  ImGui::SameLine();
+  ImGui::SetNextItemWidth(200.0f);
+  ImGui::InputText("##export_path", export_path, sizeof(export_path));
+
+  Sampling_Report report = sampling_profiler_report();
+  ImGui::Text(
+      "%llu samples, %llu dropped, %u functions",
+      (unsigned long long)report.sample_count,
+      (unsigned long long)report.dropped_count,
+      report.function_count);
+
+  const f32 total = report.sample_count ? (f32)report.sample_count : 1.0f;
+  if (ImGui::BeginTable("hotspots", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders | ImGuiTableFlags_ScrollY)) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("function");
+    ImGui::TableSetupColumn("self %", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+    ImGui::TableSetupColumn("total %", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+    ImGui::TableHeadersRow();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)report.function_count);
+    while (clipper.Step()) {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+        const Sampling_Function& f = report.functions[i];
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(f.name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", 100.0f * f.self / total);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", 100.0f * f.total / total);
+      }
+    }
+    ImGui::EndTable();
+  }
+#else
+  ImGui::Text("sampling is only supported on linux x86_64.");
+#endif
+
+  ImGui::End();
+}
+
+#undef SAMPLING_SUPPORTED
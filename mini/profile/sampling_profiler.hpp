@@ -0,0 +1,40 @@
+#pragma once
+#include "defs.hpp"
+
+/// Opt-in statistical profiler. Linux only for now, everything here is a no-op elsewhere.
+///
+/// Samples come from perf_event_open when the kernel allows it (perf_event_paranoid, containers...) and from a per
+/// thread SIGPROF cpu timer otherwise. Call stacks are walked through frame pointers so build with
+/// -fno-omit-frame-pointer, they are stored as raw addresses and only symbolized when aggregating or exporting.
+enum struct Sampling_Mode { none, perf_event, sigprof };
+
+struct Sampling_Function {
+  u64 address; // start of the function, or the raw address when it could not be resolved.
+  u32 self;    // samples where this was the innermost frame.
+  u32 total;   // samples where this was anywhere on the stack.
+  char name[128];
+};
+
+struct Sampling_Report {
+  Sampling_Function* functions; // sorted by self samples, owned by the profiler.
+  u32 function_count;
+  u64 sample_count;
+  u64 dropped_count;
+};
+
+bool sampling_profiler_start(u32 frequency_hz);
+void sampling_profiler_stop();
+bool sampling_profiler_running();
+Sampling_Mode sampling_profiler_mode();
+
+/// Every thread that wants to be sampled has to call this once, threads registered before `start` are picked up.
+/// Threads are dropped again as they exit.
+void sampling_profiler_register_thread(const char* name);
+
+/// Symbolizes any new samples and returns the per function hotspots.
+Sampling_Report sampling_profiler_report();
+void sampling_profiler_clear();
+
+/// One line per unique stack, outermost frame first: `main;run;update 42`. Feed it to flamegraph.pl or speedscope.
+bool sampling_profiler_export_folded(const char* file_path);
+void sampling_profiler_draw_imgui(bool* open);
@@ -2,17 +2,41 @@
 // #include "embed/volk.mini"
 #include "embed/vma.mini"
 
+#include "core/common.cpp"
 #include "core/memory.cpp"
 
 // gpu files
+#include "gpu/bindless.cpp"
 #include "gpu/common.cpp"
 #include "gpu/device.cpp"
+#include "gpu/dynamic_resolution.cpp"
+#include "gpu/frame_pacer.cpp"
+#include "gpu/pass_cache.cpp"
+#include "gpu/pipeline_cache.cpp"
+#include "gpu/pipeline_registry.cpp"
+#include "gpu/readback.cpp"
+#include "gpu/render_graph.cpp"
+#include "gpu/shader_compiler.cpp"
 #include "gpu/surface.cpp"
 #include "gpu/sync.cpp"
+#include "gpu/transient_heap.cpp"
+#include "gpu/upload.cpp"
+#include "gpu/workgroup_tuning.cpp"
+
+// profiling
+#include "profile/frame_stats.cpp"
+#include "profile/gpu_profiler.cpp"
+#include "profile/profiler.cpp"
+#include "profile/sampling_profiler.cpp"
 
 // os files
+#include "os/os_clock.cpp"
+#include "os/os_linux.cpp"
 #include "os/os_win32.cpp"
 
+// benchmarks
+#include "bench/kernel_bench.cpp"
+
 // other files
 #include "log.cpp"
 